@@ -0,0 +1,174 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file generate.cpp
+ * @author Christian Ponte
+ *
+ * @brief Generator tool. Writes a synthetic data set, optionally with a
+ * planted interaction between SNPs, to a pair of tped and tfam files that can
+ * be analyzed with fiuncho.
+ */
+
+#include <fiuncho/dataset/Synthetic.h>
+#include <iostream>
+#include <sstream>
+#include <tclap/CmdLine.h>
+
+int main(int argc, char **argv)
+{
+    try {
+        // Create TCLAP CmdLine
+        TCLAP::CmdLine cmd(
+            "Generate a synthetic data set with an optional planted "
+            "interaction, in the tped and tfam formats. Full documentation "
+            "available at https://fiuncho.readthedocs.io/",
+            ' ', FIUNCHO_VERSION);
+        class : public TCLAP::StdOutput
+        {
+          public:
+            virtual void failure(TCLAP::CmdLineInterface &,
+                                 TCLAP::ArgException &e)
+            {
+                throw e;
+            }
+        } cmd_output;
+        cmd.setOutput(&cmd_output);
+        TCLAP::ValueArg<size_t> snps(
+            "", "snps", "Number of SNPs. By default, 1000.", false, 1000,
+            "integer");
+        cmd.add(snps);
+        TCLAP::ValueArg<size_t> cases(
+            "", "cases", "Number of cases. By default, 1000.", false, 1000,
+            "integer");
+        cmd.add(cases);
+        TCLAP::ValueArg<size_t> ctrls(
+            "", "ctrls", "Number of controls. By default, 1000.", false, 1000,
+            "integer");
+        cmd.add(ctrls);
+        TCLAP::ValueArg<double> maf_min(
+            "", "maf-min",
+            "Smallest minor allele frequency of the SNPs, which are drawn "
+            "uniformly between the minimum and the maximum. By default, 0.05.",
+            false, 0.05, "number");
+        cmd.add(maf_min);
+        TCLAP::ValueArg<double> maf_max(
+            "", "maf-max",
+            "Largest minor allele frequency of the SNPs. By default, 0.5.",
+            false, 0.5, "number");
+        cmd.add(maf_max);
+        TCLAP::ValueArg<uint64_t> seed(
+            "", "seed",
+            "Seed of the random number generators. The same seed generates "
+            "the same data set. By default, 0.",
+            false, 0, "integer");
+        cmd.add(seed);
+        class : public TCLAP::Constraint<std::string>
+        {
+            bool check(const std::string &model) const
+            {
+                return model == "none" || model == "xor" ||
+                       model == "threshold" || model == "multiplicative";
+            }
+
+            std::string shortID() const
+            {
+                return "none|xor|threshold|multiplicative";
+            }
+
+            std::string description() const
+            {
+                return "model is one of none, xor, threshold or "
+                       "multiplicative";
+            }
+        } model_constraint;
+        TCLAP::ValueArg<std::string> model(
+            "", "model",
+            "Penetrance model of the planted interaction: xor, where the "
+            "genotypes at risk carry an odd number of minor alleles, "
+            "threshold, where they carry at least one minor allele at every "
+            "SNP of the interaction, or multiplicative, where each minor "
+            "allele multiplies the penetrance. By default, none, without any "
+            "interaction.",
+            false, "none", &model_constraint);
+        cmd.add(model);
+        TCLAP::ValueArg<std::string> planted(
+            "", "planted",
+            "Comma-separated list of the indices of the SNPs of the planted "
+            "interaction, starting at 0. By default, 0,1.",
+            false, "0,1", "list");
+        cmd.add(planted);
+        TCLAP::ValueArg<double> baseline(
+            "", "baseline",
+            "Penetrance of the genotypes not at risk. By default, 0.1.", false,
+            0.1, "number");
+        cmd.add(baseline);
+        TCLAP::ValueArg<double> effect(
+            "", "effect",
+            "Increase of the penetrance of the genotypes at risk, relative to "
+            "the baseline. By default, 1, doubling the penetrance.",
+            false, 1, "number");
+        cmd.add(effect);
+        TCLAP::ValueArg<unsigned int> threads(
+            "t", "threads",
+            "Number of threads generating the SNPs. By default, 1.", false, 1,
+            "integer");
+        cmd.add(threads);
+        TCLAP::UnlabeledValueArg<std::string> tped(
+            "tped", "Path to the tped output file.", true, "", "path");
+        cmd.add(tped);
+        TCLAP::UnlabeledValueArg<std::string> tfam(
+            "tfam", "Path to the tfam output file.", true, "", "path");
+        cmd.add(tfam);
+        cmd.parse(argc, argv);
+
+        Synthetic synthetic(snps.getValue(), cases.getValue(),
+                            ctrls.getValue(), maf_min.getValue(),
+                            maf_max.getValue(), seed.getValue());
+        if (model.getValue() != "none") {
+            std::vector<size_t> indices;
+            std::stringstream list(planted.getValue());
+            for (std::string i; std::getline(list, i, ',');) {
+                try {
+                    indices.push_back(std::stoull(i));
+                } catch (const std::logic_error &) {
+                    throw TCLAP::ArgException("is not a list of indices",
+                                              "planted");
+                }
+            }
+            synthetic.plant(model.getValue() == "xor"
+                                ? InteractionModel::XOR
+                            : model.getValue() == "threshold"
+                                ? InteractionModel::Threshold
+                                : InteractionModel::Multiplicative,
+                            indices, baseline.getValue(), effect.getValue());
+            // Print the indices of the planted SNPs
+            for (size_t i = 0; i < synthetic.planted().size(); i++) {
+                std::cout << (i > 0 ? " " : "") << synthetic.planted()[i];
+            }
+            std::cout << std::endl;
+        }
+        synthetic.write(tped.getValue(), tfam.getValue(), threads.getValue());
+    } catch (const TCLAP::ArgException &e) {
+        std::cerr << e.error() << std::endl;
+        return 1;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -22,23 +22,79 @@
  *
  * @brief Main program. Initializes the MPI environment, parses the command-line
  * arguments, prints debug information if necessary, instantiates the Search and
- * terminates the execution.
+ * terminates the execution. If Fiuncho is built without MPI, the Search runs in
+ * a single process and the options related to the distribution of the work
+ * among processes have no effect.
  */
 
+#ifdef FIUNCHO_MPI
 #include <fiuncho/MPIEngine.h>
+#include <fiuncho/MPISlicedSearch.h>
+#endif
+#include <fiuncho/SlicedSearch.h>
 #include <fiuncho/ThreadedSearch.h>
+#include <chrono>
+#include <cstdlib>
+#include <fiuncho/Checkpoint.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fiuncho/utils/Autotuner.h>
+#include <fiuncho/utils/Estimate.h>
+#include <fiuncho/utils/PartialResults.h>
+#include <fiuncho/utils/Progress.h>
+#include <fiuncho/utils/Report.h>
+#include <fiuncho/utils/Tracer.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <linux/limits.h>
+#include <memory>
 #include <tclap/CmdLine.h>
 #include <unistd.h>
 
 typedef struct {
     std::string tped, tfam, output;
     short order, threads;
-    unsigned int noutputs;
+    unsigned int noutputs, pipeline;
+    bool autotune;
+    std::string autotune_cache;
+    std::vector<int> cpus;
+    DatasetPlacement placement;
+    bool split_individuals, broadcast, shared, stream;
+#ifdef FIUNCHO_MPI
+    MPIScheduling scheduling;
+#endif
+    double weight;
+    unsigned int blocks;
+    uint64_t part, parts;
+    std::string checkpoint;
+    bool resume;
+    double checkpoint_interval;
+    double progress;
+    std::string progress_file;
+    std::string trace;
+    std::string report;
+    bool dry_run;
+    unsigned int ranks;
 } Arguments;
 
+// Parse a part of a split search, in the format i/N with 1 <= i <= N
+bool parse_part(const std::string &str, uint64_t &part, uint64_t &parts)
+{
+    const auto pos = str.find('/');
+    if (pos == std::string::npos || pos == 0 || pos == str.size() - 1 ||
+        str.find_first_not_of("0123456789/") != std::string::npos ||
+        str.find('/', pos + 1) != std::string::npos) {
+        return false;
+    }
+    try {
+        part = std::stoull(str.substr(0, pos));
+        parts = std::stoull(str.substr(pos + 1));
+    } catch (const std::logic_error &) {
+        return false;
+    }
+    return part > 0 && part <= parts;
+}
+
 Arguments read_arguments(int argc, char **argv)
 {
     // Create TCLAP CmdLine
@@ -114,6 +170,272 @@ Arguments read_arguments(int argc, char **argv)
                                   false, 10, &noutputs_constraint);
     cmd.add(noutputs);
     class : public TCLAP::Constraint<std::string>
+    {
+        bool check(const std::string &list) const
+        {
+            try {
+                return !parse_cpu_list(list).empty();
+            } catch (const std::runtime_error &) {
+                return false;
+            }
+        }
+
+        std::string shortID() const { return "cpu list"; }
+
+        std::string description() const
+        {
+            return "cpus is a comma-separated list of CPU ids and ranges";
+        }
+    } cpus_constraint;
+    TCLAP::ValueArg<std::string> cpus(
+        "", "cpus",
+        "Comma-separated list of CPU ids and ranges (e.g. 0-15,32-47) to pin "
+        "the threads to. By default, threads are not pinned.",
+        false, "", &cpus_constraint);
+    cmd.add(cpus);
+    class : public TCLAP::Constraint<std::string>
+    {
+        bool check(const std::string &placement) const
+        {
+            return placement == "default" || placement == "hugepages" ||
+                   placement == "numa";
+        }
+
+        std::string shortID() const { return "default|hugepages|numa"; }
+
+        std::string description() const
+        {
+            return "placement is one of default, hugepages or numa";
+        }
+    } placement_constraint;
+    TCLAP::ValueArg<std::string> placement(
+        "", "placement",
+        "Memory placement of the data set: default, hugepages (back the data "
+        "set with huge pages) or numa (huge pages and one copy of the data set "
+        "per NUMA node). By default, it uses the default placement.",
+        false, "default", &placement_constraint);
+    cmd.add(placement);
+    TCLAP::ValueArg<unsigned int> pipeline(
+        "", "pipeline",
+        "Number of threads that fill contingency tables for each thread that "
+        "scores them. Threads of the same group are pinned to SMT siblings, "
+        "using all available CPUs if --cpus is not set. By default, each "
+        "thread both fills and scores its own contingency tables.",
+        false, 0, "integer");
+    cmd.add(pipeline);
+    TCLAP::SwitchArg autotune(
+        "", "autotune",
+        "Time the candidate numbers of contingency tables filled by each "
+        "thread before scoring them on the first SNPs of the data set, for a "
+        "fraction of a second, and search with the fastest one. By default, "
+        "the number depends only on the order.",
+        false);
+    cmd.add(autotune);
+    TCLAP::ValueArg<std::string> autotune_cache(
+        "", "autotune-cache",
+        "Path to the file where the numbers selected by --autotune are stored "
+        "for each CPU model, instruction set, order and number of "
+        "individuals, and looked up by later executions instead of timing "
+        "them again. Implies --autotune. By default, no file is used.",
+        false, "", "path");
+    cmd.add(autotune_cache);
+    TCLAP::SwitchArg split_individuals(
+        "", "split-individuals",
+        "Split the individuals instead of the combinations among the threads "
+        "of each process. Recommended for data sets with few SNPs and a large "
+        "number of individuals.",
+        false);
+    cmd.add(split_individuals);
+    TCLAP::SwitchArg broadcast(
+        "", "broadcast",
+        "Read the input files only in the first process and broadcast the data "
+        "set to the rest of processes. By default, every process reads the "
+        "input files.",
+        false);
+    cmd.add(broadcast);
+    TCLAP::SwitchArg shared(
+        "", "shared",
+        "Store a single copy of the data set per node in shared memory, used "
+        "by all the processes running in that node. By default, each process "
+        "stores its own copy.",
+        false);
+    cmd.add(shared);
+    TCLAP::SwitchArg stream(
+        "", "stream",
+        "Start the search while the data set is still being read, exploring "
+        "the combinations of the SNPs read so far. Ignored if --broadcast or "
+        "--shared are used.",
+        false);
+    cmd.add(stream);
+    class : public TCLAP::Constraint<std::string>
+    {
+        bool check(const std::string &scheduling) const
+        {
+            return scheduling == "static" || scheduling == "dynamic" ||
+                   scheduling == "weighted" || scheduling == "blocks" ||
+                   scheduling == "individuals";
+        }
+
+        std::string shortID() const
+        {
+            return "static|dynamic|weighted|blocks|individuals";
+        }
+
+        std::string description() const
+        {
+            return "scheduling is one of static, dynamic, weighted, blocks or "
+                   "individuals";
+        }
+    } scheduling_constraint;
+    TCLAP::ValueArg<std::string> scheduling(
+        "", "scheduling",
+        "Distribution of the combinations among processes: static (fixed "
+        "round-robin assignment), dynamic (chunks requested by each process "
+        "as it completes the previous one), weighted (one contiguous range "
+        "per process, proportional to its --weight), blocks (pairs of SNP "
+        "blocks, reading only the blocks needed by each process; order 2 "
+        "only) or individuals (all combinations in every process, each one "
+        "holding a slice of the individuals). By default, it uses the static "
+        "distribution.",
+        false, "static", &scheduling_constraint);
+    cmd.add(scheduling);
+    TCLAP::ValueArg<double> weight(
+        "", "weight",
+        "Relative capacity of this process, used by the weighted scheduling. "
+        "By default, it is measured with a short calibration run before the "
+        "search.",
+        false, 0, "number");
+    cmd.add(weight);
+    TCLAP::ValueArg<unsigned int> blocks(
+        "", "blocks",
+        "Number of blocks in which the SNPs are split by the blocks "
+        "scheduling. By default, it uses about two pairs of blocks per "
+        "process.",
+        false, 0, "integer");
+    cmd.add(blocks);
+    class : public TCLAP::Constraint<std::string>
+    {
+        bool check(const std::string &str) const
+        {
+            uint64_t part, parts;
+            return parse_part(str, part, parts);
+        }
+
+        std::string shortID() const { return "i/N"; }
+
+        std::string description() const
+        {
+            return "part is in the format i/N, with 1 <= i <= N";
+        }
+    } part_constraint;
+    TCLAP::ValueArg<std::string> part(
+        "", "part",
+        "Explore only the i-th out of N parts of the search, with about the "
+        "same number of combinations each, and write the results to the "
+        "output file in binary format. The files of all parts can be merged "
+        "with fiuncho-merge. By default, the whole search is explored.",
+        false, "", &part_constraint);
+    cmd.add(part);
+    TCLAP::ValueArg<std::string> checkpoint(
+        "", "checkpoint",
+        "Directory where the progress of the search is saved periodically, "
+        "and when the process receives a SIGTERM signal. Requires the static "
+        "scheduling. By default, no progress is saved.",
+        false, "", "path");
+    cmd.add(checkpoint);
+    class : public TCLAP::Constraint<double>
+    {
+        bool check(const double &interval) const { return interval >= 0; }
+
+        std::string shortID() const { return "seconds"; }
+
+        std::string description() const
+        {
+            return "checkpoint interval is not negative";
+        }
+    } interval_constraint;
+    TCLAP::ValueArg<double> checkpoint_interval(
+        "", "checkpoint-interval",
+        "Minimum number of seconds between two saves of the progress of each "
+        "process. By default, it is 600 seconds.",
+        false, 600, &interval_constraint);
+    cmd.add(checkpoint_interval);
+    TCLAP::SwitchArg resume(
+        "", "resume",
+        "Resume the search saved in the --checkpoint directory, skipping the "
+        "combinations already explored. The number of processes and threads "
+        "can differ from the previous run.",
+        false);
+    cmd.add(resume);
+    class : public TCLAP::Constraint<double>
+    {
+        bool check(const double &interval) const { return interval >= 0; }
+
+        std::string shortID() const { return "seconds"; }
+
+        std::string description() const
+        {
+            return "progress interval is not negative";
+        }
+    } progress_constraint;
+    TCLAP::ValueArg<double> progress(
+        "", "progress",
+        "Number of seconds between two reports of the progress of the search: "
+        "combinations per second, percentage completed, estimated time left "
+        "and lowest value among the best combinations found so far. By "
+        "default, no progress is reported.",
+        false, 0, &progress_constraint);
+    cmd.add(progress);
+    TCLAP::ValueArg<std::string> progress_file(
+        "", "progress-file",
+        "Path to the file where the progress reports are written, as "
+        "tab-separated values. By default, they are written to the standard "
+        "error.",
+        false, "", "path");
+    cmd.add(progress_file);
+    TCLAP::ValueArg<std::string> trace(
+        "", "trace",
+        "Path to the file where the timeline of the execution is written, as a "
+        "Chrome trace that can be inspected with Perfetto: reading the data "
+        "set, filling and scoring blocks of combinations, merging the best "
+        "results and MPI communications of every thread of every process. By "
+        "default, no timeline is recorded.",
+        false, "", "path");
+    cmd.add(trace);
+    TCLAP::ValueArg<std::string> report(
+        "", "report",
+        "Path to the JSON file where a summary of the execution is written: "
+        "data set dimensions, implementation used, time spent reading the "
+        "data set and searching by each process and thread, combinations "
+        "evaluated per second, peak memory usage and imbalance between "
+        "threads. By default, no summary is written.",
+        false, "", "path");
+    cmd.add(report);
+    TCLAP::SwitchArg dry_run(
+        "", "dry-run",
+        "Instead of running the search, read the data set, time the search "
+        "kernels and write to the output file a JSON document with the "
+        "number of combinations and the predicted time and memory of a job of "
+        "--ranks processes with --threads threads each, including the time "
+        "spent reading the data set and gathering the results. Runs in a "
+        "single process.",
+        false);
+    cmd.add(dry_run);
+    class : public TCLAP::Constraint<unsigned int>
+    {
+        bool check(const unsigned int &ranks) const { return ranks > 0; }
+
+        std::string shortID() const { return "integer"; }
+
+        std::string description() const { return "ranks > 0"; }
+    } ranks_constraint;
+    TCLAP::ValueArg<unsigned int> ranks(
+        "", "ranks",
+        "Number of processes of the job estimated by --dry-run. By default, "
+        "1.",
+        false, 1, &ranks_constraint);
+    cmd.add(ranks);
+    class : public TCLAP::Constraint<std::string>
     {
         bool check(const std::string &path) const
         {
@@ -177,22 +499,392 @@ Arguments read_arguments(int argc, char **argv)
     args.order = order.getValue();
     args.threads = threads.getValue();
     args.noutputs = noutputs.getValue();
+    args.pipeline = pipeline.getValue();
+    args.autotune_cache = autotune_cache.getValue();
+    args.autotune = autotune.getValue() || !args.autotune_cache.empty();
+    args.split_individuals = split_individuals.getValue();
+    args.broadcast = broadcast.getValue();
+    args.shared = shared.getValue();
+    args.stream = stream.getValue();
+#ifdef FIUNCHO_MPI
+    if (scheduling.getValue() == "dynamic") {
+        args.scheduling = MPIScheduling::Dynamic;
+    } else if (scheduling.getValue() == "weighted") {
+        args.scheduling = MPIScheduling::Weighted;
+    } else if (scheduling.getValue() == "blocks") {
+        args.scheduling = MPIScheduling::BlockPairs;
+    } else if (scheduling.getValue() == "individuals") {
+        args.scheduling = MPIScheduling::Individuals;
+    } else {
+        args.scheduling = MPIScheduling::Static;
+    }
+#endif
+    args.weight = weight.getValue();
+    args.blocks = blocks.getValue();
+    args.checkpoint = checkpoint.getValue();
+    args.resume = resume.getValue();
+    args.checkpoint_interval = checkpoint_interval.getValue();
+    args.progress = progress.getValue();
+    args.progress_file = progress_file.getValue();
+    args.trace = trace.getValue();
+    args.report = report.getValue();
+    args.dry_run = dry_run.getValue();
+    args.ranks = ranks.getValue();
+    if (args.dry_run && args.split_individuals) {
+        throw TCLAP::ArgException(
+            "--dry-run does not support --split-individuals", "dry-run");
+    }
+    if (args.resume && args.checkpoint.empty()) {
+        throw TCLAP::ArgException("--resume requires --checkpoint", "resume");
+    }
+    if (part.isSet() && !args.checkpoint.empty()) {
+        throw TCLAP::ArgException("--part and --checkpoint are not compatible",
+                                  "part");
+    }
+    if (part.isSet()) {
+        parse_part(part.getValue(), args.part, args.parts);
+        --args.part;
+    } else {
+        args.part = 0;
+        args.parts = 0;
+    }
+    if (cpus.isSet()) {
+        args.cpus = parse_cpu_list(cpus.getValue());
+    } else if (args.pipeline > 0) {
+        args.cpus = available_cpus();
+    }
+    // If the number of threads is not specified, use one thread per CPU
+    if (args.threads == 0) {
+        args.threads =
+            args.cpus.empty() ? available_cpus().size() : args.cpus.size();
+    }
+    if (placement.getValue() == "hugepages") {
+        args.placement = DatasetPlacement::HugePages;
+    } else if (placement.getValue() == "numa") {
+        args.placement = DatasetPlacement::Replicated;
+    } else {
+        args.placement = DatasetPlacement::Default;
+    }
     return args;
 }
 
+#ifdef ALIGN
+constexpr size_t ALIGNMENT = ALIGN;
+#else
+constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
+
+// Seconds elapsed since a point in time
+double seconds_since(const std::chrono::steady_clock::time_point &time)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         time)
+        .count();
+}
+
+// Report the progress of a search of total combinations, if enabled
+std::unique_ptr<Progress> monitor(const Arguments &args, const uint64_t total,
+                                  const uint64_t completed)
+{
+    if (args.progress <= 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<Progress>(
+        new Progress(total, completed, args.progress, args.progress_file));
+}
+
+// Run the search in this process, over all the combinations or over the part
+// selected with --part, saving its progress if --checkpoint is used
+template <class T, class... Params>
+std::vector<Result<int, float>> run_search(const Arguments &args,
+                                           Params &&...params)
+{
+    std::unique_ptr<Tracer> tracer(args.trace.empty() ? nullptr
+                                                      : new Tracer());
+    Tracer::Scope load("dataset load");
+    auto time = std::chrono::steady_clock::now();
+    const auto dataset =
+        args.stream ? Dataset<uint64_t>::stream<ALIGNMENT>(
+                          args.tped, args.tfam, args.placement)
+                    : Dataset<uint64_t>::read<ALIGNMENT>(args.tped, args.tfam,
+                                                         args.placement);
+    load.end();
+    Report *summary = Report::current();
+    if (summary != nullptr) {
+        summary->dataset(dataset);
+        summary->local().load = seconds_since(time);
+    }
+    time = std::chrono::steady_clock::now();
+    // Check Dataset size to avoid int overflow
+    if (dataset.snps > (size_t)std::numeric_limits<int>::max()) {
+        throw std::runtime_error(
+            "Input data limit exceeded: Dataset contains more than " +
+            std::to_string(std::numeric_limits<int>::max()) + " SNPs");
+    }
+    const uint64_t combinations =
+        Distribution<int>::binomial(dataset.snps, args.order);
+    if ((args.parts > 0 || !args.checkpoint.empty()) &&
+        combinations == std::numeric_limits<uint64_t>::max()) {
+        throw std::runtime_error(
+            "Input data limit exceeded: too many combinations to split the "
+            "search");
+    }
+    T search(std::forward<Params>(params)...);
+    std::vector<Result<int, float>> results;
+    if (!args.checkpoint.empty()) {
+        Checkpoint progress(args.checkpoint, 0, dataset.snps, args.order,
+                            args.noutputs, args.checkpoint_interval);
+        if (args.resume) {
+            progress.load(true);
+        } else {
+            progress.clear();
+        }
+        const auto report = monitor(args, combinations, progress.completed());
+        results = progress.run(search, dataset);
+    } else {
+        const auto distribution =
+            args.parts > 0
+                ? Distribution<int>::part(dataset.snps, args.order - 1,
+                                          args.part, args.parts)
+                : Distribution<int>(dataset.snps, args.order - 1, 1, 0);
+        const auto report =
+            monitor(args,
+                    Distribution<int>::extensions(
+                        dataset.snps, args.order - 1, distribution.last) -
+                        Distribution<int>::extensions(
+                            dataset.snps, args.order - 1, distribution.first),
+                    0);
+        results = search.run(dataset, args.order, distribution, args.noutputs);
+    }
+    dataset.finish();
+    if (summary != nullptr) {
+        summary->local().compute = seconds_since(time);
+        summary->local().peak_rss = Report::peak_rss();
+    }
+    if (tracer) {
+        tracer->write(args.trace);
+    }
+    return results;
+}
+
+// Run the search in this process, splitting either the combinations or the
+// individuals among threads
+std::vector<Result<int, float>> run_local(const Arguments &args)
+{
+    if (args.split_individuals) {
+        return run_search<SlicedSearch>(
+            args, args.threads, args.cpus,
+            Autotuner(args.autotune, args.autotune_cache));
+    }
+    // A checkpointed search runs one chunk after another, so the threads are
+    // kept between them
+    return run_search<ThreadedSearch>(args, args.threads, args.cpus,
+                                      !args.checkpoint.empty(), args.pipeline,
+                                      Autotuner(args.autotune,
+                                                args.autotune_cache));
+}
+
+// Predict the time and memory of the search without running it, and write
+// the estimate to the output file
+void run_estimate(const Arguments &args)
+{
+#ifdef FIUNCHO_MPI
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (size > 1) {
+        throw std::runtime_error("--dry-run runs in a single process, set the "
+                                 "number of processes of the job with --ranks");
+    }
+#endif
+    Estimate estimate;
+    estimate.version = FIUNCHO_VERSION;
+    estimate.isa = FIUNCHO_ISA;
+    estimate.order = args.order;
+    estimate.outputs = args.noutputs;
+    estimate.ranks = args.ranks;
+    estimate.threads = args.threads;
+    estimate.broadcast = args.broadcast;
+    // Read the data set
+    auto time = std::chrono::steady_clock::now();
+    const auto dataset = Dataset<uint64_t>::read<ALIGNMENT>(
+        args.tped, args.tfam, args.placement);
+    estimate.load = seconds_since(time);
+    estimate.load_rss = Report::peak_rss();
+    estimate.dataset(dataset);
+    if (dataset.snps < (size_t)args.order) {
+        throw std::runtime_error(
+            "The data set contains fewer SNPs than the order of the search");
+    }
+    // Count the combinations of the search, or of the part selected
+    if (args.parts > 0) {
+        const auto part = Distribution<int>::part(dataset.snps, args.order - 1,
+                                                  args.part, args.parts);
+        estimate.combinations =
+            Distribution<int>::extensions(dataset.snps, args.order - 1,
+                                          part.last) -
+            Distribution<int>::extensions(dataset.snps, args.order - 1,
+                                          part.first);
+    } else {
+        estimate.combinations =
+            Distribution<int>::binomial(dataset.snps, args.order);
+    }
+    // Select the block size as the search would. Its cost is only paid again
+    // by the search if the size is not stored in a cache
+    Autotuner tuner(args.autotune, args.autotune_cache);
+    time = std::chrono::steady_clock::now();
+    estimate.block_size = tuner.block_size(dataset, args.order);
+    estimate.tuning =
+        args.autotune && args.autotune_cache.empty() ? seconds_since(time) : 0;
+    // Time the kernels of one thread, after warming up the caches
+    Autotuner::throughput(dataset, args.order, estimate.block_size, 0.05);
+    estimate.rate = Autotuner::throughput(dataset, args.order,
+                                          estimate.block_size, 0.25);
+    estimate.merge = Estimate::merge_time(
+        (size_t)args.threads * args.noutputs, args.noutputs, args.order);
+    estimate.pair_merge =
+        Estimate::merge_time(2 * args.noutputs, args.noutputs, args.order);
+    estimate.write(args.output);
+}
+
+#ifdef FIUNCHO_MPI
+// Name of a scheduling policy, as given in the command line
+const char *scheduling_name(const MPIScheduling scheduling)
+{
+    switch (scheduling) {
+    case MPIScheduling::Dynamic:
+        return "dynamic";
+    case MPIScheduling::Weighted:
+        return "weighted";
+    case MPIScheduling::BlockPairs:
+        return "blocks";
+    case MPIScheduling::Individuals:
+        return "individuals";
+    default:
+        return "static";
+    }
+}
+#endif
+
+#ifdef FIUNCHO_MPI
+// Level of thread support requested to MPI. Only the main thread calls MPI,
+// except for the monitor thread of --progress, that reduces the counters of
+// all processes while the search runs. The option is looked up before the
+// arguments are parsed, since MPI must be initialized first
+int required_thread_support(const int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--progress" || arg.compare(0, 11, "--progress=") == 0) {
+            return MPI_THREAD_MULTIPLE;
+        }
+    }
+    return MPI_THREAD_FUNNELED;
+}
+#endif
+
+// Terminate all processes after an error
+[[noreturn]] void abort_execution()
+{
+#ifdef FIUNCHO_MPI
+    MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+    std::exit(1);
+}
+
 int main(int argc, char **argv)
 {
-    int rank;
-    MPI_Init(&argc, &argv);
+#ifdef FIUNCHO_MPI
+    int rank, provided;
+    MPI_Init_thread(&argc, &argv, required_thread_support(argc, argv),
+                    &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#else
+    const int rank = 0;
+#endif
     try {
+#ifdef FIUNCHO_MPI
+        // The search threads run alongside the main thread. The support
+        // needed by --progress is checked by MPIEngine, since it is only
+        // used with more than one process
+        if (provided < MPI_THREAD_FUNNELED) {
+            throw std::runtime_error(
+                "The MPI library does not provide MPI_THREAD_FUNNELED support");
+        }
+#endif
         // Read arguments
         auto args = read_arguments(argc, argv);
+        if (args.dry_run) {
+            run_estimate(args);
+#ifdef FIUNCHO_MPI
+            MPI_Finalize();
+#endif
+            return 0;
+        }
+        // Collect the summary of the execution, if requested
+        std::unique_ptr<Report> report(args.report.empty() ? nullptr
+                                                            : new Report());
+        if (report) {
+            report->version = FIUNCHO_VERSION;
+            report->isa = FIUNCHO_ISA;
+            report->backend = args.split_individuals ? "SlicedSearch"
+                                                     : "ThreadedSearch";
+            report->scheduling = "none";
+            report->order = args.order;
+            report->outputs = args.noutputs;
+        }
         // Execute search
-        MPIEngine engine;
-        auto results = engine.run<ThreadedSearch>(
-            args.tped, args.tfam, args.order, args.noutputs, args.threads);
-        if (rank == 0) {
+        std::vector<Result<int, float>> results;
+#ifdef FIUNCHO_MPI
+        if (args.parts > 0) {
+            int size;
+            MPI_Comm_size(MPI_COMM_WORLD, &size);
+            if (size > 1) {
+                throw std::runtime_error(
+                    "--part runs in a single process, launch each part as an "
+                    "independent job");
+            }
+            results = run_local(args);
+        } else {
+            MPIEngine engine(args.placement, args.broadcast, args.shared,
+                             args.scheduling, args.weight, args.blocks,
+                             args.stream, args.checkpoint, args.resume,
+                             args.checkpoint_interval, args.progress,
+                             args.progress_file, args.trace);
+            if (report) {
+                report->scheduling = scheduling_name(args.scheduling);
+                if (args.scheduling == MPIScheduling::Individuals) {
+                    report->backend = "MPISlicedSearch";
+                }
+            }
+            if (args.scheduling == MPIScheduling::Individuals) {
+                results = engine.run<MPISlicedSearch>(
+                    args.tped, args.tfam, args.order, args.noutputs,
+                    args.threads, args.cpus);
+            } else if (args.split_individuals) {
+                results = engine.run<SlicedSearch>(
+                    args.tped, args.tfam, args.order, args.noutputs,
+                    args.threads, args.cpus,
+                    Autotuner(args.autotune, args.autotune_cache));
+            } else {
+                // Keep the threads between the chunks of a dynamic or
+                // checkpointed search
+                const bool persistent =
+                    args.scheduling == MPIScheduling::Dynamic ||
+                    !args.checkpoint.empty();
+                results = engine.run<ThreadedSearch>(
+                    args.tped, args.tfam, args.order, args.noutputs,
+                    args.threads, args.cpus, persistent, args.pipeline,
+                    Autotuner(args.autotune, args.autotune_cache));
+            }
+        }
+#else
+        results = run_local(args);
+#endif
+        if (args.parts > 0) {
+            // Write the results of the part in binary format
+            PartialResults::write(args.output, args.part, args.parts,
+                                  args.order, results);
+        } else if (rank == 0) {
             // Write results to the output file
             std::ofstream of(args.output, std::ios::out);
             for (auto r : results) {
@@ -200,13 +892,18 @@ int main(int argc, char **argv)
             }
             of.close();
         }
+        if (report && rank == 0) {
+            report->write(args.report);
+        }
     } catch (const TCLAP::ArgException &e) {
         std::cerr << e.error() << std::endl;
-        MPI_Abort(MPI_COMM_WORLD, 1);
+        abort_execution();
     } catch (const std::runtime_error &e) {
         std::cerr << e.what() << std::endl;
-        MPI_Abort(MPI_COMM_WORLD, 1);
+        abort_execution();
     }
+#ifdef FIUNCHO_MPI
     MPI_Finalize();
+#endif
     return 0;
 }
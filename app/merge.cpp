@@ -0,0 +1,110 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file merge.cpp
+ * @author Christian Ponte
+ *
+ * @brief Merge tool. Reads the binary files written by the parts of a search
+ * launched with `fiuncho --part i/N`, and writes the final results to an output
+ * file in the same format as fiuncho.
+ */
+
+#include <fiuncho/utils/PartialResults.h>
+#include <fstream>
+#include <iostream>
+#include <tclap/CmdLine.h>
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    try {
+        // Create TCLAP CmdLine
+        TCLAP::CmdLine cmd(
+            "Merge the results of the parts of a search launched with "
+            "fiuncho --part. Full documentation available at "
+            "https://fiuncho.readthedocs.io/",
+            ' ', FIUNCHO_VERSION);
+        class : public TCLAP::StdOutput
+        {
+          public:
+            virtual void failure(TCLAP::CmdLineInterface &,
+                                 TCLAP::ArgException &e)
+            {
+                throw e;
+            }
+        } cmd_output;
+        cmd.setOutput(&cmd_output);
+        class : public TCLAP::Constraint<int>
+        {
+            bool check(const int &noutputs) const { return noutputs > 0; }
+
+            std::string shortID() const { return "integer"; }
+
+            std::string description() const
+            {
+                return "noutputs is greater than 0";
+            }
+        } noutputs_constraint;
+        TCLAP::ValueArg<int> noutputs("n", "noutputs",
+                                      "Number of combinations to output. By "
+                                      "default, it outputs 10 combinations.",
+                                      false, 10, &noutputs_constraint);
+        cmd.add(noutputs);
+        TCLAP::UnlabeledValueArg<std::string> output(
+            "output", "Path to the output file.", true, "", "path");
+        cmd.add(output);
+        class : public TCLAP::Constraint<std::string>
+        {
+            bool check(const std::string &path) const
+            {
+                return access(path.c_str(), R_OK) == 0;
+            }
+
+            std::string shortID() const { return "path"; }
+
+            std::string description() const
+            {
+                return "path points to a readable file";
+            }
+        } infile_constraint;
+        TCLAP::UnlabeledMultiArg<std::string> parts(
+            "parts", "Paths to the files written by all parts of the search.",
+            true, &infile_constraint);
+        cmd.add(parts);
+        cmd.parse(argc, argv);
+        // Merge the parts and write the results to the output file
+        const auto results =
+            PartialResults::merge(parts.getValue(), noutputs.getValue());
+        std::ofstream of(output.getValue(), std::ios::out);
+        for (const auto &r : results) {
+            of << r.str() << '\n';
+        }
+        of.close();
+        if (!of) {
+            throw std::runtime_error("Error writing file " +
+                                     output.getValue());
+        }
+    } catch (const TCLAP::ArgException &e) {
+        std::cerr << e.error() << std::endl;
+        return 1;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
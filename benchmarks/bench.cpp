@@ -0,0 +1,649 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fiuncho/ContingencyTable.h>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/GenotypeTable.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/algorithms/MutualInformation.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/dataset/Synthetic.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <pthread.h>
+#include <sstream>
+#include <tclap/CmdLine.h>
+#include <thread>
+#include <vector>
+
+/*
+ *  Benchmark harness of the kernels of the search. For every combination of
+ *  kernel, order and number of threads given, it:
+ *      1. Spawns the threads, pinned to the CPUs given, and initializes the
+ *         tables of each thread
+ *      2. Warms up the CPU cores running the benchmark without measuring it
+ *      3. Measures the wall time of each repetition, from the moment all
+ *         threads start until the last one finishes
+ *      4. Summarizes the times of the repetitions, and prints them as a JSON
+ *         document with one result per line
+ *
+ *  The kernels measured are:
+ *      gtable: GenotypeTable::combine of a table of order - 1 SNPs with every
+ *              SNP of the data set
+ *      ctable: GenotypeTable::combine_and_popcnt of a table of order - 1 SNPs
+ *              with every SNP of the data set
+ *      mi:     MutualInformation::compute of a contingency table for each SNP
+ *              of the data set
+ *      search: ThreadedSearch::run of all the combinations of the data set
+ *
+ *  Each thread of the first three kernels goes through the SNPs of the data
+ *  set as many times as iterations, while the search explores all
+ *  combinations once per repetition, with all threads together.
+ *
+ *  The data set is generated in memory, unless TPED and TFAM files are given,
+ *  optionally with a planted interaction that the search is expected to find.
+ *  With a baseline, the results are compared to those of a previous run, and
+ *  the program fails if any of them is slower than the tolerance allows. In
+ *  builds with PERF_COUNTERS, the hardware events counted per table by each
+ *  thread are printed to the standard error.
+ */
+
+#ifdef ALIGN
+constexpr size_t ALIGNMENT = ALIGN;
+#else
+constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
+
+namespace
+{
+// Summary of the times of the repetitions of a benchmark
+struct Summary {
+    double min, median, mean, stddev, max;
+
+    explicit Summary(std::vector<double> times)
+    {
+        std::sort(times.begin(), times.end());
+        const size_t n = times.size();
+        min = times.front();
+        max = times.back();
+        median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+        mean = 0;
+        for (const auto t : times) {
+            mean += t;
+        }
+        mean /= n;
+        stddev = 0;
+        for (const auto t : times) {
+            stddev += (t - mean) * (t - mean);
+        }
+        stddev = n > 1 ? std::sqrt(stddev / (n - 1)) : 0;
+    }
+};
+
+// Result of a benchmark
+struct Measure {
+    std::string kernel;
+    int order;
+    unsigned int threads;
+    // Tables or combinations processed in each repetition
+    uint64_t items;
+    Summary seconds;
+    // Whether the search found the planted interaction as the best
+    // combination: 1 if it did, 0 if it did not, -1 if it does not apply
+    int found;
+
+    double throughput() const
+    {
+        return seconds.median > 0 ? items / seconds.median : 0;
+    }
+
+    // Identifier used to match a result with the one of a baseline
+    std::string key() const
+    {
+        return kernel + '/' + std::to_string(order) + '/' +
+               std::to_string(threads);
+    }
+
+    std::string json() const
+    {
+        std::ostringstream os;
+        os << "{\"kernel\": \"" << kernel << "\", \"order\": " << order
+           << ", \"threads\": " << threads << ", \"items\": " << items
+           << ", \"seconds\": {\"min\": " << seconds.min
+           << ", \"median\": " << seconds.median
+           << ", \"mean\": " << seconds.mean
+           << ", \"stddev\": " << seconds.stddev
+           << ", \"max\": " << seconds.max
+           << "}, \"items_per_second\": " << throughput();
+        if (found >= 0) {
+            os << ", \"found_planted\": " << (found ? "true" : "false");
+        }
+        os << '}';
+        return os.str();
+    }
+};
+
+// One pass of a kernel over the SNPs of a data set, with the tables of a
+// single thread
+class Pass
+{
+    const std::string kernel;
+    const Dataset<uint64_t> &dataset;
+    const int order;
+    // Tables of the first order - 1 SNPs, combined incrementally
+    std::vector<GenotypeTable<uint64_t>> prefix;
+    GenotypeTable<uint64_t> table;
+    ContingencyTable<uint32_t> ctable;
+    std::vector<ContingencyTable<uint32_t>> ctables;
+    MutualInformation<float> mi;
+    volatile float sink;
+
+    // Table combined with each SNP of the data set, or the one the prefix of
+    // order o is combined from
+    const GenotypeTable<uint64_t> &first(const int o = 0) const
+    {
+        if (o == 2 || (o == 0 && prefix.empty())) {
+            return dataset[0];
+        }
+        return o == 0 ? prefix.back() : prefix[o - 3];
+    }
+
+  public:
+    Pass(const std::string &kernel, const Dataset<uint64_t> &dataset,
+         const int order)
+        : kernel(kernel), dataset(dataset), order(order),
+          table(order, dataset[0].cases_words, dataset[0].ctrls_words),
+          ctable(order, dataset[0].cases_words, dataset[0].ctrls_words),
+          mi(dataset.cases, dataset.ctrls), sink(0)
+    {
+        for (auto o = 2; o < order; o++) {
+            prefix.emplace_back(o, dataset[0].cases_words,
+                                dataset[0].ctrls_words);
+            GenotypeTable<uint64_t>::combine(first(o), dataset[o - 1],
+                                             prefix.back());
+        }
+        if (kernel == "mi") {
+            ctables.reserve(dataset.snps - (order - 1));
+            for (size_t snp = order - 1; snp < dataset.snps; snp++) {
+                ctables.emplace_back(order, dataset[0].cases_words,
+                                     dataset[0].ctrls_words);
+                GenotypeTable<uint64_t>::combine_and_popcnt(
+                    first(), dataset[snp], ctables.back());
+            }
+        }
+    }
+
+    // Run the kernel, and return the number of tables processed
+    uint64_t operator()()
+    {
+        if (kernel == "gtable") {
+            for (size_t snp = order - 1; snp < dataset.snps; snp++) {
+                GenotypeTable<uint64_t>::combine(first(), dataset[snp], table);
+            }
+        } else if (kernel == "ctable") {
+            for (size_t snp = order - 1; snp < dataset.snps; snp++) {
+                GenotypeTable<uint64_t>::combine_and_popcnt(
+                    first(), dataset[snp], ctable);
+            }
+        } else {
+            float sum = 0;
+            for (const auto &c : ctables) {
+                sum += mi.compute(c);
+            }
+            sink = sum;
+        }
+        return dataset.snps - (order - 1);
+    }
+
+};
+
+// Measure a kernel with a number of threads, each running the passes of its
+// repetitions on its own CPU
+Measure run_kernel(const std::string &kernel, const Dataset<uint64_t> &dataset,
+                   const int order, const unsigned int threads,
+                   const std::vector<int> &cpus, const int repetitions,
+                   const int iterations, const int warmup)
+{
+    std::vector<double> times(repetitions);
+    std::vector<uint64_t> items(threads, 0);
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads);
+    const auto body = [&](const unsigned int id) {
+        const int cpu = cpus[id % cpus.size()];
+        pin_thread({cpu});
+        Pass pass(kernel, dataset, order);
+        LoopCounters counters;
+        for (auto r = -warmup; r < repetitions; ++r) {
+            uint64_t n = 0;
+            if (r == 0) {
+                counters.start();
+            }
+            pthread_barrier_wait(&barrier);
+            const auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < iterations; ++i) {
+                n += pass();
+            }
+            pthread_barrier_wait(&barrier);
+            if (id == 0 && r >= 0) {
+                times[r] = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+            }
+            items[id] = n;
+        }
+        counters.stop(cpu, (double)repetitions * items[id]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++) {
+        pool.emplace_back(body, i);
+    }
+    body(0);
+    for (auto &t : pool) {
+        t.join();
+    }
+    pthread_barrier_destroy(&barrier);
+    uint64_t total = 0;
+    for (const auto n : items) {
+        total += n;
+    }
+    return {kernel, order, threads, total, Summary(times), -1};
+}
+
+// Measure a ThreadedSearch of all the combinations of the data set, and check
+// whether it finds the planted interaction, if it is of the same order
+Measure run_search(const Dataset<uint64_t> &dataset, const int order,
+                   const unsigned int threads, const std::vector<int> &cpus,
+                   const int repetitions, const int warmup,
+                   const std::vector<size_t> &planted)
+{
+    std::vector<int> selected;
+    for (unsigned int i = 0; i < threads; i++) {
+        selected.push_back(cpus[i % cpus.size()]);
+    }
+    ThreadedSearch search(threads, selected);
+    Distribution<int> distribution(dataset.snps, order - 1, 1, 0);
+    std::vector<double> times(repetitions);
+    std::vector<Result<int, float>> results;
+    for (auto r = -warmup; r < repetitions; ++r) {
+        const auto start = std::chrono::steady_clock::now();
+        results = search.run(dataset, order, distribution, 10);
+        if (r >= 0) {
+            times[r] = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        }
+    }
+    int found = -1;
+    if (planted.size() == (size_t)order) {
+        std::vector<int> expected(planted.begin(), planted.end());
+        std::sort(expected.begin(), expected.end());
+        found = !results.empty() && results[0].combination == expected;
+    }
+    return {"search", order, threads,
+            Distribution<int>::binomial(dataset.snps, order), Summary(times),
+            found};
+}
+
+// Value of a field in a line of the JSON document written by this program
+std::string field(const std::string &line, const std::string &name)
+{
+    const std::string tag = '"' + name + "\": ";
+    const auto pos = line.find(tag);
+    if (pos == std::string::npos) {
+        return "";
+    }
+    const auto first = pos + tag.size();
+    auto value = line.substr(first, line.find_first_of(",}", first) - first);
+    value.erase(std::remove(value.begin(), value.end(), '"'), value.end());
+    return value;
+}
+
+// Throughput of each result of a previous run, by the key of the result
+std::map<std::string, double> read_baseline(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error while opening " + path +
+                                 ", check file path/permissions");
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        const auto kernel = field(line, "kernel");
+        if (!kernel.empty()) {
+            baseline[kernel + '/' + field(line, "order") + '/' +
+                     field(line, "threads")] =
+                std::strtod(field(line, "items_per_second").c_str(),
+                            nullptr);
+        }
+    }
+    return baseline;
+}
+
+// Check that a list only contains positive integers
+std::vector<int> positive_ints(const std::string &list, const std::string &arg)
+{
+    const auto ints = split_into_ints(list, ',');
+    for (const auto i : ints) {
+        if (i <= 0) {
+            throw TCLAP::ArgException("is not a list of positive integers",
+                                      arg);
+        }
+    }
+    return ints;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try {
+        TCLAP::CmdLine cmd("Benchmark the kernels of Fiuncho on a synthetic or "
+                           "real data set, and write the results as JSON.",
+                           ' ', FIUNCHO_VERSION);
+        class : public TCLAP::StdOutput
+        {
+          public:
+            virtual void failure(TCLAP::CmdLineInterface &,
+                                 TCLAP::ArgException &e)
+            {
+                throw e;
+            }
+        } cmd_output;
+        cmd.setOutput(&cmd_output);
+        TCLAP::ValueArg<std::string> kernels(
+            "k", "kernels",
+            "Comma-separated list of kernels to measure, among gtable, ctable, "
+            "mi and search. By default, all of them are measured.",
+            false, "gtable,ctable,mi,search", "list");
+        cmd.add(kernels);
+        TCLAP::ValueArg<std::string> orders(
+            "o", "orders",
+            "Comma-separated list of orders of the combinations. By default, "
+            "orders 2 and 3 are measured.",
+            false, "2,3", "list");
+        cmd.add(orders);
+        TCLAP::ValueArg<std::string> threads(
+            "t", "threads",
+            "Comma-separated list of numbers of threads. By default, a single "
+            "thread is used.",
+            false, "1", "list");
+        cmd.add(threads);
+        TCLAP::ValueArg<std::string> cpus(
+            "", "cpus",
+            "CPUs the threads are pinned to, in order, as a list of ids and "
+            "ranges such as 0-3,8. By default, the CPUs the program is "
+            "allowed to run on.",
+            false, "", "cpu list");
+        cmd.add(cpus);
+        TCLAP::ValueArg<int> repetitions(
+            "r", "repetitions",
+            "Number of measured repetitions of each benchmark. By default, 5.",
+            false, 5, "integer");
+        cmd.add(repetitions);
+        TCLAP::ValueArg<int> iterations(
+            "i", "iterations",
+            "Number of passes over the SNPs of each thread in a repetition of "
+            "the gtable, ctable and mi kernels. By default, 10.",
+            false, 10, "integer");
+        cmd.add(iterations);
+        TCLAP::ValueArg<int> warmup(
+            "w", "warmup",
+            "Number of repetitions run before measuring. By default, 1.", false,
+            1, "integer");
+        cmd.add(warmup);
+        TCLAP::ValueArg<size_t> snps(
+            "", "snps",
+            "Number of SNPs of the synthetic data set. By default, 256.", false,
+            256, "integer");
+        cmd.add(snps);
+        TCLAP::ValueArg<size_t> cases(
+            "", "cases",
+            "Number of cases of the synthetic data set. By default, 1024.",
+            false, 1024, "integer");
+        cmd.add(cases);
+        TCLAP::ValueArg<size_t> ctrls(
+            "", "ctrls",
+            "Number of controls of the synthetic data set. By default, 1024.",
+            false, 1024, "integer");
+        cmd.add(ctrls);
+        TCLAP::ValueArg<double> maf_min(
+            "", "maf-min",
+            "Smallest minor allele frequency of the SNPs of the synthetic "
+            "data set, which are drawn uniformly between the minimum and the "
+            "maximum. By default, 0.05.",
+            false, 0.05, "number");
+        cmd.add(maf_min);
+        TCLAP::ValueArg<double> maf_max(
+            "", "maf-max",
+            "Largest minor allele frequency of the SNPs of the synthetic data "
+            "set. By default, 0.5.",
+            false, 0.5, "number");
+        cmd.add(maf_max);
+        TCLAP::ValueArg<uint64_t> seed(
+            "", "seed",
+            "Seed of the synthetic data set. By default, 0.", false, 0,
+            "integer");
+        cmd.add(seed);
+        TCLAP::ValueArg<std::string> model(
+            "", "model",
+            "Penetrance model of an interaction planted in the synthetic data "
+            "set, among xor, threshold and multiplicative. The search kernel "
+            "reports whether it finds the interaction. By default, none.",
+            false, "none", "model");
+        cmd.add(model);
+        TCLAP::ValueArg<std::string> planted(
+            "", "planted",
+            "Comma-separated list of the indices of the SNPs of the planted "
+            "interaction. By default, 0,1.",
+            false, "0,1", "list");
+        cmd.add(planted);
+        TCLAP::ValueArg<double> effect(
+            "", "effect",
+            "Increase of the penetrance of the genotypes at risk of the "
+            "planted interaction, over a baseline of 0.1. By default, 1.",
+            false, 1, "number");
+        cmd.add(effect);
+        TCLAP::ValueArg<std::string> tped(
+            "", "tped",
+            "Path to a tped file to benchmark instead of a synthetic data set. "
+            "It requires --tfam.",
+            false, "", "path");
+        cmd.add(tped);
+        TCLAP::ValueArg<std::string> tfam(
+            "", "tfam", "Path to the tfam file of --tped.", false, "", "path");
+        cmd.add(tfam);
+        TCLAP::ValueArg<std::string> output(
+            "", "output",
+            "Path to the JSON file where the results are written. By default, "
+            "they are written to the standard output.",
+            false, "", "path");
+        cmd.add(output);
+        TCLAP::ValueArg<std::string> baseline(
+            "", "baseline",
+            "Path to the JSON file written by a previous run. The program "
+            "fails if any benchmark processes fewer items per second than "
+            "the same benchmark of the baseline, minus the tolerance.",
+            false, "", "path");
+        cmd.add(baseline);
+        TCLAP::ValueArg<double> tolerance(
+            "", "tolerance",
+            "Fraction of the throughput of the baseline that a benchmark may "
+            "lose without failing. By default, 0.05.",
+            false, 0.05, "number");
+        cmd.add(tolerance);
+        cmd.parse(argc, argv);
+
+        // Check the arguments
+        std::vector<std::string> kernel_list;
+        std::stringstream ks(kernels.getValue());
+        for (std::string k; std::getline(ks, k, ',');) {
+            if (k != "gtable" && k != "ctable" && k != "mi" && k != "search") {
+                throw TCLAP::ArgException("unknown kernel " + k, "kernels");
+            }
+            kernel_list.push_back(k);
+        }
+        const auto order_list = positive_ints(orders.getValue(), "orders");
+        const auto thread_list = positive_ints(threads.getValue(), "threads");
+        const auto cpu_list = cpus.getValue().empty()
+                                  ? available_cpus()
+                                  : parse_cpu_list(cpus.getValue());
+        if (repetitions.getValue() <= 0 || iterations.getValue() <= 0 ||
+            warmup.getValue() < 0) {
+            throw TCLAP::ArgException(
+                "repetitions and iterations must be positive", "repetitions");
+        }
+        if (tped.getValue().empty() != tfam.getValue().empty()) {
+            throw TCLAP::ArgException("--tped and --tfam go together", "tped");
+        }
+
+        // Data set
+        const bool synthetic = tped.getValue().empty();
+        Synthetic description(snps.getValue(), cases.getValue(),
+                              ctrls.getValue(), maf_min.getValue(),
+                              maf_max.getValue(), seed.getValue());
+        if (model.getValue() != "none" && synthetic) {
+            const std::map<std::string, InteractionModel> models = {
+                {"xor", InteractionModel::XOR},
+                {"threshold", InteractionModel::Threshold},
+                {"multiplicative", InteractionModel::Multiplicative}};
+            if (models.count(model.getValue()) == 0) {
+                throw TCLAP::ArgException("unknown model " + model.getValue(),
+                                          "model");
+            }
+            std::vector<size_t> indices;
+            for (const auto i : split_into_ints(planted.getValue(), ',')) {
+                if (i < 0) {
+                    throw TCLAP::ArgException("is not a list of indices",
+                                              "planted");
+                }
+                indices.push_back(i);
+            }
+            description.plant(models.at(model.getValue()), indices, 0.1,
+                              effect.getValue());
+        }
+        const auto dataset =
+            synthetic ? description.dataset<uint64_t, ALIGNMENT>()
+                      : Dataset<uint64_t>::read<ALIGNMENT>(tped.getValue(),
+                                                           tfam.getValue());
+        for (const auto o : order_list) {
+            if (o < 2 || (size_t)o > dataset.snps) {
+                throw TCLAP::ArgException(
+                    "orders must be between 2 and the number of SNPs",
+                    "orders");
+            }
+        }
+
+        // Benchmarks
+        std::vector<Measure> measures;
+        for (const auto &k : kernel_list) {
+            for (const auto o : order_list) {
+                for (const auto t : thread_list) {
+                    measures.push_back(
+                        k == "search"
+                            ? run_search(dataset, o, t, cpu_list,
+                                         repetitions.getValue(),
+                                         warmup.getValue(),
+                                         description.planted())
+                            : run_kernel(k, dataset, o, t, cpu_list,
+                                         repetitions.getValue(),
+                                         iterations.getValue(),
+                                         warmup.getValue()));
+                }
+            }
+        }
+
+        // Results
+        std::ostringstream os;
+        os << "{\n  \"version\": \"" << FIUNCHO_VERSION << "\",\n  \"isa\": \""
+           << FIUNCHO_ISA << "\",\n  \"repetitions\": "
+           << repetitions.getValue()
+           << ",\n  \"iterations\": " << iterations.getValue()
+           << ",\n  \"dataset\": {\"source\": \""
+           << (synthetic ? "synthetic" : tped.getValue())
+           << "\", \"snps\": " << dataset.snps
+           << ", \"cases\": " << dataset.cases
+           << ", \"ctrls\": " << dataset.ctrls
+           << ", \"cases_words\": " << dataset[0].cases_words
+           << ", \"ctrls_words\": " << dataset[0].ctrls_words;
+        if (synthetic) {
+            os << ", \"maf_min\": " << description.maf_min
+               << ", \"maf_max\": " << description.maf_max
+               << ", \"seed\": " << description.seed;
+            if (!description.planted().empty()) {
+                os << ", \"model\": \"" << model.getValue()
+                   << "\", \"planted\": [";
+                for (size_t i = 0; i < description.planted().size(); i++) {
+                    os << (i > 0 ? ", " : "") << description.planted()[i];
+                }
+                os << ']';
+            }
+        }
+        os << "},\n  \"results\": [";
+        for (size_t i = 0; i < measures.size(); i++) {
+            os << (i > 0 ? "," : "") << "\n    " << measures[i].json();
+        }
+        os << "\n  ]\n}\n";
+        if (output.getValue().empty()) {
+            std::cout << os.str();
+        } else {
+            std::ofstream file(output.getValue(), std::ios::out);
+            file << os.str();
+            if (!file) {
+                throw std::runtime_error("Error writing file " +
+                                         output.getValue());
+            }
+        }
+
+        // Comparison with the baseline
+        if (!baseline.getValue().empty()) {
+            const auto previous = read_baseline(baseline.getValue());
+            bool regression = false;
+            for (const auto &m : measures) {
+                const auto it = previous.find(m.key());
+                if (it == previous.end() || it->second <= 0) {
+                    continue;
+                }
+                const double ratio = m.throughput() / it->second;
+                std::cerr << m.key() << ": " << ratio << "x the baseline";
+                if (ratio < 1 - tolerance.getValue()) {
+                    std::cerr << ", regression";
+                    regression = true;
+                }
+                std::cerr << '\n';
+            }
+            if (regression) {
+                return 2;
+            }
+        }
+    } catch (const TCLAP::ArgException &e) {
+        std::cerr << e.error() << std::endl;
+        return 1;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,10 @@
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
+#ifdef PERF_COUNTERS
+#include <fiuncho/utils/PerfCounters.h>
+#endif
 
 std::vector<int> split_into_ints(const std::string &s, const char sep)
 {
@@ -13,3 +18,40 @@ std::vector<int> split_into_ints(const std::string &s, const char sep)
     ints.push_back(atoi(s.substr(prev).c_str()));
     return ints;
 }
+
+/*
+ * Hardware counters of the measured loop of a thread. In builds with
+ * PERF_COUNTERS, stop() prints the counts per iteration to the standard error.
+ * Otherwise, it does nothing.
+ */
+class LoopCounters
+{
+#ifdef PERF_COUNTERS
+    PerfCounters counters;
+    PerfCounters::Values first;
+#endif
+
+  public:
+    void start()
+    {
+#ifdef PERF_COUNTERS
+        first = counters.read();
+#endif
+    }
+
+#ifdef PERF_COUNTERS
+    void stop(const int affinity, const double iterations)
+    {
+        const auto counts = PerfCounters::delta(first, counters.read());
+        std::ostringstream os;
+        os << "Thread on CPU " << affinity << ": "
+           << PerfCounters::str(counts, iterations, "iteration");
+        if (!counters.available()) {
+            os << " (" << counters.error() << ')';
+        }
+        std::cerr << os.str() + '\n';
+    }
+#else
+    void stop(const int, const double) {}
+#endif
+};
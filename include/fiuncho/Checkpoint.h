@@ -0,0 +1,425 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Checkpoint.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_CHECKPOINT_H
+#define FIUNCHO_CHECKPOINT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/Search.h>
+#include <fiuncho/utils/Result.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Checkpoint
+ * @brief Progress of a search that can be saved to disk and resumed later.
+ *
+ * The (*order* - 1)-combinations of the search are split in a fixed number of
+ * contiguous chunks, which only depends on the number of SNPs and the order,
+ * and the chunks are explored one at a time. The ranges of combinations
+ * completed and the best results found so far are kept by each process in
+ * `rank<i>.ckpt` inside the checkpoint directory, which is replaced
+ * atomically every time it is saved. A resumed search reads the files of all
+ * processes, so the number of processes and threads can change between runs.
+ *
+ * While a Checkpoint object exists, a SIGTERM handler writes its last
+ * completed state to disk before terminating the process.
+ */
+
+class Checkpoint
+{
+  public:
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a Checkpoint for a search, with no combinations completed. The
+     * checkpoint directory is created if it does not exist.
+     *
+     * @param directory Path to the checkpoint directory
+     * @param rank Index of the process that owns this Checkpoint
+     * @param snps Number of SNPs of the data set
+     * @param order Order of the search
+     * @param outputs Number of results kept
+     * @param interval Minimum number of seconds between two saves of the
+     * checkpoint while the search runs
+     * @param chunks Number of chunks in which the search is split. If 0, it is
+     * chosen so that chunks contain about 1024 (*order* - 1)-combinations,
+     * with at most 65536 chunks
+     */
+
+    Checkpoint(const std::string &directory, const int rank, const size_t snps,
+               const unsigned int order, const unsigned int outputs,
+               const double interval, const uint64_t chunks = 0)
+        : directory(directory),
+          path(directory + "/rank" + std::to_string(rank) + ".ckpt"),
+          tmp_path(path + ".tmp"), signal_path(path + ".term"), snps(snps),
+          order(order), outputs(outputs), interval(interval),
+          chunks(chunks > 0 ? chunks : default_chunks(snps, order)),
+          last_save(std::chrono::steady_clock::now())
+    {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Could not create checkpoint directory " +
+                                     directory + ": " + std::strerror(errno));
+        }
+        snapshot();
+        previous = std::signal(SIGTERM, flush);
+        active() = this;
+    }
+
+    Checkpoint(const Checkpoint &) = delete;
+
+    ~Checkpoint()
+    {
+        std::signal(SIGTERM, previous);
+        active() = nullptr;
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Read the checkpoint files of all processes in the checkpoint directory,
+     * adding their completed ranges to this Checkpoint.
+     *
+     * @param take_results If true, the results of the files are also added.
+     * Only one process should take them, to avoid counting them more than once
+     */
+
+    void load(const bool take_results)
+    {
+        for (const auto &file : files()) {
+            std::ifstream is(directory + "/" + file, std::ios::binary);
+            char m[magic_size];
+            uint64_t header[4];
+            is.read(m, magic_size);
+            is.read(reinterpret_cast<char *>(header), sizeof(header));
+            if (!is || std::memcmp(m, magic(), magic_size) != 0) {
+                throw std::runtime_error("File " + file +
+                                         " is not a checkpoint file");
+            }
+            if (header[0] != snps || header[1] != order ||
+                header[2] < outputs) {
+                throw std::runtime_error("Checkpoint file " + file +
+                                         " belongs to a different search");
+            }
+            std::vector<std::pair<uint64_t, uint64_t>> file_ranges(header[3]);
+            is.read(reinterpret_cast<char *>(file_ranges.data()),
+                    file_ranges.size() * sizeof(file_ranges[0]));
+            uint64_t count;
+            is.read(reinterpret_cast<char *>(&count), sizeof(count));
+            std::vector<Result<int, float>> file_results(is ? count : 0);
+            for (auto &r : file_results) {
+                Result<int, float>::deserialize(is, r);
+            }
+            if (!is) {
+                throw std::runtime_error("Checkpoint file " + file +
+                                         " is truncated");
+            }
+            for (const auto &r : file_ranges) {
+                add_range(r.first, r.second);
+            }
+            if (take_results) {
+                add_results(file_results);
+            }
+        }
+        snapshot();
+    }
+
+    /**
+     * Remove the checkpoint files of all processes from the checkpoint
+     * directory.
+     */
+
+    void clear() const
+    {
+        for (const auto &file : files()) {
+            std::remove((directory + "/" + file).c_str());
+        }
+    }
+
+    /**
+     * Write the current state of this Checkpoint to its file.
+     */
+
+    void save()
+    {
+        const auto &data = snapshots[current.load()];
+        if (!write_file(tmp_path.c_str(), path.c_str(), data.data(),
+                        data.size())) {
+            throw std::runtime_error("Could not write checkpoint file " + path +
+                                     ": " + std::strerror(errno));
+        }
+        last_save = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Ranges of (*order* - 1)-combinations that have not been completed yet,
+     * split at the boundaries of the chunks of the search. Every process
+     * obtains the same list from the same checkpoint files.
+     *
+     * @return Vector with the first and last indices of each range
+     */
+
+    std::vector<std::pair<uint64_t, uint64_t>> pending() const
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> result;
+        auto r = ranges.begin();
+        // Each chunk starts where the previous one ends
+        uint64_t end = 0;
+        for (uint64_t c = 0; c < chunks; ++c) {
+            uint64_t first = end;
+            end = Distribution<int>::split(snps, order - 1, c + 1, chunks);
+            while (first < end) {
+                while (r != ranges.end() && r->second <= first) {
+                    ++r;
+                }
+                const uint64_t last =
+                    r == ranges.end() ? end : std::min(end, r->first);
+                if (first < last) {
+                    result.emplace_back(first, last);
+                }
+                first = r == ranges.end() ? end : std::max(last, r->second);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Number of combinations of the search, of size *order*, covered by the
+     * completed ranges.
+     */
+
+    uint64_t completed() const
+    {
+        uint64_t count = 0;
+        for (const auto &r : ranges) {
+            count += Distribution<int>::extensions(snps, order - 1, r.second) -
+                     Distribution<int>::extensions(snps, order - 1, r.first);
+        }
+        return count;
+    }
+
+    /**
+     * Explore the ranges of combinations that have not been completed yet,
+     * saving the checkpoint periodically and after the last range.
+     *
+     * @param search Search used to explore the combinations
+     * @param dataset Dataset from which the SNPs are read
+     * @param worker Index of this process among the processes running the
+     * search. It explores the pending ranges whose position in the list of
+     * pending ranges modulo \a workers is equal to \a worker
+     * @param workers Number of processes running the search
+     * @return Vector with the best results of the ranges explored by this
+     * process and of the checkpoint files loaded, in descending order
+     */
+
+    std::vector<Result<int, float>> run(Search &search,
+                                        const Dataset<uint64_t> &dataset,
+                                        const int worker = 0,
+                                        const int workers = 1)
+    {
+        const auto todo = pending();
+        for (size_t i = worker; i < todo.size(); i += workers) {
+            const Distribution<int> distribution(snps, order - 1, todo[i].first,
+                                                 todo[i].second, 1, 0);
+            add_results(search.run(dataset, order, distribution, outputs));
+            add_range(todo[i].first, todo[i].second);
+            snapshot();
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - last_save;
+            if (elapsed.count() >= interval) {
+                save();
+            }
+        }
+        save();
+        return results;
+    }
+
+    //@}
+
+  private:
+    const std::string directory, path, tmp_path, signal_path;
+    const uint64_t snps, order, outputs;
+    const double interval;
+    const uint64_t chunks;
+    std::chrono::steady_clock::time_point last_save;
+    // Completed ranges, sorted and without overlaps
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<Result<int, float>> results;
+    // Serialized state, alternating between two buffers so that the signal
+    // handler always finds a complete one
+    std::vector<char> snapshots[2];
+    std::atomic<int> current{0};
+    void (*previous)(int);
+
+    // Identifier at the beginning of the file
+    static constexpr size_t magic_size = 8;
+    static const char *magic() { return "FIUNCHOK"; }
+
+    // Number of chunks used if none is given
+    static uint64_t default_chunks(const int snps, const int order)
+    {
+        const uint64_t prefixes = Distribution<int>::binomial(snps, order - 1);
+        return std::max<uint64_t>(1,
+                                  std::min<uint64_t>(prefixes / 1024, 65536));
+    }
+
+    static Checkpoint *&active()
+    {
+        static Checkpoint *checkpoint = nullptr;
+        return checkpoint;
+    }
+
+    // Write a buffer to a temporary file and rename it to its final path,
+    // using only async-signal-safe functions
+    static bool write_file(const char *tmp, const char *path, const char *data,
+                           size_t size)
+    {
+        const int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        while (size > 0) {
+            const ssize_t written = write(fd, data, size);
+            if (written < 0 && errno != EINTR) {
+                close(fd);
+                return false;
+            }
+            data += std::max<ssize_t>(written, 0);
+            size -= std::max<ssize_t>(written, 0);
+        }
+        const bool synced = fsync(fd) == 0;
+        return close(fd) == 0 && synced && rename(tmp, path) == 0;
+    }
+
+    // Save the last complete state of the active Checkpoint, and terminate the
+    // process
+    static void flush(int signal)
+    {
+        Checkpoint *c = active();
+        if (c != nullptr) {
+            const auto &data = c->snapshots[c->current.load()];
+            write_file(c->signal_path.c_str(), c->path.c_str(), data.data(),
+                       data.size());
+        }
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    // List the checkpoint files in the checkpoint directory
+    std::vector<std::string> files() const
+    {
+        std::vector<std::string> names;
+        DIR *dir = opendir(directory.c_str());
+        if (dir != nullptr) {
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != nullptr) {
+                const std::string name(entry->d_name);
+                if (name.compare(0, 4, "rank") == 0 && name.size() > 5 &&
+                    name.compare(name.size() - 5, 5, ".ckpt") == 0) {
+                    names.push_back(name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    void add_range(const uint64_t first, const uint64_t last)
+    {
+        ranges.emplace_back(first, last);
+        std::sort(ranges.begin(), ranges.end());
+        // Merge overlapping and adjacent ranges
+        size_t k = 0;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].first <= ranges[k].second) {
+                ranges[k].second = std::max(ranges[k].second, ranges[i].second);
+            } else {
+                ranges[++k] = ranges[i];
+            }
+        }
+        ranges.resize(k + 1);
+    }
+
+    void add_results(const std::vector<Result<int, float>> &r)
+    {
+        results.insert(results.end(), r.begin(), r.end());
+        // Sort ties by combination, since the same combination may appear in
+        // the files of several processes
+        std::sort(results.begin(), results.end(),
+                  [](const Result<int, float> &a, const Result<int, float> &b) {
+                      return a.val > b.val || (a.val == b.val &&
+                                               a.combination < b.combination);
+                  });
+        results.erase(std::unique(results.begin(), results.end()),
+                      results.end());
+        if (results.size() > outputs) {
+            results.resize(outputs);
+        }
+    }
+
+    // Serialize the current state into the buffer not in use
+    void snapshot()
+    {
+        std::ostringstream os;
+        const uint64_t header[4] = {snps, order, outputs, ranges.size()};
+        os.write(magic(), magic_size);
+        os.write(reinterpret_cast<const char *>(header), sizeof(header));
+        os.write(reinterpret_cast<const char *>(ranges.data()),
+                 ranges.size() * sizeof(ranges[0]));
+        const uint64_t count = results.size();
+        os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        for (const auto &r : results) {
+            Result<int, float>::serialize(os, r);
+        }
+        const std::string data = os.str();
+        const int next = 1 - current.load();
+        snapshots[next].assign(data.begin(), data.end());
+        current.store(next);
+    }
+};
+
+#endif
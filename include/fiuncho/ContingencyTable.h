@@ -59,6 +59,36 @@ template <class T> class ContingencyTable
     ContingencyTable(const short order, const size_t cases_words,
                      const size_t ctrls_words);
 
+    /**
+     * Create a new uninitialized table on top of an existing allocation. The
+     * table does not take ownership of the allocation, which must hold at least
+     * ContingencyTable::required_size(order) values of type \a T and be aligned
+     * to the vector width of the implementation in use.
+     *
+     * @param order Number of SNPs represented in combination inside the table
+     * @param ptr Allocation where the table is stored
+     */
+
+    ContingencyTable(const short order, const size_t cases_words,
+                     const size_t ctrls_words, T *ptr);
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Number of values of type \a T that a table of a given order occupies,
+     * including the padding required by the implementation in use.
+     *
+     * @param order Number of SNPs represented in combination inside the table
+     * @return The number of values of type \a T used by the table
+     */
+
+    static size_t required_size(const short order);
+
     //@}
 
     /**
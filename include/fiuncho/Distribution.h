@@ -23,6 +23,9 @@
 #ifndef FIUNCHO_DISTRIBUTION_H
 #define FIUNCHO_DISTRIBUTION_H
 
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <type_traits>
 #include <vector>
 
@@ -34,12 +37,24 @@
  * Round-robin distribution. To do this, combinations are enumerated using a
  * particular *step* size and an initial *offset*.
  *
+ * The enumeration can be limited to a contiguous range of combinations,
+ * identified by their index in lexicographical order. In that case, the
+ * Round-robin distribution only applies to the combinations inside the range.
+ *
+ * Searches extend each *k*-combination of the distribution with every SNP
+ * following its last element. The SNPs used to extend the combinations can
+ * also be limited to a contiguous range of SNPs.
+ *
  * @tparam T Data type used to index the SNPs in the data set. Needs to be a
  * _signed_ type
  */
 
 template <typename T> class Distribution
 {
+    // Unsigned integer wide enough to hold the intermediate products of the
+    // binomial coefficients
+    __extension__ typedef unsigned __int128 uint128;
+
   public:
     /**
      * @name Attributes
@@ -66,12 +81,35 @@ template <typename T> class Distribution
      */
     const T offset;
 
+    /**
+     * Index of the first combination of the range covered by the distribution
+     */
+    const uint64_t first;
+
+    /**
+     * Index following the last combination of the range covered by the
+     * distribution
+     */
+    const uint64_t last;
+
+    /**
+     * Index of the first SNP that can be used to extend the combinations
+     */
+    const T suffix_first;
+
+    /**
+     * Index following the last SNP that can be used to extend the combinations
+     */
+    const T suffix_last;
+
     //@}
 
     class const_iterator
     {
         friend class Distribution<T>;
         const T n, k, step, offset;
+        const uint64_t last;
+        uint64_t idx;
         std::vector<T> c;
 
         inline void increment_left()
@@ -96,6 +134,11 @@ template <typename T> class Distribution
 
         inline void increment(T x)
         {
+            idx += x;
+            if (idx >= last) {
+                c[0] = n;
+                return;
+            }
             c[k - 1] += x;
             while (c[0] < n && c[k - 1] >= n) {
                 increment_left();
@@ -103,6 +146,14 @@ template <typename T> class Distribution
             }
         }
 
+        // Past-the-end iterator
+        const_iterator(const Distribution<T> &d, bool)
+            : n(d.n), k(d.k), step(d.step), offset(d.offset), last(d.last),
+              idx(d.last), c(k)
+        {
+            c[0] = n;
+        }
+
       public:
         using value_type = T;
         using reference = T;
@@ -111,10 +162,16 @@ template <typename T> class Distribution
         using difference_type = void;
 
         const_iterator(const Distribution<T> &d)
-            : n(d.n), k(d.k), step(d.step), offset(d.offset), c(k)
+            : n(d.n), k(d.k), step(d.step), offset(d.offset), last(d.last),
+              idx(d.first), c(k)
         {
-            for (auto i = 0; i < k; ++i) {
-                c[i] = i;
+            if (d.first == 0) {
+                for (auto i = 0; i < k; ++i) {
+                    c[i] = i;
+                }
+            } else if (d.first >= d.last || !unrank(n, d.first, c)) {
+                c[0] = n;
+                return;
             }
             increment(offset);
         }
@@ -162,12 +219,32 @@ template <typename T> class Distribution
      */
 
     Distribution(const T &n, const T &k, const T &step, const T &offset)
-        : n(n), k(k), step(step), offset(offset)
+        : n(n), k(k), step(step), offset(offset), first(0),
+          last(std::numeric_limits<uint64_t>::max()), suffix_first(0),
+          suffix_last(n)
     {
         static_assert(std::is_signed<T>::value,
                       "Distribution template parameter requires a signed type");
     };
 
+    /**
+     * Create a new distribution limited to a range of combinations.
+     *
+     * @param n Number of SNPs in the set
+     * @param k Size of the combinations to consider
+     * @param first Index of the first combination of the range
+     * @param last Index following the last combination of the range
+     * @param step Number of combinations to advance between iterations
+     * @param offset Number of combinations to advance before starting the
+     * iteration, counting from \a first
+     */
+
+    Distribution(const T &n, const T &k, const uint64_t first,
+                 const uint64_t last, const T &step, const T &offset)
+        : Distribution(n, k, first, last, step, offset, 0, n)
+    {
+    }
+
     //@}
 
     /**
@@ -188,8 +265,201 @@ template <typename T> class Distribution
 
     Distribution<T> layer(const T step, const T offset) const
     {
-        return Distribution<T>(n, k, this->step * step,
-                               this->offset * step + offset);
+        return Distribution<T>(n, k, first, last, this->step * step,
+                               this->offset * step + offset, suffix_first,
+                               suffix_last);
+    }
+
+    /**
+     * Create a new distribution from an existing one, limiting the SNPs used
+     * to extend its combinations to the range [\a first, \a last). The rest
+     * of attributes are conserved.
+     *
+     * @param first Index of the first SNP of the range
+     * @param last Index following the last SNP of the range
+     */
+
+    Distribution<T> suffixes(const T first, const T last) const
+    {
+        return Distribution<T>(n, k, this->first, this->last, step, offset,
+                               first, last);
+    }
+
+    /**
+     * Number of *k*-combinations without repetition from a set of *n*
+     * elements. The result saturates to the maximum value of `uint64_t` if it
+     * does not fit in that type.
+     *
+     * @param n Number of elements in the set
+     * @param k Size of the combinations
+     * @return The binomial coefficient of \a n over \a k
+     */
+
+    static uint64_t binomial(const T n, T k)
+    {
+        if (k < 0 || n < k) {
+            return 0;
+        }
+        if (k > n - k) {
+            k = n - k;
+        }
+        uint128 result = 1;
+        for (T j = 1; j <= k; ++j) {
+            result = result * (n - k + j) / j;
+            if (result > std::numeric_limits<uint64_t>::max()) {
+                return std::numeric_limits<uint64_t>::max();
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Index of a combination in lexicographical order.
+     *
+     * @param n Number of elements in the set
+     * @param c Combination, in ascending order
+     * @return The index of the combination
+     */
+
+    static uint64_t rank(const T n, const std::vector<T> &c)
+    {
+        const T k = c.size();
+        uint64_t r = 0;
+        T prev = -1;
+        for (T p = 0; p < k; ++p) {
+            // Combinations that have a smaller value at position p
+            r += binomial(n - prev - 1, k - p) - binomial(n - c[p], k - p);
+            prev = c[p];
+        }
+        return r;
+    }
+
+    /**
+     * Combination placed at a given index in lexicographical order.
+     *
+     * @param n Number of elements in the set
+     * @param i Index of the combination
+     * @param c Vector where the combination is stored. Its size determines the
+     * size of the combination
+     * @return False if \a i is past the last combination
+     */
+
+    static bool unrank(const T n, uint64_t i, std::vector<T> &c)
+    {
+        const T k = c.size();
+        T v = 0;
+        for (T p = 0; p < k; ++p) {
+            // Combinations that have a value in [v, u) at position p
+            const auto before = [&](const T u) {
+                return binomial(n - v, k - p) - binomial(n - u, k - p);
+            };
+            if (i >= binomial(n - v, k - p)) {
+                return false;
+            }
+            // Binary search of the largest value preceded by at most i
+            // combinations
+            T lo = v, hi = n - (k - p);
+            while (lo < hi) {
+                const T mid = lo + (hi - lo + 1) / 2;
+                if (before(mid) <= i) {
+                    lo = mid;
+                } else {
+                    hi = mid - 1;
+                }
+            }
+            i -= before(lo);
+            c[p] = lo;
+            v = lo + 1;
+        }
+        return true;
+    }
+
+    /**
+     * Index of the first *k*-combination whose extensions with one more SNP
+     * are placed at or after the (*k* + 1)-combination with index \a f, in
+     * lexicographical order. Splitting the *k*-combinations at these indices
+     * balances the number of combinations explored by the search.
+     *
+     * @param n Number of SNPs in the set
+     * @param k Size of the combinations
+     * @param f Index of a (*k* + 1)-combination
+     * @return The index of the *k*-combination
+     */
+
+    static uint64_t boundary(const T n, const T k, const uint64_t f)
+    {
+        if (f >= binomial(n, k + 1)) {
+            return binomial(n, k);
+        }
+        std::vector<T> c(k + 1);
+        unrank(n, f, c);
+        c.pop_back();
+        const uint64_t p = rank(n, c);
+        // Prefix p goes to the previous range if its extensions start before f
+        c.push_back(c.back() + 1);
+        return rank(n, c) < f ? p + 1 : p;
+    }
+
+    /**
+     * Number of (*k* + 1)-combinations obtained by extending, with one more
+     * SNP, the *k*-combinations placed before index \a p in lexicographical
+     * order. It is the inverse of Distribution::boundary.
+     *
+     * @param n Number of SNPs in the set
+     * @param k Size of the combinations
+     * @param p Index of a *k*-combination
+     * @return The index of the first extension of the *k*-combination
+     */
+
+    static uint64_t extensions(const T n, const T k, const uint64_t p)
+    {
+        if (p >= binomial(n, k)) {
+            return binomial(n, k + 1);
+        }
+        std::vector<T> c(k);
+        unrank(n, p, c);
+        // The rank is also valid if the prefix ends with SNP n - 1, which has
+        // no extensions
+        c.push_back(c.back() + 1);
+        return rank(n, c);
+    }
+
+    /**
+     * Create a distribution with the \a i-th out of \a parts contiguous
+     * ranges of *k*-combinations. Ranges are chosen so that all of them
+     * contain approximately the same number of (*k* + 1)-combinations once
+     * extended by the search.
+     *
+     * @param n Number of SNPs in the set
+     * @param k Size of the combinations to consider
+     * @param i Index of the range, starting from 0
+     * @param parts Number of ranges
+     */
+
+    static Distribution<T> part(const T n, const T k, const uint64_t i,
+                                const uint64_t parts)
+    {
+        return Distribution<T>(n, k, split(n, k, i, parts),
+                               split(n, k, i + 1, parts), 1, 0);
+    }
+
+    /**
+     * Index of the first *k*-combination of the \a i-th out of \a parts
+     * ranges created by Distribution::part. The range \a i ends where the
+     * range \a i + 1 starts.
+     *
+     * @param n Number of SNPs in the set
+     * @param k Size of the combinations to consider
+     * @param i Index of the range, starting from 0
+     * @param parts Number of ranges
+     * @return The index of the *k*-combination
+     */
+
+    static uint64_t split(const T n, const T k, const uint64_t i,
+                          const uint64_t parts)
+    {
+        const uint128 total = binomial(n, k + 1);
+        return boundary(n, k, total * i / parts);
     }
 
     /**
@@ -209,14 +479,20 @@ template <typename T> class Distribution
      * @return Iterator to the combination following the last combination.
      */
 
-    const_iterator end() const
-    {
-        const_iterator end_iter(*this);
-        end_iter.c[0] = n;
-        return end_iter;
-    }
+    const_iterator end() const { return const_iterator(*this, true); }
 
     //@}
+
+  private:
+    Distribution(const T &n, const T &k, const uint64_t first,
+                 const uint64_t last, const T &step, const T &offset,
+                 const T &suffix_first, const T &suffix_last)
+        : n(n), k(k), step(step), offset(offset), first(first), last(last),
+          suffix_first(suffix_first), suffix_last(suffix_last)
+    {
+        static_assert(std::is_signed<T>::value,
+                      "Distribution template parameter requires a signed type");
+    };
 };
 
 #endif
@@ -25,6 +25,7 @@
 
 #include <fiuncho/ContingencyTable.h>
 
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -88,6 +89,27 @@ template <class T> class GenotypeTable
     GenotypeTable(const short order, const size_t cases_words,
                   const size_t ctrls_words);
 
+    /**
+     * Create a new uninitialized table on top of an existing allocation. The
+     * table does not take ownership of the allocation, which must hold at least
+     * GenotypeTable::required_size(order, cases_words, ctrls_words) values of
+     * type \a T and be aligned to the vector width of the implementation in
+     * use.
+     *
+     * @param order Number of SNPs represented in combination inside the table
+     * @param cases_words Number of values of type \a T required to represent
+     * the genotypes for all individuals in the case group
+     * @param ctrls_words Number of values of type \a T required to represent
+     * the genotypes for all individuals in the control group
+     * @param ptr Allocation where the table is stored
+     */
+
+    GenotypeTable(const short order, const size_t cases_words,
+                  const size_t ctrls_words, T *ptr)
+        : order(order), size(std::pow(3, order)), cases_words(cases_words),
+          ctrls_words(ctrls_words), alloc(nullptr), cases(ptr),
+          ctrls(cases + size * cases_words){};
+
     //@}
 
     /**
@@ -95,6 +117,23 @@ template <class T> class GenotypeTable
      */
     //@{
 
+    /**
+     * Number of values of type \a T that a table of a given order occupies.
+     *
+     * @param order Number of SNPs represented in combination inside the table
+     * @param cases_words Number of values of type \a T required to represent
+     * the genotypes for all individuals in the case group
+     * @param ctrls_words Number of values of type \a T required to represent
+     * the genotypes for all individuals in the control group
+     * @return The number of values of type \a T used by the table
+     */
+
+    static size_t required_size(const short order, const size_t cases_words,
+                                const size_t ctrls_words)
+    {
+        return (size_t)std::pow(3, order) * (cases_words + ctrls_words);
+    }
+
     /**
      * Combine the SNPs represented in tables \a t1 and \a t2 into a single
      * table \a out.
@@ -23,18 +23,51 @@
 #ifndef FIUNCHO_MPIENGINE_H
 #define FIUNCHO_MPIENGINE_H
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fiuncho/Checkpoint.h>
+#include <fiuncho/MPISlicedSearch.h>
 #include <fiuncho/Search.h>
+#include <fiuncho/utils/PhaseTimer.h>
+#include <fiuncho/utils/Progress.h>
+#include <fiuncho/utils/Report.h>
 #include <fiuncho/utils/Result.h>
+#include <fiuncho/utils/Tracer.h>
+#include <fstream>
 #include <limits>
+#include <memory>
 #include <mpi.h>
-#include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #ifdef BENCHMARK
 #include <iostream>
 #endif
 
+/**
+ * Policies used to distribute the combinations among MPI processes.
+ */
+
+enum class MPIScheduling {
+    /** Round-robin assignment of the combinations, fixed beforehand */
+    Static,
+    /** Contiguous chunks of decreasing size, requested by each process as it
+       completes the previous one */
+    Dynamic,
+    /** One contiguous range per process, with an amount of work proportional
+       to the capacity of the process */
+    Weighted,
+    /** Only for pairs of SNPs. The SNPs are split in blocks, and each process
+       explores the pairs of SNPs of a set of pairs of blocks, reading only the
+       blocks it needs */
+    BlockPairs,
+    /** Every process explores all the combinations over its own slice of the
+       individuals, reading only that slice. Requires MPISlicedSearch */
+    Individuals
+};
+
 /**
  * Epistasis search engine, implementing a distributed algorithm using MPI. Each
  * node available in the MPI context is used to explore SNP combinations in
@@ -46,6 +79,28 @@ class MPIEngine
 
     const int mpi_size;
     const int mpi_rank;
+    const DatasetPlacement placement;
+    const bool broadcast;
+    const bool shared;
+    const MPIScheduling scheduling;
+    const double weight;
+    const unsigned int blocks;
+    const bool stream;
+    const std::string checkpoint;
+    const bool resume;
+    const double checkpoint_interval;
+    const double progress_interval;
+    const std::string progress_file;
+    // Communicator used by the monitor threads to add up the counters of all
+    // processes, if the progress of the search is reported by several of them
+    MPI_Comm progress_comm;
+    const std::string trace;
+
+#ifdef ALIGN
+    static constexpr size_t ALIGNMENT = ALIGN;
+#else
+    static constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
 
     int get_mpi_size()
     {
@@ -61,26 +116,810 @@ class MPIEngine
         return rank;
     }
 
-    static std::string
-    serialize_results(const std::vector<Result<int, float>> &results)
+#ifdef BENCHMARK
+    // Print the time spent in each phase of the search by the threads of each
+    // process, and by all of them
+    void print_phases()
+    {
+        const int fields = PhaseTimer::fields;
+        std::vector<double> all(mpi_rank == 0 ? mpi_size * fields : 0);
+        MPI_Gather(PhaseTimer::totals().data(), fields, MPI_DOUBLE, all.data(),
+                   fields, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (mpi_rank == 0) {
+            std::vector<double> sum(fields, 0);
+            for (auto r = 0; r < mpi_size; ++r) {
+                const std::vector<double> rank(all.begin() + r * fields,
+                                               all.begin() + (r + 1) * fields);
+                std::cout << "Process " << r << ": " << PhaseTimer::str(rank)
+                          << '\n';
+                for (auto f = 0; f < fields; ++f) {
+                    sum[f] += rank[f];
+                }
+            }
+            std::cout << "All processes: " << PhaseTimer::str(sum) << '\n';
+        }
+    }
+#endif
+
+    // Start monitoring the progress of the search, if enabled. The counters of
+    // all processes are added up, and process 0 writes the reports
+    std::unique_ptr<Progress> monitor(const uint64_t total,
+                                      const uint64_t completed = 0)
+    {
+        if (progress_interval <= 0) {
+            return nullptr;
+        }
+        Progress::Reduce reduce;
+        if (progress_comm != MPI_COMM_NULL) {
+            const MPI_Comm comm = progress_comm;
+            reduce = [comm](Progress::Sample &s) {
+                uint64_t counts[2] = {s.combinations, s.running};
+                MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_UINT64_T, MPI_SUM,
+                              comm);
+                MPI_Allreduce(MPI_IN_PLACE, &s.threshold, 1, MPI_FLOAT,
+                              MPI_MAX, comm);
+                s.combinations = counts[0];
+                s.running = counts[1];
+            };
+        }
+        return std::unique_ptr<Progress>(
+            new Progress(total, completed, progress_interval, progress_file,
+                         reduce, mpi_rank == 0));
+    }
+
+    // Estimate the difference between the steady clock of process 0 and the
+    // one of this process, in nanoseconds. Each process exchanges several
+    // messages with process 0, which replies with its clock, and the reply
+    // with the shortest round trip is assumed to be sent halfway through it
+    int64_t clock_offset()
+    {
+        constexpr int rounds = 8;
+        int64_t offset = 0;
+        for (int r = 1; r < mpi_size; ++r) {
+            if (mpi_rank == 0) {
+                for (int k = 0; k < rounds; ++k) {
+                    MPI_Recv(nullptr, 0, MPI_BYTE, r, 0, MPI_COMM_WORLD,
+                             MPI_STATUS_IGNORE);
+                    const uint64_t now = Tracer::now();
+                    MPI_Send(&now, 1, MPI_UINT64_T, r, 0, MPI_COMM_WORLD);
+                }
+            } else if (mpi_rank == r) {
+                uint64_t best = std::numeric_limits<uint64_t>::max();
+                for (int k = 0; k < rounds; ++k) {
+                    uint64_t remote;
+                    const uint64_t sent = Tracer::now();
+                    MPI_Send(nullptr, 0, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+                    MPI_Recv(&remote, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD,
+                             MPI_STATUS_IGNORE);
+                    const uint64_t received = Tracer::now();
+                    if (received - sent < best) {
+                        best = received - sent;
+                        offset = (int64_t)(remote - (sent + best / 2));
+                    }
+                }
+            }
+        }
+        return offset;
+    }
+
+    // Gather the events of all processes in process 0, on its clock, and
+    // write them to the trace file. Process 0 receives the events of one
+    // process at a time, in messages of bounded size, and writes them to the
+    // file as they arrive
+    void write_trace(const Tracer &tracer)
+    {
+        const int64_t offset = clock_offset();
+        // The timeline starts with the first Tracer created
+        uint64_t reference = tracer.start() + offset;
+        MPI_Allreduce(MPI_IN_PLACE, &reference, 1, MPI_UINT64_T, MPI_MIN,
+                      MPI_COMM_WORLD);
+        constexpr size_t CHUNK = 1 << 27;
+        if (mpi_rank != 0) {
+            const std::string events =
+                tracer.json(mpi_rank, offset, reference);
+            const uint64_t size = events.size();
+            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
+            for (size_t sent = 0; sent < size; sent += CHUNK) {
+                MPI_Send(events.data() + sent,
+                         std::min<size_t>(CHUNK, size - sent), MPI_CHAR, 0, 0,
+                         MPI_COMM_WORLD);
+            }
+            return;
+        }
+        std::ofstream file(trace, std::ios::out);
+        Tracer::prologue(file);
+        tracer.json(file, 0, offset, reference);
+        std::vector<char> buffer;
+        for (auto r = 1; r < mpi_size; ++r) {
+            uint64_t size;
+            MPI_Recv(&size, 1, MPI_UINT64_T, r, 0, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE);
+            Tracer::separator(file);
+            for (size_t received = 0; received < size; received += CHUNK) {
+                const size_t n = std::min<size_t>(CHUNK, size - received);
+                buffer.resize(n);
+                MPI_Recv(buffer.data(), n, MPI_CHAR, r, 0, MPI_COMM_WORLD,
+                         MPI_STATUS_IGNORE);
+                file.write(buffer.data(), n);
+            }
+        }
+        Tracer::epilogue(file);
+        if (!file) {
+            throw std::runtime_error("Error writing file " + trace);
+        }
+    }
+
+    // Gather the work done by every process in the Report of process 0
+    void gather_report(Report &report)
+    {
+        auto &local = report.local();
+        local.peak_rss = Report::peak_rss();
+        std::vector<double> values = {local.load, local.compute,
+                                      (double)local.peak_rss};
+        for (const auto &t : local.threads) {
+            values.push_back(t.seconds);
+            values.push_back(t.combinations);
+        }
+        int size = values.size();
+        std::vector<int> sizes(mpi_rank == 0 ? mpi_size : 0),
+            displacements(mpi_rank == 0 ? mpi_size : 0);
+        MPI_Gather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0,
+                   MPI_COMM_WORLD);
+        std::vector<double> all;
+        if (mpi_rank == 0) {
+            int total = 0;
+            for (auto r = 0; r < mpi_size; ++r) {
+                displacements[r] = total;
+                total += sizes[r];
+            }
+            all.resize(total);
+        }
+        MPI_Gatherv(values.data(), size, MPI_DOUBLE, all.data(), sizes.data(),
+                    displacements.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (mpi_rank == 0) {
+            report.processes.resize(1);
+            for (auto r = 1; r < mpi_size; ++r) {
+                const double *v = all.data() + displacements[r];
+                Report::Process p{v[0], v[1], (uint64_t)v[2], {}};
+                for (int i = 3; i + 1 < sizes[r]; i += 2) {
+                    p.threads.push_back({v[i], (uint64_t)v[i + 1]});
+                }
+                report.processes.push_back(std::move(p));
+            }
+        }
+    }
+
+    // Results are reduced as blocks of a fixed number of fixed-width records,
+    // each made of the SNP indices followed by the MI value. Blocks are sorted
+    // in descending order and padded with records of value -inf. The shape of
+    // the block is attached to its datatype so that merge_results can read it
+    struct BlockShape {
+        int order;
+        int count;
+    };
+
+    static int block_shape_keyval()
+    {
+        static int keyval = MPI_KEYVAL_INVALID;
+        if (keyval == MPI_KEYVAL_INVALID) {
+            MPI_Type_create_keyval(MPI_TYPE_NULL_COPY_FN,
+                                   MPI_TYPE_NULL_DELETE_FN, &keyval, nullptr);
+        }
+        return keyval;
+    }
+
+    static float record_value(const int *record, const int order)
+    {
+        float val;
+        memcpy(&val, record + order, sizeof(float));
+        return val;
+    }
+
+    // MPI_Op function that keeps the best results of two blocks in inout
+    static void merge_results(void *in, void *inout, int *len,
+                              MPI_Datatype *type)
+    {
+        BlockShape *shape;
+        int flag;
+        MPI_Type_get_attr(*type, block_shape_keyval(), &shape, &flag);
+        const int width = shape->order + 1;
+        const size_t block_size = (size_t)shape->count * width;
+        std::vector<int> merged(block_size);
+        for (int b = 0; b < *len; ++b) {
+            const int *x = (int *)in + b * block_size;
+            int *y = (int *)inout + b * block_size;
+            const int *i = x, *j = y;
+            for (int k = 0; k < shape->count; ++k) {
+                const int *&next = record_value(i, shape->order) >
+                                           record_value(j, shape->order)
+                                       ? i
+                                       : j;
+                memcpy(merged.data() + k * width, next, width * sizeof(int));
+                next += width;
+            }
+            memcpy(y, merged.data(), block_size * sizeof(int));
+        }
+    }
+
+    // Reduce the best results of all processes into process 0, which is the
+    // only one receiving outputs records
+    std::vector<Result<int, float>>
+    reduce_results(std::vector<Result<int, float>> &local,
+                   const unsigned int order, const unsigned int outputs)
+    {
+        std::vector<Result<int, float>> global;
+        if (outputs == 0) {
+            return global;
+        }
+        // Datatype of a block of records
+        MPI_Datatype record, block;
+        int blocklengths[2] = {(int)order, 1};
+        MPI_Aint displacements[2] = {0, (MPI_Aint)(order * sizeof(int))};
+        MPI_Datatype types[2] = {MPI_INT, MPI_FLOAT};
+        MPI_Type_create_struct(2, blocklengths, displacements, types, &record);
+        MPI_Type_contiguous(outputs, record, &block);
+        MPI_Type_commit(&block);
+        BlockShape shape = {(int)order, (int)outputs};
+        MPI_Type_set_attr(block, block_shape_keyval(), &shape);
+        MPI_Op op;
+        MPI_Op_create(merge_results, 1, &op);
+        // Encode the local results
+        const int width = order + 1;
+        const float pad = -std::numeric_limits<float>::infinity();
+        std::sort(local.rbegin(), local.rend());
+        std::vector<int> send((size_t)outputs * width, 0), recv;
+        for (unsigned int k = 0; k < outputs; ++k) {
+            int *r = send.data() + (size_t)k * width;
+            if (k < local.size()) {
+                memcpy(r, local[k].combination.data(), order * sizeof(int));
+                memcpy(r + order, &local[k].val, sizeof(float));
+            } else {
+                memcpy(r + order, &pad, sizeof(float));
+            }
+        }
+        if (mpi_rank == 0) {
+            recv.resize(send.size());
+        }
+        Tracer::Scope scope("MPI_Reduce");
+        MPI_Reduce(send.data(), recv.data(), 1, block, op, 0, MPI_COMM_WORLD);
+        scope.end();
+        MPI_Op_free(&op);
+        MPI_Type_free(&block);
+        MPI_Type_free(&record);
+        // Decode the global results
+        if (mpi_rank == 0) {
+            for (unsigned int k = 0; k < outputs; ++k) {
+                const int *r = recv.data() + (size_t)k * width;
+                Result<int, float> result;
+                result.val = record_value(r, order);
+                if (result.val == pad) {
+                    break;
+                }
+                result.combination.assign(r, r + order);
+                global.push_back(std::move(result));
+            }
+        }
+        return global;
+    }
+
+    static void broadcast_buffer(uint64_t *ptr, size_t count, MPI_Comm comm)
+    {
+        Tracer::Scope scope("MPI_Bcast");
+        // Split the broadcast in chunks that fit in an int count
+        constexpr size_t CHUNK = 1 << 27;
+        while (count > 0) {
+            const size_t n = std::min(count, CHUNK);
+            MPI_Bcast(ptr, n, MPI_UINT64_T, 0, comm);
+            ptr += n;
+            count -= n;
+        }
+    }
+
+    // Read the Dataset in every process of comm, or only in its process 0
+    // followed by a broadcast
+    Dataset<uint64_t> load(const std::string &tped, const std::string &tfam,
+                           MPI_Comm comm, const DatasetPlacement placement)
+    {
+        if (!broadcast) {
+            return stream ? Dataset<uint64_t>::stream<ALIGNMENT>(tped, tfam,
+                                                                 placement)
+                          : Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam,
+                                                               placement);
+        }
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        // Read status, number of cases, controls and SNPs
+        unsigned long long header[4] = {0, 0, 0, 0};
+        if (rank == 0) {
+            try {
+                auto dataset =
+                    Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam, placement);
+                header[0] = 1;
+                header[1] = dataset.cases;
+                header[2] = dataset.ctrls;
+                header[3] = dataset.snps;
+                MPI_Bcast(header, 4, MPI_UNSIGNED_LONG_LONG, 0, comm);
+                broadcast_buffer(const_cast<uint64_t *>(dataset.raw()),
+                                 dataset.raw_size(), comm);
+                return dataset;
+            } catch (const std::runtime_error &) {
+                // Let the rest of processes know that the read failed
+                MPI_Bcast(header, 4, MPI_UNSIGNED_LONG_LONG, 0, comm);
+                throw;
+            }
+        }
+        MPI_Bcast(header, 4, MPI_UNSIGNED_LONG_LONG, 0, comm);
+        if (header[0] == 0) {
+            throw std::runtime_error("Process 0 could not read the data set");
+        }
+        return Dataset<uint64_t>::create<ALIGNMENT>(
+            header[1], header[2], header[3],
+            [comm](uint64_t *ptr, size_t count) {
+                broadcast_buffer(ptr, count, comm);
+            },
+            placement);
+    }
+
+    // Read the Dataset in the first process of each node, directly into an
+    // MPI-3 shared memory window that the rest of processes of the node use.
+    // The window is sized from the number of SNPs of the tped file and the
+    // individuals of the tfam file before reading the tables, so that the
+    // tables are never held twice in memory
+    Dataset<uint64_t> load_shared(const std::string &tped,
+                                  const std::string &tfam)
+    {
+        MPI_Comm node_comm, leaders_comm;
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, mpi_rank,
+                            MPI_INFO_NULL, &node_comm);
+        int node_rank, leader_rank = -1;
+        MPI_Comm_rank(node_comm, &node_rank);
+        MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED,
+                       mpi_rank, &leaders_comm);
+        // With --broadcast, only the first leader reads the input files
+        if (node_rank == 0) {
+            MPI_Comm_rank(leaders_comm, &leader_rank);
+        }
+        const bool reader = node_rank == 0 && (!broadcast || leader_rank == 0);
+        // Read status, number of cases, controls and SNPs
+        unsigned long long header[4] = {0, 0, 0, 0};
+        std::exception_ptr error;
+        const auto fail = [&]() {
+            if (node_rank == 0) {
+                MPI_Comm_free(&leaders_comm);
+            }
+            MPI_Comm_free(&node_comm);
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            throw std::runtime_error(
+                "Process 0 of the node could not read the data set");
+        };
+        if (reader) {
+            try {
+                size_t cases, ctrls;
+                Dataset<uint64_t>::count_individuals(tfam, cases, ctrls);
+                header[1] = cases;
+                header[2] = ctrls;
+                header[3] = Dataset<uint64_t>::count_snps(tped);
+                header[0] = 1;
+            } catch (const std::runtime_error &) {
+                error = std::current_exception();
+            }
+        }
+        if (node_rank == 0 && broadcast) {
+            MPI_Bcast(header, 4, MPI_UNSIGNED_LONG_LONG, 0, leaders_comm);
+        }
+        MPI_Bcast(header, 4, MPI_UNSIGNED_LONG_LONG, 0, node_comm);
+        if (header[0] == 0) {
+            fail();
+        }
+        const size_t count = Dataset<uint64_t>::raw_count<ALIGNMENT>(
+            header[1], header[2], header[3]);
+        // Only the first process of the node allocates memory for the window
+        const MPI_Aint bytes =
+            node_rank == 0 ? count * sizeof(uint64_t) + ALIGNMENT : 0;
+        char *base;
+        MPI_Win win;
+        MPI_Win_allocate_shared(bytes, 1, MPI_INFO_NULL, node_comm, &base,
+                                &win);
+        MPI_Aint size;
+        int disp_unit;
+        MPI_Win_shared_query(win, 0, &size, &disp_unit, &base);
+        // The tables start at the first aligned address in the first process,
+        // and all processes use the same offset from the window base
+        unsigned long long offset = 0;
+        int status = 1;
+        if (node_rank == 0) {
+            offset = (ALIGNMENT - (uintptr_t)base % ALIGNMENT) % ALIGNMENT;
+            uint64_t *tables = (uint64_t *)(base + offset);
+            if (reader) {
+                try {
+                    Dataset<uint64_t>::read_into<ALIGNMENT>(tped, tfam, tables,
+                                                            count);
+                } catch (const std::runtime_error &) {
+                    error = std::current_exception();
+                    status = 0;
+                }
+            }
+            if (broadcast) {
+                MPI_Bcast(&status, 1, MPI_INT, 0, leaders_comm);
+                if (status) {
+                    broadcast_buffer(tables, count, leaders_comm);
+                }
+            }
+        }
+        MPI_Bcast(&status, 1, MPI_INT, 0, node_comm);
+        if (!status) {
+            MPI_Win_free(&win);
+            fail();
+        }
+        if (node_rank == 0) {
+            MPI_Comm_free(&leaders_comm);
+        }
+        MPI_Bcast(&offset, 1, MPI_UNSIGNED_LONG_LONG, 0, node_comm);
+        uint64_t *ptr = (uint64_t *)(base + offset);
+        int aligned = (uintptr_t)ptr % ALIGNMENT == 0;
+        MPI_Allreduce(MPI_IN_PLACE, &aligned, 1, MPI_INT, MPI_LAND, node_comm);
+        // Make the tables visible to the rest of processes of the node
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+        MPI_Win_sync(win);
+        MPI_Barrier(node_comm);
+        MPI_Win_sync(win);
+        MPI_Win_unlock_all(win);
+        if (!aligned) {
+            // The window is not mapped at a suitable address in some process,
+            // fall back to a private copy of the tables
+            auto dataset = Dataset<uint64_t>::create<ALIGNMENT>(
+                header[1], header[2], header[3],
+                [ptr](uint64_t *dst, size_t count) {
+                    memcpy(dst, ptr, count * sizeof(uint64_t));
+                },
+                placement);
+            MPI_Win_free(&win);
+            MPI_Comm_free(&node_comm);
+            return dataset;
+        }
+        // The window is freed along with the Dataset. Since MPI_Win_free is
+        // collective, all processes of the node must destroy their Dataset
+        std::shared_ptr<void> storage(base, [win, node_comm](void *) mutable {
+            MPI_Win_free(&win);
+            MPI_Comm_free(&node_comm);
+        });
+        return Dataset<uint64_t>::map<ALIGNMENT>(header[1], header[2],
+                                                 header[3], storage, ptr);
+    }
+
+    // Explore the combinations in chunks obtained from a counter in process
+    // 0, updated with one-sided atomic operations. Chunks are sized according
+    // to the number of combinations left (guided scheduling), and the results
+    // of all chunks are merged locally. The counter advances over the
+    // combinations of the target order, so that the work of a chunk does not
+    // depend on its position, and each chunk is mapped back to the range of
+    // prefixes whose extensions it contains
+    std::vector<Result<int, float>>
+    run_dynamic(Search &search, const Dataset<uint64_t> &dataset,
+                const unsigned int order, const unsigned int outputs)
+    {
+        const uint64_t total = Distribution<int>::binomial(dataset.snps, order);
+        if (total == std::numeric_limits<uint64_t>::max()) {
+            throw std::runtime_error(
+                "Input data limit exceeded: too many combinations for dynamic "
+                "scheduling");
+        }
+        const auto progress = monitor(total);
+        uint64_t *counter;
+        MPI_Win win;
+        MPI_Win_allocate(mpi_rank == 0 ? sizeof(uint64_t) : 0,
+                         sizeof(uint64_t), MPI_INFO_NULL, MPI_COMM_WORLD,
+                         &counter, &win);
+        if (mpi_rank == 0) {
+            *counter = 0;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Win_lock_all(0, win);
+        const uint64_t min_chunk =
+            std::max<uint64_t>(1, total / (64 * (uint64_t)mpi_size));
+        // Without a progress thread, the MPI library of process 0 only serves
+        // the fetches of the counter while process 0 is inside an MPI call.
+        // Process 0 takes the smallest chunks, so that the rest of processes
+        // wait at most for one of them
+        const auto next_chunk = [&](const uint64_t left) {
+            return mpi_rank == 0
+                       ? min_chunk
+                       : std::max(min_chunk, left / (2 * (uint64_t)mpi_size));
+        };
+        uint64_t chunk = next_chunk(total);
+        std::vector<Result<int, float>> results;
+        while (true) {
+            uint64_t start;
+            Tracer::Scope fetch("MPI_Fetch_and_op");
+            MPI_Fetch_and_op(&chunk, &start, MPI_UINT64_T, 0, 0, MPI_SUM, win);
+            MPI_Win_flush(0, win);
+            fetch.end();
+            if (start >= total) {
+                break;
+            }
+            const uint64_t end = std::min(start + chunk, total);
+            const uint64_t first =
+                Distribution<int>::boundary(dataset.snps, order - 1, start);
+            const uint64_t last =
+                Distribution<int>::boundary(dataset.snps, order - 1, end);
+            chunk = next_chunk(total - end);
+            // Chunks smaller than the extensions of a prefix may be empty
+            if (first == last) {
+                continue;
+            }
+            const Distribution<int> distribution(dataset.snps, order - 1, first,
+                                                 last, 1, 0);
+            auto chunk_results =
+                search.run(dataset, order, distribution, outputs);
+            // Keep the best results found so far
+            Tracer::Scope merge("top-K merge");
+            results.insert(results.end(), chunk_results.begin(),
+                           chunk_results.end());
+            std::sort(results.rbegin(), results.rend());
+            if (results.size() > outputs) {
+                results.resize(outputs);
+            }
+        }
+        MPI_Win_unlock_all(win);
+        MPI_Win_free(&win);
+        return results;
+    }
+
+    // Explore the combinations in chunks, dealt round-robin among processes,
+    // saving the progress of each process to the checkpoint directory. All
+    // processes read the checkpoint files of the previous run before any of
+    // them is replaced, and process 0 takes their results and saves them
+    // before the rest of processes start
+    std::vector<Result<int, float>>
+    run_checkpointed(Search &search, const Dataset<uint64_t> &dataset,
+                     const unsigned int order, const unsigned int outputs)
+    {
+        if (Distribution<int>::binomial(dataset.snps, order) ==
+            std::numeric_limits<uint64_t>::max()) {
+            throw std::runtime_error(
+                "Input data limit exceeded: too many combinations for "
+                "checkpoints");
+        }
+        Checkpoint progress(checkpoint, mpi_rank, dataset.snps, order, outputs,
+                            checkpoint_interval);
+        if (resume) {
+            progress.load(mpi_rank == 0);
+        }
+        Tracer::Scope scope("MPI_Barrier");
+        MPI_Barrier(MPI_COMM_WORLD);
+        scope.end();
+        if (mpi_rank == 0) {
+            if (!resume) {
+                progress.clear();
+            }
+            progress.save();
+        }
+        scope.begin();
+        MPI_Barrier(MPI_COMM_WORLD);
+        scope.end();
+        const auto report =
+            monitor(Distribution<int>::binomial(dataset.snps, order),
+                    progress.completed());
+        return progress.run(search, dataset, mpi_rank, mpi_size);
+    }
+
+    // Measure the number of combinations per second explored by the search,
+    // using the first combinations of the search space. The work of the
+    // threads during the measurement is not added to the Report
+    static double calibrate(Search &search, const Dataset<uint64_t> &dataset,
+                            const unsigned int order, const uint64_t total)
+    {
+        const Report::Suspend suspend;
+        const uint64_t combinations = std::min<uint64_t>(total, 1 << 22);
+        const Distribution<int> distribution(
+            dataset.snps, order - 1, 0,
+            Distribution<int>::boundary(dataset.snps, order - 1, combinations),
+            1, 0);
+        double time = MPI_Wtime();
+        search.run(dataset, order, distribution, 1);
+        time = MPI_Wtime() - time;
+        return combinations / std::max(time, 1e-6);
+    }
+
+    // Explore a single contiguous range of combinations, with a size
+    // proportional to the weight of this process over the sum of the weights
+    // of all processes. Ranges are split by the number of combinations of the
+    // target order, so that the work is proportional to the weights
+    std::vector<Result<int, float>>
+    run_weighted(Search &search, const Dataset<uint64_t> &dataset,
+                 const unsigned int order, const unsigned int outputs)
+    {
+        const uint64_t total = Distribution<int>::binomial(dataset.snps, order);
+        if (total == std::numeric_limits<uint64_t>::max()) {
+            throw std::runtime_error(
+                "Input data limit exceeded: too many combinations for weighted "
+                "scheduling");
+        }
+        double w = weight > 0
+                       ? weight
+                       : calibrate(search, dataset, order, total);
+        std::vector<double> weights(mpi_size);
+        Tracer::Scope scope("MPI_Allgather");
+        MPI_Allgather(&w, 1, MPI_DOUBLE, weights.data(), 1, MPI_DOUBLE,
+                      MPI_COMM_WORLD);
+        scope.end();
+        long double sum = 0, before = 0;
+        for (auto i = 0; i < mpi_size; i++) {
+            sum += weights[i];
+            before += i < mpi_rank ? weights[i] : 0;
+        }
+        const uint64_t first = before / sum * total,
+                       last = mpi_rank == mpi_size - 1
+                                  ? total
+                                  : (before + w) / sum * total;
+#ifdef BENCHMARK
+        std::cout << "Weight " << w << ", combinations [" << first << ", "
+                  << last << ")\n";
+#endif
+        const Distribution<int> distribution(
+            dataset.snps, order - 1,
+            Distribution<int>::boundary(dataset.snps, order - 1, first),
+            Distribution<int>::boundary(dataset.snps, order - 1, last), 1, 0);
+        // The progress reports and the work of the threads in the Report
+        // leave out the calibration, although its time is part of the compute
+        // time of the process
+        const auto progress = monitor(total);
+        return search.run(dataset, order, distribution, outputs);
+    }
+
+    // Count the SNPs of the tped file in process 0, and broadcast the count
+    size_t count_snps(const std::string &tped)
     {
-        std::stringstream oss;
-        for (auto r = results.begin(); r != results.end(); r++) {
-            Result<int, float>::serialize(oss, *r);
+        // Status and number of SNPs
+        unsigned long long header[2] = {0, 0};
+        std::exception_ptr error;
+        if (mpi_rank == 0) {
+            try {
+                header[1] = Dataset<uint64_t>::count_snps(tped);
+                header[0] = 1;
+            } catch (const std::runtime_error &) {
+                error = std::current_exception();
+            }
         }
-        std::string s = oss.str();
-        return s;
+        MPI_Bcast(header, 2, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+        if (error) {
+            std::rethrow_exception(error);
+        } else if (header[0] == 0) {
+            throw std::runtime_error("Process 0 could not read the data set");
+        }
+        return header[1];
     }
 
-    static void deserialize_results(const std::string &s,
-                                    std::vector<Result<int, float>> &v)
+    // Split the SNPs in blocks, and enumerate the pairs of blocks (i, j), with
+    // i <= j, row by row in alternating directions, so that consecutive pairs
+    // share a block. The pairs are assigned to processes in contiguous runs
+    // with a similar number of SNP pairs. Then, each process reads the blocks
+    // of its pairs and explores them, using the SNPs of block j to extend the
+    // SNPs of block i
+    std::vector<Result<int, float>>
+    run_block_pairs(Search &search, const std::string &tped,
+                    const std::string &tfam, const unsigned int outputs)
     {
-        std::stringstream iss(s);
-        Result<int, float> buffer;
-        while ((size_t)iss.tellg() < s.size()) {
-            Result<int, float>::deserialize(iss, buffer);
-            v.push_back(buffer);
+        const size_t n = count_snps(tped);
+        if (n > (size_t)std::numeric_limits<int>::max()) {
+            throw std::runtime_error(
+                "Input data limit exceeded: Dataset contains more than " +
+                std::to_string(std::numeric_limits<int>::max()) + " SNPs");
+        }
+        // By default, use enough blocks to have two pairs per process
+        size_t count = blocks;
+        if (count == 0) {
+            count = 1;
+            while (count * (count + 1) / 2 < 2 * (size_t)mpi_size) {
+                count++;
+            }
+        }
+        count = std::max<size_t>(1, std::min(count, n));
+        const auto progress = monitor(Distribution<int>::binomial(n, 2));
+        auto block_start = [n, count](const size_t b) { return b * n / count; };
+        auto block_size = [&block_start](const size_t b) {
+            return block_start(b + 1) - block_start(b);
+        };
+        std::vector<std::pair<size_t, size_t>> pairs;
+        for (size_t i = 0; i < count; i++) {
+            for (size_t k = i; k < count; k++) {
+                pairs.emplace_back(i, i % 2 == 0 ? k : count - 1 - (k - i));
+            }
         }
+        auto work = [&block_size](const std::pair<size_t, size_t> &p) {
+            const uint64_t a = block_size(p.first), b = block_size(p.second);
+            return p.first == p.second ? a * (a - 1) / 2 : a * b;
+        };
+        long double total = 0;
+        for (const auto &p : pairs) {
+            total += work(p);
+        }
+        // Each pair goes to the process that contains the middle of its work
+        std::vector<std::pair<size_t, size_t>> local_pairs;
+        std::vector<bool> needed(count, false);
+        long double acc = 0;
+        for (const auto &p : pairs) {
+            const long double w = work(p);
+            const int rank = std::min<long double>(
+                mpi_size - 1, total > 0 ? (acc + w / 2) / total * mpi_size : 0);
+            acc += w;
+            if (rank == mpi_rank) {
+                local_pairs.push_back(p);
+                needed[p.first] = needed[p.second] = true;
+            }
+        }
+#ifdef BENCHMARK
+        std::cout << "Assigned " << local_pairs.size() << " of "
+                  << pairs.size() << " pairs of blocks\n";
+#endif
+        if (local_pairs.empty()) {
+            return std::vector<Result<int, float>>();
+        }
+        // Read the blocks needed, and keep the position of each block in the
+        // local Dataset
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<size_t> local_start(count, 0);
+        std::vector<int> global;
+        for (size_t b = 0; b < count; b++) {
+            if (!needed[b]) {
+                continue;
+            }
+            local_start[b] = global.size();
+            for (size_t s = block_start(b); s < block_start(b + 1); s++) {
+                global.push_back(s);
+            }
+            if (!ranges.empty() && ranges.back().second == block_start(b)) {
+                ranges.back().second = block_start(b + 1);
+            } else {
+                ranges.emplace_back(block_start(b), block_start(b + 1));
+            }
+        }
+        Tracer::Scope scope("dataset load");
+        double time = MPI_Wtime();
+        const auto dataset = Dataset<uint64_t>::read<ALIGNMENT>(
+            tped, tfam, ranges, placement);
+        scope.end();
+        Report *report = Report::current();
+        if (report != nullptr) {
+            report->dataset(dataset);
+            report->snps = n;
+            report->local().load += MPI_Wtime() - time;
+        }
+        time = MPI_Wtime();
+        if (dataset.snps != global.size()) {
+            throw std::runtime_error("Error in " + tped +
+                                     ": the number of SNPs changed while "
+                                     "reading the file");
+        }
+        std::vector<Result<int, float>> results;
+        for (const auto &p : local_pairs) {
+            const size_t i = local_start[p.first], j = local_start[p.second];
+            const Distribution<int> distribution =
+                Distribution<int>(dataset.snps, 1, i, i + block_size(p.first),
+                                  1, 0)
+                    .suffixes(j, j + block_size(p.second));
+            auto pair_results = search.run(dataset, 2, distribution, outputs);
+            // Translate the local SNP indices and keep the best results found
+            // so far
+            for (auto &r : pair_results) {
+                for (auto &snp : r.combination) {
+                    snp = global[snp];
+                }
+            }
+            Tracer::Scope merge("top-K merge");
+            results.insert(results.end(), pair_results.begin(),
+                           pair_results.end());
+            std::sort(results.rbegin(), results.rend());
+            if (results.size() > outputs) {
+                results.resize(outputs);
+            }
+        }
+        if (report != nullptr) {
+            report->local().compute += MPI_Wtime() - time;
+        }
+        return results;
     }
 
   public:
@@ -93,9 +932,88 @@ class MPIEngine
      * Create an MPIEngine object. The constructor calls MPI routines, and thus
      * it is mandatory to call the constructor after the MPI environment has
      * been initialized with the `MPI_Init` function.
+     *
+     * @param placement Memory placement policy used for the Dataset
+     * @param broadcast If true, the Dataset is only read by process 0, which
+     * then broadcasts its tables to the rest of processes. Otherwise, every
+     * process reads the input files
+     * @param shared If true, the tables of the Dataset are stored once per
+     * node in shared memory, and the processes of the node map that copy
+     * instead of allocating their own. The placement policy is ignored in this
+     * case
+     * @param scheduling Policy used to distribute the combinations among
+     * processes
+     * @param weight Capacity of this process, used by the
+     * MPIScheduling::Weighted policy. Only the ratio between the weights of
+     * the different processes is relevant. If it is not greater than 0, the
+     * capacity is measured with a short run of the search before starting
+     * @param blocks Number of blocks in which the SNPs are split by the
+     * MPIScheduling::BlockPairs policy. If it is 0, the number of blocks is
+     * chosen so that there are about two pairs of blocks per process
+     * @param stream If true, the search starts while the Dataset is still
+     * being read, exploring the combinations of the SNPs read so far. Ignored
+     * if the Dataset is broadcast or shared, or with the
+     * MPIScheduling::BlockPairs and MPIScheduling::Individuals policies
+     * @param checkpoint Path to a directory where the progress of the search
+     * is saved. Only supported by the MPIScheduling::Static policy, which then
+     * deals chunks of combinations to the processes instead of single
+     * combinations. If empty, no progress is saved
+     * @param resume If true, the combinations completed according to the
+     * checkpoint directory are skipped, and the results found by the previous
+     * run are included. The number of processes and threads may differ from
+     * the previous run
+     * @param checkpoint_interval Minimum number of seconds between two saves
+     * of the progress of a process
+     * @param progress_interval Number of seconds between two reports of the
+     * progress of the search, written by process 0 with the counters of all
+     * processes added up. If it is not greater than 0, no reports are
+     * written. With more than one process, the MPI environment must have been
+     * initialized with `MPI_THREAD_MULTIPLE` support
+     * @param progress_file Path to the file where the reports are written. If
+     * empty, they are written to the standard error
+     * @param trace Path to the file where process 0 writes the timeline of
+     * each call to MPIEngine::run, as a Chrome trace with the events of the
+     * threads of all processes on its clock. If empty, no timeline is
+     * recorded
      */
 
-    MPIEngine() : mpi_size(get_mpi_size()), mpi_rank(get_mpi_rank()) {}
+    MPIEngine(const DatasetPlacement placement = DatasetPlacement::Default,
+              const bool broadcast = false, const bool shared = false,
+              const MPIScheduling scheduling = MPIScheduling::Static,
+              const double weight = 0, const unsigned int blocks = 0,
+              const bool stream = false, const std::string &checkpoint = "",
+              const bool resume = false, const double checkpoint_interval = 600,
+              const double progress_interval = 0,
+              const std::string &progress_file = "",
+              const std::string &trace = "")
+        : mpi_size(get_mpi_size()), mpi_rank(get_mpi_rank()),
+          placement(placement), broadcast(broadcast), shared(shared),
+          scheduling(scheduling), weight(weight), blocks(blocks),
+          stream(stream), checkpoint(checkpoint), resume(resume),
+          checkpoint_interval(checkpoint_interval),
+          progress_interval(progress_interval), progress_file(progress_file),
+          progress_comm(MPI_COMM_NULL), trace(trace)
+    {
+        if (progress_interval > 0 && mpi_size > 1) {
+            int provided;
+            MPI_Query_thread(&provided);
+            if (provided < MPI_THREAD_MULTIPLE) {
+                throw std::runtime_error(
+                    "Progress reports with more than one process require "
+                    "MPI_THREAD_MULTIPLE support");
+            }
+            MPI_Comm_dup(MPI_COMM_WORLD, &progress_comm);
+        }
+    }
+
+    MPIEngine(const MPIEngine &) = delete;
+
+    ~MPIEngine()
+    {
+        if (progress_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&progress_comm);
+        }
+    }
 
     //@}
 
@@ -109,6 +1027,18 @@ class MPIEngine
      * will, in turn, call Search::run to exploit the resources available to
      * that process. The returned vector will only be available to process 0.
      *
+     * With the MPIScheduling::BlockPairs policy, each process reads only the
+     * SNPs it needs from the input files, ignoring the \a broadcast and \a
+     * shared options. This policy only supports pairs of SNPs.
+     *
+     * With the MPIScheduling::Individuals policy, each process reads only its
+     * slice of the individuals, ignoring the \a broadcast and \a shared
+     * options, and \a T must be MPISlicedSearch.
+     *
+     * If a Report object exists in every process, each of them adds the
+     * time spent reading the Dataset and searching to its own Report, and
+     * the Report of process 0 receives the work done by all processes.
+     *
      * @return Vector of Result's sorted in descending order by their
      * MutualInformation value
      * @param tped Path to the tped data file
@@ -128,16 +1058,58 @@ class MPIEngine
         const unsigned int order, const unsigned int outputs, Args &&...args)
     {
         std::vector<Result<int, float>> local_results, global_results;
+        std::unique_ptr<Tracer> tracer(trace.empty() ? nullptr : new Tracer());
 #ifdef BENCHMARK
         double function_time, dataset_time;
         function_time = MPI_Wtime();
         dataset_time = MPI_Wtime();
+        std::fill(PhaseTimer::totals().begin(), PhaseTimer::totals().end(), 0);
 #endif
-#ifdef ALIGN
-        const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
-#else
-        const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+        if (!checkpoint.empty() && scheduling != MPIScheduling::Static) {
+            throw std::runtime_error(
+                "Checkpoints are only supported with static scheduling");
+        }
+        if (scheduling == MPIScheduling::BlockPairs) {
+            if (order != 2) {
+                throw std::runtime_error(
+                    "Block pair scheduling only supports an order of 2");
+            }
+            std::unique_ptr<Search> search(new T(std::forward<Args>(args)...));
+            local_results = run_block_pairs(*search, tped, tfam, outputs);
+            global_results = reduce_results(local_results, order, outputs);
+            if (Report::current() != nullptr) {
+                gather_report(*Report::current());
+            }
+            if (tracer) {
+                write_trace(*tracer);
+            }
+#ifdef BENCHMARK
+            print_phases();
+            function_time = MPI_Wtime() - function_time;
+            std::cout << "Total elapsed time: " << function_time << '\n';
 #endif
+            return global_results;
+        }
+        if (scheduling == MPIScheduling::Individuals &&
+            !std::is_base_of<MPISlicedSearch, T>::value) {
+            throw std::runtime_error(
+                "Individual scheduling requires the MPISlicedSearch class");
+        }
+        Tracer::Scope load_scope("dataset load");
+        Report *report = Report::current();
+        double time = MPI_Wtime();
+        const auto dataset =
+            scheduling == MPIScheduling::Individuals
+                ? Dataset<uint64_t>::read_slice<ALIGNMENT>(
+                      tped, tfam, mpi_rank, mpi_size, placement)
+            : shared ? load_shared(tped, tfam)
+                     : load(tped, tfam, MPI_COMM_WORLD, placement);
+        load_scope.end();
+        if (report != nullptr) {
+            report->dataset(dataset);
+            report->local().load += MPI_Wtime() - time;
+        }
+        time = MPI_Wtime();
         // Check Dataset size to avoid int overflow
         if (dataset.snps > (size_t)std::numeric_limits<int>::max()) {
             throw std::runtime_error(
@@ -146,55 +1118,53 @@ class MPIEngine
         }
 #ifdef BENCHMARK
         dataset_time = MPI_Wtime() - dataset_time;
-        std::cout << "Read " << dataset.snps << " SNPs from "
+        std::cout << (shared                            ? "Loaded "
+                      : broadcast && mpi_rank != 0 ? "Received "
+                      : stream && !broadcast       ? "Started reading "
+                                                   : "Read ")
+                  << dataset.snps << " SNPs from "
                   << dataset.cases + dataset.ctrls << " individuals ("
                   << dataset.cases << " cases, " << dataset.ctrls
                   << " controls) in " << dataset_time << " seconds\n";
 #endif
-        const Distribution<int> distribution(dataset.snps, order - 1, mpi_size,
-                                             mpi_rank);
         Search *search = new T(std::forward<Args>(args)...);
-        local_results = search->run(dataset, order, distribution, outputs);
-        delete search;
-        // Serialize the results
-        const std::string serialized_results = serialize_results(local_results);
-        local_results.clear();
-        const int nbytes = serialized_results.size();
-        // If process is rank 0
-        if (mpi_rank == 0) {
-            // Gather the number of results per process
-            std::vector<int> recv_counts(mpi_size);
-            MPI_Gather(&nbytes, 1, MPI_INT, recv_counts.data(), 1, MPI_INT, 0,
-                       MPI_COMM_WORLD);
-            std::vector<int> recv_displs(mpi_size);
-            recv_displs[0] = 0;
-            for (auto i = 1; i < mpi_size; i++) {
-                recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
-            }
-            // Gather the actual results
-            std::string buffer(
-                recv_displs[mpi_size - 1] + recv_counts[mpi_size - 1], '\0');
-            MPI_Gatherv(serialized_results.data(), serialized_results.size(),
-                        MPI_BYTE, (void *)buffer.data(), recv_counts.data(),
-                        recv_displs.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
-            // Deserialize the results
-            deserialize_results(buffer, global_results);
-            // Sort the result
-            std::sort(global_results.rbegin(), global_results.rend());
-            if (global_results.size() > outputs) {
-                global_results.resize(outputs);
-            }
+        if (!checkpoint.empty()) {
+            local_results = run_checkpointed(*search, dataset, order, outputs);
+        } else if (scheduling == MPIScheduling::Dynamic) {
+            local_results = run_dynamic(*search, dataset, order, outputs);
+        } else if (scheduling == MPIScheduling::Weighted) {
+            local_results = run_weighted(*search, dataset, order, outputs);
+        } else if (scheduling == MPIScheduling::Individuals) {
+            // All processes explore all the combinations, but each one scores
+            // a different share of them
+            const auto progress =
+                monitor(Distribution<int>::binomial(dataset.snps, order));
+            const Distribution<int> distribution(dataset.snps, order - 1, 1, 0);
+            local_results = search->run(dataset, order, distribution, outputs);
         } else {
-            // Send the number of results to process with rank 0
-            MPI_Gather(&nbytes, 1, MPI_INT, nullptr, 1, MPI_INT, 0,
-                       MPI_COMM_WORLD);
-            // Send the actual serialized results to process with rank 0
-            MPI_Gatherv(serialized_results.data(), serialized_results.size(),
-                        MPI_BYTE, nullptr, nullptr, nullptr, MPI_BYTE, 0,
-                        MPI_COMM_WORLD);
+            const auto progress =
+                monitor(Distribution<int>::binomial(dataset.snps, order));
+            const Distribution<int> distribution(dataset.snps, order - 1,
+                                                 mpi_size, mpi_rank);
+            local_results = search->run(dataset, order, distribution, outputs);
+        }
+        delete search;
+        // Raise any error found while streaming the Dataset
+        dataset.finish();
+        if (report != nullptr) {
+            report->local().compute += MPI_Wtime() - time;
+        }
+        // Merge the best results of every process in process 0
+        global_results = reduce_results(local_results, order, outputs);
+        if (report != nullptr) {
+            gather_report(*report);
+        }
+        if (tracer) {
+            write_trace(*tracer);
         }
 
 #ifdef BENCHMARK
+        print_phases();
         function_time = MPI_Wtime() - function_time;
         std::cout << "Total elapsed time: " << function_time << '\n';
 #endif
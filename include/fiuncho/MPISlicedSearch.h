@@ -0,0 +1,437 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file MPISlicedSearch.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_MPISLICEDSEARCH_H
+#define FIUNCHO_MPISLICEDSEARCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fiuncho/ContingencyTable.h>
+#include <fiuncho/GenotypeTable.h>
+#include <fiuncho/Search.h>
+#include <fiuncho/algorithms/MutualInformation.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fiuncho/utils/Arena.h>
+#include <fiuncho/utils/Autotuner.h>
+#include <fiuncho/utils/MaxArray.h>
+#include <fiuncho/utils/Progress.h>
+#include <fiuncho/utils/Report.h>
+#include <fiuncho/utils/Tracer.h>
+#include <iostream>
+#include <mpi.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * Epistasis search class for data sets partitioned by individuals among MPI
+ * processes. Every process holds all SNPs for its own slice of the cases and
+ * controls, and explores all the combinations of the distribution, filling
+ * partial contingency tables. The partial tables of each block of combinations
+ * are added up with `MPI_Ireduce_scatter_block`, so that each process receives
+ * the complete tables of a different part of the block and computes their MI.
+ * The reduction of a block overlaps with filling the tables of the next one.
+ *
+ * Inside each process, the combinations of a block are distributed among
+ * threads. Thread 0 runs in the calling thread, and it is the only one that
+ * calls MPI routines, so MPI must be initialized with at least
+ * `MPI_THREAD_FUNNELED` support.
+ */
+
+class MPISlicedSearch : public Search
+{
+    const unsigned int nthreads;
+    const std::vector<int> cpus;
+    const MPI_Comm comm;
+
+    // State shared by all threads during a search
+    class Shared
+    {
+      public:
+        const Dataset<uint64_t> &dataset;
+        const unsigned short order;
+        const Distribution<int> &distribution;
+        const MPI_Comm comm;
+        const int comm_rank;
+        // Number of tables of a block scored by each process, and number of
+        // values of each table
+        const size_t share, ct_size;
+        const MutualInformation<float> mi;
+        pthread_barrier_t barrier;
+        Arena arena;
+        // Double-buffered blocks: partial tables of this process, complete
+        // tables of the share of this process, combinations and request of the
+        // reduction in flight
+        uint32_t *partial[2], *total[2];
+        std::vector<ContingencyTable<uint32_t>> partial_cts[2], total_cts[2];
+        std::vector<Result<int, float>> r[2];
+        int count[2];
+        MPI_Request request[2];
+
+        Shared(const Dataset<uint64_t> &dataset, const unsigned short order,
+               const Distribution<int> &distribution, const MPI_Comm comm,
+               const int comm_size, const int comm_rank, const size_t share,
+               const size_t ct_size, const unsigned int cases,
+               const unsigned int ctrls, const unsigned int nthreads)
+            : dataset(dataset), order(order), distribution(distribution),
+              comm(comm), comm_rank(comm_rank), share(share), ct_size(ct_size),
+              mi(cases, ctrls),
+              arena(2 * share * (comm_size + 1) *
+                    Arena::footprint<uint32_t>(ct_size))
+        {
+            pthread_barrier_init(&barrier, nullptr, nthreads);
+            const size_t cw = dataset[0].cases_words,
+                         tw = dataset[0].ctrls_words;
+            for (auto b = 0; b < 2; ++b) {
+                // The arena is zero-filled, so the padding of the tables is
+                // well defined when reduced
+                partial[b] = arena.allocate<uint32_t>(share * comm_size *
+                                                      ct_size);
+                total[b] = arena.allocate<uint32_t>(share * ct_size);
+                partial_cts[b].reserve(share * comm_size);
+                for (size_t k = 0; k < share * comm_size; ++k) {
+                    partial_cts[b].emplace_back(order, cw, tw,
+                                                partial[b] + k * ct_size);
+                }
+                total_cts[b].reserve(share);
+                for (size_t k = 0; k < share; ++k) {
+                    total_cts[b].emplace_back(order, cw, tw,
+                                              total[b] + k * ct_size);
+                }
+                r[b].resize(share * comm_size);
+                for (auto &result : r[b]) {
+                    result.combination.resize(order);
+                }
+                count[b] = 0;
+                request[b] = MPI_REQUEST_NULL;
+            }
+        }
+
+        ~Shared() { pthread_barrier_destroy(&barrier); }
+    };
+
+    class Args
+    {
+      public:
+        Shared &shared;
+        const unsigned short order;
+        const unsigned int id;
+        const unsigned int nthreads;
+        const int cpu;
+        MaxArray<Result<int, float>> maxarray;
+        Progress::Counter progress;
+        // Seconds spent in the search, and combinations evaluated
+        double wall_time;
+        size_t combinations;
+#ifdef BENCHMARK
+        double elapsed_time;
+#endif
+
+        Args(Shared &shared, const unsigned int id, const unsigned int nthreads,
+             const int cpu, const size_t outputs)
+            : shared(shared), order(shared.order), id(id), nthreads(nthreads),
+              cpu(cpu), maxarray(outputs), wall_time(0), combinations(0)
+        {
+#ifdef BENCHMARK
+            elapsed_time = 0;
+#endif
+        }
+    };
+
+    static void thread_main(Args &args)
+    {
+        if (args.cpu >= 0) {
+            const int rc = pin_thread({args.cpu});
+            if (rc != 0) {
+                std::cerr << "Error calling pthread_setaffinity_np: " << rc
+                          << "\n";
+            }
+        }
+        const auto start = std::chrono::steady_clock::now();
+#ifdef BENCHMARK
+        struct timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+            throw std::runtime_error("Error while CLOCK_THREAD_CPUTIME_ID");
+        }
+        double start_time = ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+        search(args);
+        args.wall_time = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+#ifdef BENCHMARK
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+            throw std::runtime_error("Error while CLOCK_THREAD_CPUTIME_ID");
+        }
+        args.elapsed_time = ts.tv_sec + ts.tv_nsec * 1e-9 - start_time;
+#endif
+    }
+
+    static void search(Args &args)
+    {
+        auto &shared = args.shared;
+        const auto &dataset = shared.dataset;
+        const auto &distribution = shared.distribution;
+        const int block_size = shared.r[0].size();
+        const size_t cw = dataset[0].cases_words, tw = dataset[0].ctrls_words;
+        // Allocate genotype tables of size < target interaction order
+        std::vector<GenotypeTable<uint64_t>> gts;
+        gts.reserve(args.order - 2);
+        for (auto o = 2; o < args.order; ++o) {
+            gts.emplace_back(o, cw, tw);
+        }
+        // Combinations are dealt in turn, so all SNPs must be populated
+        dataset.wait(dataset.snps);
+        Tracer::Scope fill("block fill");
+        int b = 0, j = 0;
+        // For each combination assigned by the distribution
+        for (auto c = distribution.begin(); c < distribution.end(); ++c) {
+            bool prefix_ready = args.order == 2;
+            const auto &prefix = args.order > 2 ? gts.back() : dataset[c[0]];
+            // Iterate over subsequent combinations
+            for (int i = std::max(c->back() + 1, distribution.suffix_first);
+                 i < distribution.suffix_last; ++i) {
+                // If the block is full, start its reduction
+                if (j == block_size) {
+                    fill.end();
+                    step(args, b, j);
+                    fill.begin();
+                    b ^= 1;
+                    j = 0;
+                }
+                // Combinations of the block are dealt to threads in turn
+                if (j % args.nthreads == args.id) {
+                    if (!prefix_ready) {
+                        // Fill genotype tables
+                        GenotypeTable<uint64_t>::combine(
+                            dataset[c[0]], dataset[c[1]], gts[0]);
+                        for (auto p = 1; p < args.order - 2; ++p) {
+                            GenotypeTable<uint64_t>::combine(
+                                gts[p - 1], dataset[c[p + 1]], gts[p]);
+                        }
+                        prefix_ready = true;
+                    }
+                    auto &r = shared.r[b][j];
+                    std::copy(c->begin(), c->end(), r.combination.begin());
+                    r.combination.back() = i;
+                    // Fill the partial contingency table of this process
+                    GenotypeTable<uint64_t>::combine_and_popcnt(
+                        prefix, dataset[i], shared.partial_cts[b][j]);
+                }
+                // Let MPI progress the reduction of the previous block, also
+                // when a single thread fills all the tables
+                if (args.id == 0 && j % 64 == 0) {
+                    int flag;
+                    MPI_Test(&shared.request[b ^ 1], &flag, MPI_STATUS_IGNORE);
+                }
+                ++j;
+            }
+        }
+        // Every thread and process went through the same combinations, so all
+        // of them reach this point with the same number of tables in the block
+        fill.end();
+        if (j > 0) {
+            step(args, b, j);
+            b ^= 1;
+        }
+        // Score the last block
+        pthread_barrier_wait(&shared.barrier);
+        if (args.id == 0) {
+            MPI_Wait(&shared.request[b ^ 1], MPI_STATUS_IGNORE);
+        }
+        pthread_barrier_wait(&shared.barrier);
+        score(args, b ^ 1);
+    }
+
+    // Start the reduction of block b, containing count tables, and score the
+    // previous block once its reduction completes
+    static void step(Args &args, const int b, const int count)
+    {
+        auto &shared = args.shared;
+        pthread_barrier_wait(&shared.barrier);
+        if (args.id == 0) {
+            Tracer::Scope scope("MPI_Ireduce_scatter_block");
+            shared.count[b] = count;
+            MPI_Ireduce_scatter_block(shared.partial[b], shared.total[b],
+                                      shared.share * shared.ct_size,
+                                      MPI_UINT32_T, MPI_SUM, shared.comm,
+                                      &shared.request[b]);
+            MPI_Wait(&shared.request[b ^ 1], MPI_STATUS_IGNORE);
+        }
+        pthread_barrier_wait(&shared.barrier);
+        score(args, b ^ 1);
+    }
+
+    // Compute the MI of the complete tables of block b received by this
+    // process. Each thread scores a different range of them
+    static void score(Args &args, const int b)
+    {
+        Tracer::Scope scope("block score");
+        auto &shared = args.shared;
+        const int first = shared.comm_rank * shared.share;
+        const int owned = std::max(
+            0, std::min<int>(shared.count[b] - first, shared.share));
+        const int begin = (size_t)owned * args.id / args.nthreads,
+                  end = (size_t)owned * (args.id + 1) / args.nthreads;
+        for (auto k = begin; k < end; ++k) {
+            auto &r = shared.r[b][first + k];
+            r.val = shared.mi.compute(shared.total_cts[b][k]);
+            args.maxarray.add(r);
+        }
+        args.progress.add(end - begin);
+        args.progress.bound(args.maxarray);
+        // The combinations of the block can not be overwritten until all
+        // threads are done with them
+        pthread_barrier_wait(&shared.barrier);
+        args.combinations += end - begin;
+    }
+
+  public:
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a MPISlicedSearch object.
+     *
+     * @param threads Number of threads to use during the search
+     * @param cpus CPU ids to pin the threads to. Thread \a i runs on CPU
+     * `cpus[i % cpus.size()]`. If empty, threads are not pinned
+     * @param comm Communicator of the processes that hold the different slices
+     * of individuals. All of them must call MPISlicedSearch::run with the same
+     * distribution
+     */
+
+    MPISlicedSearch(unsigned int threads,
+                    const std::vector<int> &cpus = std::vector<int>(),
+                    const MPI_Comm comm = MPI_COMM_WORLD)
+        : nthreads(threads), cpus(cpus), comm(comm)
+    {
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Run the epistasis search over the slice of individuals held by this
+     * process. This method is collective over the communicator of the search.
+     *
+     * @return Vector with the best Result's among the combinations scored by
+     * this process
+     * @param dataset Dataset holding the slice of individuals of this process
+     * @param order Size of the combinations to explore
+     * @param distribution Distribution of the combinations, identical in all
+     * processes
+     * @param outputs Number of results to include in the output vector
+     */
+
+    std::vector<Result<int, float>> run(const Dataset<uint64_t> &dataset,
+                                        const unsigned short order,
+                                        const Distribution<int> &distribution,
+                                        const unsigned int outputs)
+    {
+        // Thread 0 calls MPI from the thread that called this method, while
+        // the rest of threads are running
+        int provided;
+        MPI_Query_thread(&provided);
+        if (nthreads > 1 && provided < MPI_THREAD_FUNNELED) {
+            throw std::runtime_error(
+                "MPISlicedSearch requires MPI_THREAD_FUNNELED support to use "
+                "more than one thread");
+        }
+        int comm_size, comm_rank;
+        MPI_Comm_size(comm, &comm_size);
+        MPI_Comm_rank(comm, &comm_rank);
+        // Scores are computed with the size of the whole data set
+        unsigned long long counts[2] = {dataset.cases, dataset.ctrls};
+        MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                      comm);
+        // Blocks are padded so that every process scores the same number of
+        // tables
+        const size_t share =
+            (Autotuner::default_block_size(order) + comm_size - 1) / comm_size;
+        Shared shared(dataset, order, distribution, comm, comm_size, comm_rank,
+                      share, ContingencyTable<uint32_t>::required_size(order),
+                      counts[0], counts[1], nthreads);
+        std::vector<Args> thread_args;
+        thread_args.reserve(nthreads);
+        for (unsigned int i = 0; i < nthreads; i++) {
+            thread_args.emplace_back(shared, i, nthreads,
+                                     cpus.empty() ? -1 : cpus[i % cpus.size()],
+                                     outputs);
+        }
+        std::vector<std::thread> threads;
+        threads.reserve(nthreads - 1);
+        for (unsigned int i = 1; i < nthreads; i++) {
+            threads.emplace_back(thread_main, std::ref(thread_args[i]));
+        }
+        // Thread 0 runs in the calling thread, which gets its own affinity back
+        // once the search ends
+        cpu_set_t affinity;
+        const bool pinned =
+            !cpus.empty() && pthread_getaffinity_np(pthread_self(),
+                                                    sizeof(cpu_set_t),
+                                                    &affinity) == 0;
+        thread_main(thread_args[0]);
+        if (pinned) {
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                   &affinity);
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        std::vector<Result<int, float>> results;
+        results.reserve(nthreads * outputs);
+        for (unsigned int i = 0; i < thread_args.size(); i++) {
+            results.insert(
+                results.end(), &thread_args[i].maxarray[0],
+                &thread_args[i].maxarray[thread_args[i].maxarray.size()]);
+            Report::thread(i, thread_args[i].wall_time,
+                           thread_args[i].combinations);
+#ifdef BENCHMARK
+            // Print information
+            std::cout << "Thread " << i << ": " << thread_args[i].elapsed_time
+                      << "s, " << thread_args[i].combinations
+                      << " combinations\n";
+#endif
+        }
+        // Sort the auxiliar array and resize the result before returning
+        std::sort(results.rbegin(), results.rend());
+        if (results.size() > outputs) {
+            results.resize(outputs);
+        }
+        return results;
+    }
+
+    //@}
+};
+
+#endif
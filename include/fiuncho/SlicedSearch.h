@@ -0,0 +1,384 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file SlicedSearch.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_SLICEDSEARCH_H
+#define FIUNCHO_SLICEDSEARCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <fiuncho/ContingencyTable.h>
+#include <fiuncho/GenotypeTable.h>
+#include <fiuncho/Search.h>
+#include <fiuncho/algorithms/MutualInformation.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fiuncho/utils/Arena.h>
+#include <fiuncho/utils/Autotuner.h>
+#include <fiuncho/utils/MaxArray.h>
+#include <fiuncho/utils/Progress.h>
+#include <fiuncho/utils/Report.h>
+#include <fiuncho/utils/Tracer.h>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+/**
+ * Epistasis search class that uses CPU multi-threading to complete the
+ * search, partitioning the individuals instead of the combinations among
+ * threads. Every thread explores all the combinations of the distribution over
+ * its own slice of the cases and controls, and the partial contingency tables
+ * of all threads are added up before computing their MI. This is intended for
+ * data sets with few SNPs and a large number of individuals, where each thread
+ * can keep its slice of the bit tables in cache.
+ */
+
+class SlicedSearch : public Search
+{
+    // Slices are a multiple of the vector width, so that their rows are aligned
+#ifdef ALIGN
+    static constexpr size_t WORDS = ALIGN / sizeof(uint64_t);
+#else
+    static constexpr size_t WORDS = 1;
+#endif
+
+    const unsigned int nthreads;
+    const std::vector<int> cpus;
+    Autotuner tuner;
+
+    // State shared by all threads during a search
+    class Shared
+    {
+      public:
+        const Dataset<uint64_t> &dataset;
+        const unsigned short order;
+        const Distribution<int> &distribution;
+        // Number of contingency tables in the block of each thread
+        const int block_size;
+        pthread_barrier_t barrier;
+        // Partial ContingencyTable block of each thread
+        std::vector<std::vector<ContingencyTable<uint32_t>> *> partials;
+
+        Shared(const Dataset<uint64_t> &dataset, const unsigned short order,
+               const Distribution<int> &distribution, const int block_size,
+               const unsigned int nthreads)
+            : dataset(dataset), order(order), distribution(distribution),
+              block_size(block_size), partials(nthreads, nullptr)
+        {
+            pthread_barrier_init(&barrier, nullptr, nthreads);
+        }
+
+        ~Shared() { pthread_barrier_destroy(&barrier); }
+    };
+
+    class Args
+    {
+      public:
+        Shared &shared;
+        const unsigned short order;
+        const unsigned int id;
+        const int cpu;
+        // First word and number of words of the slice of each group
+        const size_t cases_first, cases_words, ctrls_first, ctrls_words;
+        MaxArray<Result<int, float>> maxarray;
+        Progress::Counter progress;
+        // Seconds spent in the search, and combinations evaluated
+        double wall_time;
+        size_t combinations;
+#ifdef BENCHMARK
+        double elapsed_time;
+#endif
+
+        Args(Shared &shared, const unsigned int id, const int cpu,
+             const size_t cases_first, const size_t cases_words,
+             const size_t ctrls_first, const size_t ctrls_words,
+             const size_t outputs)
+            : shared(shared), order(shared.order), id(id), cpu(cpu),
+              cases_first(cases_first), cases_words(cases_words),
+              ctrls_first(ctrls_first), ctrls_words(ctrls_words),
+              maxarray(outputs), wall_time(0), combinations(0)
+        {
+#ifdef BENCHMARK
+            elapsed_time = 0;
+#endif
+        }
+    };
+
+    static void thread_main(Args &args)
+    {
+        if (args.cpu >= 0) {
+            const int rc = pin_thread({args.cpu});
+            if (rc != 0) {
+                std::cerr << "Error calling pthread_setaffinity_np: " << rc
+                          << "\n";
+            }
+        }
+        const auto start = std::chrono::steady_clock::now();
+#ifdef BENCHMARK
+        struct timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+            throw std::runtime_error("Error while CLOCK_THREAD_CPUTIME_ID");
+        }
+        double start_time = ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+        const auto &dataset = args.shared.dataset;
+        const size_t cw = args.cases_words, tw = args.ctrls_words;
+        const size_t ct_size = ContingencyTable<uint32_t>::required_size(
+            args.order);
+        // Allocate the slice, the genotype tables and the ContingencyTable
+        // block from a single arena, touched by this thread
+        size_t arena_size =
+            dataset.snps * Arena::footprint<uint64_t>(3 * (cw + tw)) +
+            args.shared.block_size * Arena::footprint<uint32_t>(ct_size);
+        for (auto o = 2; o < args.order; ++o) {
+            arena_size += Arena::footprint<uint64_t>(
+                GenotypeTable<uint64_t>::required_size(o, cw, tw));
+        }
+        Arena arena(arena_size);
+        // Copy the slice of each SNP, once all of them are populated
+        dataset.wait(dataset.snps);
+        std::vector<GenotypeTable<uint64_t>> tables;
+        tables.reserve(dataset.snps);
+        for (size_t s = 0; s < dataset.snps; ++s) {
+            const auto &t = dataset[s];
+            uint64_t *ptr = arena.allocate<uint64_t>(3 * (cw + tw));
+            for (auto k = 0; k < 3; ++k) {
+                memcpy(ptr + k * cw,
+                       t.cases + k * t.cases_words + args.cases_first,
+                       cw * sizeof(uint64_t));
+                memcpy(ptr + 3 * cw + k * tw,
+                       t.ctrls + k * t.ctrls_words + args.ctrls_first,
+                       tw * sizeof(uint64_t));
+            }
+            tables.emplace_back(ptr, cw, ptr + 3 * cw, tw);
+        }
+        // Allocate genotype tables of size < target interaction order
+        std::vector<GenotypeTable<uint64_t>> gts;
+        gts.reserve(args.order - 2);
+        for (auto o = 2; o < args.order; ++o) {
+            gts.emplace_back(o, cw, tw,
+                             arena.allocate<uint64_t>(
+                                 GenotypeTable<uint64_t>::required_size(o, cw,
+                                                                        tw)));
+        }
+        // Allocate the ContingencyTable block and the Result block
+        std::vector<ContingencyTable<uint32_t>> cts;
+        const int block_size = args.shared.block_size;
+        cts.reserve(block_size);
+        for (auto i = 0; i < block_size; ++i) {
+            cts.emplace_back(args.order, cw, tw,
+                             arena.allocate<uint32_t>(ct_size));
+        }
+        std::vector<Result<int, float>> r(block_size);
+        for (auto &result : r) {
+            result.combination.resize(args.order);
+        }
+        // Publish the block before any thread starts reducing
+        args.shared.partials[args.id] = &cts;
+        pthread_barrier_wait(&args.shared.barrier);
+
+        search(args, tables, gts, cts, r);
+        args.wall_time = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+#ifdef BENCHMARK
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+            throw std::runtime_error("Error while CLOCK_THREAD_CPUTIME_ID");
+        }
+        args.elapsed_time = ts.tv_sec + ts.tv_nsec * 1e-9 - start_time;
+#endif
+    }
+
+    // Add up the partial tables of all threads into the tables of thread 0 and
+    // compute their MI. Each thread reduces and scores a different range of
+    // the block
+    static void reduce(Args &args, MutualInformation<float> &mi,
+                       std::vector<Result<int, float>> &r, const int count)
+    {
+        Tracer::Scope scope("block score");
+        auto &partials = args.shared.partials;
+        const unsigned int nthreads = partials.size();
+        pthread_barrier_wait(&args.shared.barrier);
+        const int first = (size_t)count * args.id / nthreads,
+                  last = (size_t)count * (args.id + 1) / nthreads;
+        for (auto k = first; k < last; ++k) {
+            auto &out = (*partials[0])[k];
+            for (unsigned int p = 1; p < nthreads; ++p) {
+                const auto &in = (*partials[p])[k];
+                for (size_t i = 0; i < out.size; ++i) {
+                    out.cases[i] += in.cases[i];
+                    out.ctrls[i] += in.ctrls[i];
+                }
+            }
+            // Compute mutual information
+            r[k].val = mi.compute(out);
+            args.maxarray.add(r[k]);
+        }
+        args.progress.add(last - first);
+        args.progress.bound(args.maxarray);
+        // Tables can not be refilled until all threads are done with them
+        pthread_barrier_wait(&args.shared.barrier);
+        args.combinations += last - first;
+    }
+
+    static void search(Args &args,
+                       const std::vector<GenotypeTable<uint64_t>> &tables,
+                       std::vector<GenotypeTable<uint64_t>> &gts,
+                       std::vector<ContingencyTable<uint32_t>> &cts,
+                       std::vector<Result<int, float>> &r)
+    {
+        int i, j;
+        const auto &dataset = args.shared.dataset;
+        const auto &distribution = args.shared.distribution;
+        const int block_size = args.shared.block_size;
+        // Create the MI object with the size of the whole data set
+        MutualInformation<float> mi(dataset.cases, dataset.ctrls);
+        Tracer::Scope fill("block fill");
+        // For each combination assigned by the distribution
+        j = 0;
+        for (auto c = distribution.begin(); c < distribution.end(); ++c) {
+            // Fill genotype tables
+            if (args.order > 2) {
+                GenotypeTable<uint64_t>::combine(tables[c[0]], tables[c[1]],
+                                                 gts[0]);
+                for (auto i = 1; i < args.order - 2; ++i) {
+                    GenotypeTable<uint64_t>::combine(
+                        gts[i - 1], tables[c[i + 1]], gts[i]);
+                }
+            }
+            const auto &prefix = args.order > 2 ? gts.back() : tables[c[0]];
+            // Iterate over subsequent combinations
+            for (i = std::max(c->back() + 1, distribution.suffix_first);
+                 i < distribution.suffix_last; ++i) {
+                // If the block is full, reduce and compute all MI's
+                if (j == block_size) {
+                    fill.end();
+                    reduce(args, mi, r, j);
+                    fill.begin();
+                    j = 0;
+                }
+                memcpy(r[j].combination.data(), c->data(),
+                       c->size() * sizeof(int));
+                r[j].combination.back() = i;
+                // Fill the partial contingency table of the slice
+                GenotypeTable<uint64_t>::combine_and_popcnt(prefix, tables[i],
+                                                            cts[j++]);
+            }
+        }
+        // Every thread went through the same combinations, so all of them
+        // reach this point with the same number of tables in the block
+        fill.end();
+        if (j > 0) {
+            reduce(args, mi, r, j);
+        }
+    }
+
+  public:
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a SlicedSearch object.
+     *
+     * @param threads Number of threads to use during the search
+     * @param cpus CPU ids to pin the threads to. Thread \a i runs on CPU
+     * `cpus[i % cpus.size()]`. If empty, threads are not pinned
+     * @param tuner Autotuner that selects the number of contingency tables
+     * in the block of each thread
+     */
+
+    SlicedSearch(unsigned int threads,
+                 const std::vector<int> &cpus = std::vector<int>(),
+                 const Autotuner &tuner = Autotuner())
+        : nthreads(threads), cpus(cpus), tuner(tuner)
+    {
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    std::vector<Result<int, float>> run(const Dataset<uint64_t> &dataset,
+                                        const unsigned short order,
+                                        const Distribution<int> &distribution,
+                                        const unsigned int outputs)
+    {
+        Shared shared(dataset, order, distribution,
+                      tuner.block_size(dataset, order), nthreads);
+        // Split the words of each group in nthreads slices
+        const size_t cases_units = dataset[0].cases_words / WORDS,
+                     ctrls_units = dataset[0].ctrls_words / WORDS;
+        std::vector<Args> thread_args;
+        thread_args.reserve(nthreads);
+        for (unsigned int i = 0; i < nthreads; i++) {
+            const size_t cases_first = cases_units * i / nthreads,
+                         cases_last = cases_units * (i + 1) / nthreads,
+                         ctrls_first = ctrls_units * i / nthreads,
+                         ctrls_last = ctrls_units * (i + 1) / nthreads;
+            thread_args.emplace_back(
+                shared, i, cpus.empty() ? -1 : cpus[i % cpus.size()],
+                cases_first * WORDS, (cases_last - cases_first) * WORDS,
+                ctrls_first * WORDS, (ctrls_last - ctrls_first) * WORDS,
+                outputs);
+        }
+        std::vector<std::thread> threads;
+        threads.reserve(nthreads);
+        for (unsigned int i = 0; i < nthreads; i++) {
+            threads.emplace_back(thread_main, std::ref(thread_args[i]));
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        std::vector<Result<int, float>> results;
+        results.reserve(nthreads * outputs);
+        for (unsigned int i = 0; i < thread_args.size(); i++) {
+            results.insert(
+                results.end(), &thread_args[i].maxarray[0],
+                &thread_args[i].maxarray[thread_args[i].maxarray.size()]);
+            Report::thread(i, thread_args[i].wall_time,
+                           thread_args[i].combinations);
+#ifdef BENCHMARK
+            // Print information
+            std::cout << "Thread " << i << ": " << thread_args[i].elapsed_time
+                      << "s, " << thread_args[i].combinations
+                      << " combinations\n";
+#endif
+        }
+        // Sort the auxiliar array and resize the result before returning
+        std::sort(results.rbegin(), results.rend());
+        if (results.size() > outputs) {
+            results.resize(outputs);
+        }
+        return results;
+    }
+
+    //@}
+};
+
+#endif
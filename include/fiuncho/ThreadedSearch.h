@@ -23,19 +23,31 @@
 #ifndef FIUNCHO_THREADEDSEARCH_H
 #define FIUNCHO_THREADEDSEARCH_H
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fiuncho/ContingencyTable.h>
 #include <fiuncho/GenotypeTable.h>
 #include <fiuncho/Search.h>
 #include <fiuncho/algorithms/MutualInformation.h>
 #include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fiuncho/utils/Arena.h>
+#include <fiuncho/utils/Autotuner.h>
 #include <fiuncho/utils/MaxArray.h>
+#include <fiuncho/utils/PhaseTimer.h>
+#include <fiuncho/utils/Progress.h>
+#include <fiuncho/utils/Report.h>
+#include <fiuncho/utils/RingBuffer.h>
+#include <fiuncho/utils/Tracer.h>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <pthread.h>
 #include <thread>
 #include <vector>
 
-#define BLOCK_SIZE (int)(16384 / powf(3, args.order - 2))
+#define PIPELINE_SLOTS 4
 
 /**
  * Epistasis search class that uses CPU multi-threading to complete the
@@ -46,6 +58,32 @@ class ThreadedSearch : public Search
 {
 
     const unsigned int nthreads;
+    const std::vector<int> cpus;
+    const bool persistent;
+    const unsigned int pipeline;
+    Autotuner tuner;
+
+    // Task performed by a thread during a search
+    enum class Role
+    {
+        // Fills contingency tables and computes their MI
+        Standalone,
+        // Fills contingency tables and hands them over to a Scorer
+        Counter,
+        // Computes the MI of the contingency tables filled by its Counters
+        Scorer
+    };
+
+    // Block of contingency tables and their corresponding results
+    class Block
+    {
+      public:
+        std::vector<ContingencyTable<uint32_t>> cts;
+        std::vector<Result<int, float>> r;
+        int size;
+    };
+
+    typedef RingBuffer<Block> Ring;
 
     class Args
     {
@@ -53,26 +91,244 @@ class ThreadedSearch : public Search
         const Dataset<uint64_t> &dataset;
         const unsigned short order;
         const Distribution<int> distribution;
+        // Number of contingency tables filled before computing their MI
+        const int block_size;
+        // GenotypeTable's of the dataset placed in the NUMA node of the thread
+        const std::vector<GenotypeTable<uint64_t>> &tables;
         MaxArray<Result<int, float>> maxarray;
+        const Role role;
+        // Ring filled by a Counter, or rings drained by a Scorer
+        std::vector<Ring *> rings;
+        Progress::Counter progress;
+        PhaseTimer timer;
+        // Seconds spent in the search, and combinations evaluated
+        double wall_time;
+        size_t combinations;
 #ifdef BENCHMARK
         double elapsed_time;
-        size_t combinations;
+        std::vector<double> phases;
 #endif
 
         Args(const Dataset<uint64_t> &dataset, const unsigned short order,
-             const Distribution<int> &distribution, const size_t outputs)
+             const Distribution<int> &distribution, const int block_size,
+             const size_t outputs, const int cpu, const Role role)
             : dataset(dataset), order(order), distribution(distribution),
-              maxarray(outputs)
+              block_size(block_size),
+              tables(dataset.replica(cpu < 0 ? 0 : numa_node_of_cpu(cpu))),
+              maxarray(outputs), role(role), wall_time(0), combinations(0)
         {
 #ifdef BENCHMARK
             elapsed_time = 0;
-            combinations = 0;
 #endif
         }
     };
 
-    static void thread_main(Args &args)
+    /**
+     * Per-thread buffers used during the search: the intermediate
+     * GenotypeTable's and one or more Block's. The buffers are kept between
+     * calls to ThreadedSearch::run, and the underlying Arena is only replaced
+     * when a larger order or number of individuals is requested.
+     */
+
+    class Scratch
+    {
+        std::unique_ptr<Arena> arena;
+        unsigned short order;
+        size_t cases_words, ctrls_words;
+        int block_size, nblocks;
+
+      public:
+        std::vector<GenotypeTable<uint64_t>> gts;
+        std::vector<Block> blocks;
+
+        Scratch()
+            : order(0), cases_words(0), ctrls_words(0), block_size(0),
+              nblocks(0)
+        {
+        }
+
+        void prepare(const unsigned short order, const size_t cases_words,
+                     const size_t ctrls_words, const int block_size,
+                     const int nblocks)
+        {
+            if (order == this->order && cases_words == this->cases_words &&
+                ctrls_words == this->ctrls_words &&
+                block_size == this->block_size && nblocks == this->nblocks) {
+                return;
+            }
+            const size_t ct_size =
+                ContingencyTable<uint32_t>::required_size(order);
+            size_t arena_size =
+                nblocks * block_size * Arena::footprint<uint32_t>(ct_size);
+            for (auto o = 2; o < order; ++o) {
+                arena_size += Arena::footprint<uint64_t>(
+                    GenotypeTable<uint64_t>::required_size(o, cases_words,
+                                                           ctrls_words));
+            }
+            // Drop the views into the previous arena before replacing it
+            gts.clear();
+            blocks.clear();
+            if (!arena || arena->capacity() < arena_size) {
+                arena.reset();
+                arena.reset(new Arena(arena_size));
+            } else {
+                arena->clear();
+            }
+            // Allocate genotype tables of size < target interaction order
+            gts.reserve(order - 2);
+            for (auto o = 2; o < order; ++o) {
+                gts.emplace_back(o, cases_words, ctrls_words,
+                                 arena->allocate<uint64_t>(
+                                     GenotypeTable<uint64_t>::required_size(
+                                         o, cases_words, ctrls_words)));
+            }
+            // Allocate the ContingencyTable and Result blocks
+            blocks.resize(nblocks);
+            for (auto &block : blocks) {
+                block.cts.reserve(block_size);
+                for (auto i = 0; i < block_size; ++i) {
+                    block.cts.emplace_back(order, cases_words, ctrls_words,
+                                           arena->allocate<uint32_t>(ct_size));
+                }
+                block.r.resize(block_size);
+                for (auto &result : block.r) {
+                    result.combination.resize(order);
+                }
+                block.size = 0;
+            }
+            this->order = order;
+            this->cases_words = cases_words;
+            this->ctrls_words = ctrls_words;
+            this->block_size = block_size;
+            this->nblocks = nblocks;
+        }
+    };
+
+    // Destination of the blocks of a Standalone thread: they are scored in
+    // place as soon as they are full
+    class LocalSink
+    {
+        Args &args;
+        Block &block;
+        MutualInformation<float> mi;
+
+      public:
+        LocalSink(Args &args, Scratch &scratch)
+            : args(args), block(scratch.blocks[0]),
+              mi(args.dataset.cases, args.dataset.ctrls)
+        {
+        }
+
+        Block &next() { return block; }
+
+        void flush(Block &block, const int size)
+        {
+            score(block, size, mi, args.maxarray, args.timer);
+            args.progress.bound(args.maxarray);
+        }
+
+        void finish() {}
+    };
+
+    // Destination of the blocks of a Counter thread: they are handed over to
+    // its Scorer through a ring, and filling continues in the next free slot
+    class RingSink
+    {
+        Args &args;
+        Ring &ring;
+
+      public:
+        RingSink(Args &args, Scratch &scratch)
+            : args(args), ring(*args.rings[0])
+        {
+            ring.attach(scratch.blocks.data());
+        }
+
+        Block &next()
+        {
+            Block *block;
+            while ((block = ring.back()) == nullptr) {
+                std::this_thread::yield();
+            }
+            args.timer.lap(Phase::Wait);
+            return *block;
+        }
+
+        void flush(Block &block, const int size)
+        {
+            block.size = size;
+            ring.push();
+        }
+
+        void finish() { ring.close(); }
+    };
+
+    // Worker pool state
+    std::vector<std::thread> workers;
+    std::vector<Args> thread_args;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::mutex mutex;
+    std::condition_variable job_cv, done_cv;
+    size_t generation;
+    unsigned int finished;
+    bool stopping;
+
+    void worker_main(const unsigned int id, size_t current)
+    {
+        if (!cpus.empty()) {
+            const int rc = pin_thread({cpus[id % cpus.size()]});
+            if (rc != 0) {
+                std::cerr << "Error calling pthread_setaffinity_np: " << rc
+                          << "\n";
+            }
+        }
+        // Buffers are created by the worker so that they are placed in its
+        // NUMA node
+        Scratch scratch;
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_cv.wait(lock,
+                        [&]() { return stopping || generation != current; });
+            if (stopping) {
+                return;
+            }
+            current = generation;
+            Args &args = thread_args[id];
+            lock.unlock();
+            thread_main(args, scratch);
+            lock.lock();
+            if (++finished == nthreads) {
+                done_cv.notify_one();
+            }
+        }
+    }
+
+    void start_workers()
     {
+        stopping = false;
+        workers.reserve(nthreads);
+        for (unsigned int i = 0; i < nthreads; i++) {
+            workers.emplace_back(&ThreadedSearch::worker_main, this, i,
+                                 generation);
+        }
+    }
+
+    void stop_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        job_cv.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+        workers.clear();
+    }
+
+    static void thread_main(Args &args, Scratch &scratch)
+    {
+        const auto start = std::chrono::steady_clock::now();
 #ifdef BENCHMARK
         struct timespec ts;
         if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
@@ -80,130 +336,203 @@ class ThreadedSearch : public Search
         }
         double start_time = ts.tv_sec + ts.tv_nsec * 1e-9;
 #endif
-        if (args.order == 2) {
-            search_order_2(args);
+        args.timer.start();
+        if (args.role == Role::Scorer) {
+            drain(args);
+        } else if (args.role == Role::Counter) {
+            // Split the block in smaller slots so that the ring takes the same
+            // amount of memory as the block of a Standalone thread
+            scratch.prepare(args.order, args.tables[0].cases_words,
+                            args.tables[0].ctrls_words,
+                            std::max(args.block_size / PIPELINE_SLOTS, 1),
+                            PIPELINE_SLOTS);
+            RingSink sink(args, scratch);
+            search(args, scratch, sink);
         } else {
-            search_order_gt_2(args);
+            scratch.prepare(args.order, args.tables[0].cases_words,
+                            args.tables[0].ctrls_words, args.block_size, 1);
+            LocalSink sink(args, scratch);
+            search(args, scratch, sink);
         }
+        args.wall_time = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
 #ifdef BENCHMARK
         if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
             throw std::runtime_error("Error while CLOCK_THREAD_CPUTIME_ID");
         }
         args.elapsed_time = ts.tv_sec + ts.tv_nsec * 1e-9 - start_time;
+        args.phases = args.timer.stop(args.combinations);
 #endif
     }
 
-    static void search_order_2(Args &args)
+    static inline void score(Block &block, const int size,
+                             MutualInformation<float> &mi,
+                             MaxArray<Result<int, float>> &maxarray,
+                             PhaseTimer &timer)
     {
-        int i, j, k;
-        // Create the ContingencyTable vector, Result vector, and MI objects
-        std::vector<ContingencyTable<uint32_t>> cts;
-        std::vector<Result<int, float>> r(BLOCK_SIZE);
-        cts.reserve(BLOCK_SIZE);
-        for (i = 0; i < BLOCK_SIZE; ++i) {
-            cts.emplace_back(2, args.dataset[0].cases_words,
-                             args.dataset[0].ctrls_words);
-            r[i].combination.resize(2);
+        Tracer::Scope scope("block score");
+        for (auto k = 0; k < size; ++k) {
+            // Compute mutual information
+            block.r[k].val = mi.compute(block.cts[k]);
         }
+        timer.lap(Phase::MI);
+        for (auto k = 0; k < size; ++k) {
+            maxarray.add(block.r[k]);
+        }
+        timer.lap(Phase::TopK);
+    }
+
+    static void drain(Args &args)
+    {
+        // Create the MI object
         MutualInformation<float> mi(args.dataset.cases, args.dataset.ctrls);
+        std::vector<Ring *> open(args.rings);
+        // Round-robin over the rings until all of them are drained
+        while (!open.empty()) {
+            bool idle = true;
+            for (size_t i = 0; i < open.size();) {
+                Block *block = open[i]->front();
+                if (block != nullptr) {
+                    score(*block, block->size, mi, args.maxarray, args.timer);
+                    args.progress.bound(args.maxarray);
+                    open[i]->pop();
+                    idle = false;
+                } else if (open[i]->drained()) {
+                    open.erase(open.begin() + i);
+                    continue;
+                }
+                ++i;
+            }
+            if (idle) {
+                std::this_thread::yield();
+                args.timer.lap(Phase::Wait);
+            }
+        }
+    }
+
+    template <class Sink>
+    static void search(Args &args, Scratch &scratch, Sink &sink)
+    {
+        if (args.order == 2) {
+            search_order_2(args, scratch, sink);
+        } else {
+            search_order_gt_2(args, scratch, sink);
+        }
+        sink.finish();
+    }
+
+    template <class Sink>
+    static void search_order_2(Args &args, Scratch &scratch, Sink &sink)
+    {
+        int i, j;
+        const int block_size = scratch.blocks[0].cts.size();
+        Block *block = &sink.next();
+        Tracer::Scope fill("block fill");
+        // Number of SNPs known to be populated, if the Dataset is streamed
+        size_t available = 0;
         // For each combination assigned by the distribution
         j = 0;
         for (auto c = args.distribution.begin(); c < args.distribution.end();
              ++c) {
             // Iterate over subsequent combinations
-            for (i = c->back() + 1; i < (int)args.dataset.snps; ++i) {
-                // If the block is full, compute all MI's
-                if (j == BLOCK_SIZE) {
-                    for (k = 0; k < BLOCK_SIZE; ++k) {
-                        // Compute mutual information
-                        r[k].val = mi.compute(cts[k]);
-                        args.maxarray.add(r[k]);
-                    }
-#ifdef BENCHMARK
+            for (i = std::max(c->back() + 1, args.distribution.suffix_first);
+                 i < args.distribution.suffix_last; ++i) {
+                if ((size_t)i >= available) {
+                    args.timer.lap(Phase::Popcount);
+                    available = args.dataset.wait(i + 1);
+                    args.timer.lap(Phase::Wait);
+                }
+                // If the block is full, hand it over to the sink
+                if (j == block_size) {
+                    args.timer.lap(Phase::Popcount);
+                    fill.end();
+                    sink.flush(*block, j);
+                    args.progress.add(j);
                     args.combinations += j;
-#endif
+                    block = &sink.next();
+                    fill.begin();
                     j = 0;
                 }
-                r[j].combination[0] = c[0];
-                r[j].combination[1] = i;
+                block->r[j].combination[0] = c[0];
+                block->r[j].combination[1] = i;
                 // Fill contingency table
                 GenotypeTable<uint64_t>::combine_and_popcnt(
-                    args.dataset[c[0]], args.dataset[i], cts[j++]);
+                    args.tables[c[0]], args.tables[i], block->cts[j++]);
             }
         }
-        // For each contingency table remaining in the block
-        for (k = 0; k < j; ++k) {
-            // Compute mutual information
-            r[k].val = mi.compute(cts[k]);
-            args.maxarray.add(r[k]);
+        // Hand over the contingency tables remaining in the block
+        fill.end();
+        if (j > 0) {
+            args.timer.lap(Phase::Popcount);
+            sink.flush(*block, j);
+            args.progress.add(j);
         }
-#ifdef BENCHMARK
         args.combinations += j;
-#endif
     }
 
-    static void search_order_gt_2(Args &args)
+    template <class Sink>
+    static void search_order_gt_2(Args &args, Scratch &scratch, Sink &sink)
     {
-        int i, j, k;
-        // Allocate genotype tables of size < target interaction order
-        std::vector<GenotypeTable<uint64_t>> gts;
-        gts.reserve(args.order - 2);
-        for (auto o = 2; o < args.order; ++o) {
-            gts.emplace_back(o, args.dataset[0].cases_words,
-                             args.dataset[0].ctrls_words);
-        }
-        // Create ContingencyTable vector, Result vector, and MI objects
-        std::vector<ContingencyTable<uint32_t>> cts;
-        std::vector<Result<int, float>> r(BLOCK_SIZE);
-        cts.reserve(BLOCK_SIZE);
-        for (i = 0; i < BLOCK_SIZE; ++i) {
-            cts.emplace_back(args.order, args.dataset[0].cases_words,
-                             args.dataset[0].ctrls_words);
-            r[i].combination.resize(args.order);
-        }
-        MutualInformation<float> mi(args.dataset.cases, args.dataset.ctrls);
+        int i, j;
+        auto &gts = scratch.gts;
+        const int block_size = scratch.blocks[0].cts.size();
+        Block *block = &sink.next();
+        Tracer::Scope fill("block fill");
+        // Number of SNPs known to be populated, if the Dataset is streamed
+        size_t available = 0;
         // For each combination assigned by the distribution
         j = 0;
         for (auto c = args.distribution.begin(); c < args.distribution.end();
              ++c) {
+            args.timer.lap(Phase::Popcount);
+            if ((size_t)c->back() >= available) {
+                available = args.dataset.wait(c->back() + 1);
+                args.timer.lap(Phase::Wait);
+            }
             // Fill genotype tables
-            GenotypeTable<uint64_t>::combine(args.dataset[c[0]],
-                                             args.dataset[c[1]], gts[0]);
+            GenotypeTable<uint64_t>::combine(args.tables[c[0]],
+                                             args.tables[c[1]], gts[0]);
             for (auto i = 1; i < args.order - 2; ++i) {
                 GenotypeTable<uint64_t>::combine(
-                    gts[i - 1], args.dataset[c[i + 1]], gts[i]);
+                    gts[i - 1], args.tables[c[i + 1]], gts[i]);
             }
+            args.timer.lap(Phase::Combine);
             // Iterate over subsequent combinations
-            for (i = c->back() + 1; i < (int)args.dataset.snps; ++i) {
-                // If the block is full, compute all MI's
-                if (j == BLOCK_SIZE) {
-                    for (k = 0; k < BLOCK_SIZE; ++k) {
-                        // Compute mutual information
-                        r[k].val = mi.compute(cts[k]);
-                        args.maxarray.add(r[k]);
-                    }
-#ifdef BENCHMARK
+            for (i = std::max(c->back() + 1, args.distribution.suffix_first);
+                 i < args.distribution.suffix_last; ++i) {
+                if ((size_t)i >= available) {
+                    args.timer.lap(Phase::Popcount);
+                    available = args.dataset.wait(i + 1);
+                    args.timer.lap(Phase::Wait);
+                }
+                // If the block is full, hand it over to the sink
+                if (j == block_size) {
+                    args.timer.lap(Phase::Popcount);
+                    fill.end();
+                    sink.flush(*block, j);
+                    args.progress.add(j);
                     args.combinations += j;
-#endif
+                    block = &sink.next();
+                    fill.begin();
                     j = 0;
                 }
-                memcpy(r[j].combination.data(), c->data(),
+                memcpy(block->r[j].combination.data(), c->data(),
                        c->size() * sizeof(int));
-                r[j].combination.back() = i;
+                block->r[j].combination.back() = i;
                 // Fill contingency table
                 GenotypeTable<uint64_t>::combine_and_popcnt(
-                    gts.back(), args.dataset[i], cts[j++]);
+                    gts.back(), args.tables[i], block->cts[j++]);
             }
         }
-        // For each contingency table remaining in the block
-        for (k = 0; k < j; ++k) {
-            // Compute mutual information
-            r[k].val = mi.compute(cts[k]);
-            args.maxarray.add(r[k]);
+        // Hand over the contingency tables remaining in the block
+        fill.end();
+        if (j > 0) {
+            args.timer.lap(Phase::Popcount);
+            sink.flush(*block, j);
+            args.progress.add(j);
         }
-#ifdef BENCHMARK
         args.combinations += j;
-#endif
     }
 
   public:
@@ -216,13 +545,45 @@ class ThreadedSearch : public Search
      * Create a ThreadedSearch object.
      *
      * @param threads Number of threads to use during the search
+     * @param cpus CPU ids to pin the threads to. Thread \a i runs on CPU
+     * `cpus[i % cpus.size()]`, and reads the copy of the Dataset placed in the
+     * NUMA node of that CPU, if any. If empty, threads are not pinned
+     * @param persistent If true, the threads and their buffers are created on
+     * the first call to ThreadedSearch::run and reused by the following calls
+     * until the object is destroyed. Otherwise, they only live for the
+     * duration of each call
+     * @param pipeline Number of counting threads that feed each scoring thread.
+     * Threads are split in groups of \a pipeline counting threads, which fill
+     * the contingency tables, followed by one scoring thread, which computes
+     * their MI. When pinned, \a cpus is reordered so that the threads of a
+     * group run on SMT siblings whenever possible. Threads that do not fill a
+     * complete group, or all threads if \a pipeline is 0, do both tasks
+     * @param tuner Autotuner that selects the number of contingency tables
+     * filled by each thread before computing their MI, on the first call to
+     * ThreadedSearch::run for each order. By default, the size depends only on
+     * the order
      */
 
-    ThreadedSearch(unsigned int threads) : nthreads(threads) {}
+    ThreadedSearch(unsigned int threads,
+                   const std::vector<int> &cpus = std::vector<int>(),
+                   const bool persistent = false,
+                   const unsigned int pipeline = 0,
+                   const Autotuner &tuner = Autotuner())
+        : nthreads(threads),
+          cpus(pipeline > 0 ? group_smt_siblings(cpus) : cpus),
+          persistent(persistent), pipeline(pipeline), tuner(tuner),
+          generation(0), finished(0), stopping(false)
+    {
+    }
 
     //@}
 
-    ~ThreadedSearch() {}
+    ~ThreadedSearch()
+    {
+        if (!workers.empty()) {
+            stop_workers();
+        }
+    }
 
     /**
      * @name Methods
@@ -234,34 +595,81 @@ class ThreadedSearch : public Search
                                         const Distribution<int> &distribution,
                                         const unsigned int outputs)
     {
-        // Spawn threads
-        std::vector<Args> thread_args;
-        std::vector<std::thread> threads;
-        // Pre-reserve space to avoid reallocating the underlying array, which
-        // results in an error since previous addresses are rendered incorrect
-        thread_args.reserve(nthreads);
-        threads.reserve(nthreads);
-        for (unsigned int i = 0; i < nthreads; i++) {
-            thread_args.emplace_back(dataset, order,
-                                     distribution.layer(nthreads, i), outputs);
-            threads.emplace_back(thread_main, std::ref(thread_args.back()));
+        const int block_size = tuner.block_size(dataset, order);
+        if (workers.empty()) {
+            start_workers();
+        }
+        // Threads grouped in pipelines, and threads counting combinations
+        const unsigned int group = pipeline + 1;
+        const unsigned int pipelined =
+            pipeline > 0 ? nthreads / group * group : 0;
+        const unsigned int nscorers = pipelined / group;
+        const unsigned int ncounters = nthreads - nscorers;
+        // Publish a new job to the workers
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // Pre-reserve space to avoid reallocating the underlying array,
+            // which results in an error since previous addresses are rendered
+            // incorrect
+            thread_args.clear();
+            thread_args.reserve(nthreads);
+            rings.clear();
+            unsigned int layer = 0;
+            for (unsigned int i = 0; i < nthreads; i++) {
+                const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+                if (i >= pipelined) {
+                    thread_args.emplace_back(
+                        dataset, order, distribution.layer(ncounters, layer++),
+                        block_size, outputs, cpu, Role::Standalone);
+                } else if (i % group < pipeline) {
+                    thread_args.emplace_back(
+                        dataset, order, distribution.layer(ncounters, layer++),
+                        block_size, outputs, cpu, Role::Counter);
+                    rings.emplace_back(new Ring(PIPELINE_SLOTS));
+                    thread_args.back().rings.push_back(rings.back().get());
+                } else {
+                    thread_args.emplace_back(dataset, order, distribution,
+                                             block_size, outputs, cpu,
+                                             Role::Scorer);
+                    // Drain the rings of the preceding Counters of the group
+                    for (unsigned int j = 1; j <= pipeline; j++) {
+                        thread_args.back().rings.push_back(
+                            thread_args[i - j].rings[0]);
+                    }
+                }
+            }
+            finished = 0;
+            ++generation;
+        }
+        job_cv.notify_all();
+        // Wait for the completion of all threads
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done_cv.wait(lock, [&]() { return finished == nthreads; });
+        }
+        if (!persistent) {
+            stop_workers();
         }
 
+        Tracer::Scope merge("top-K merge");
         std::vector<Result<int, float>> results;
         results.reserve(nthreads * outputs);
-        // Wait for the completion of all threads
-        for (unsigned int i = 0; i < threads.size(); i++) {
-            threads[i].join();
+        for (unsigned int i = 0; i < thread_args.size(); i++) {
             results.insert(
                 results.end(), &thread_args[i].maxarray[0],
                 &thread_args[i].maxarray[thread_args[i].maxarray.size()]);
+            Report::thread(i, thread_args[i].wall_time,
+                           thread_args[i].combinations);
 #ifdef BENCHMARK
             // Print information
             std::cout << "Thread " << i << ": " << thread_args[i].elapsed_time
                       << "s, " << thread_args[i].combinations
-                      << " combinations\n";
+                      << " combinations, "
+                      << PhaseTimer::str(thread_args[i].phases) << '\n';
 #endif
         }
+        thread_args.clear();
+        rings.clear();
         // Sort the auxiliar array and resize the result before returning
         std::sort(results.rbegin(), results.rend());
         if (results.size() > outputs) {
@@ -24,13 +24,23 @@
 #ifndef FIUNCHO_DATASET_H
 #define FIUNCHO_DATASET_H
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
 #include <fiuncho/GenotypeTable.h>
 #include <fiuncho/dataset/Individual.h>
 #include <fiuncho/dataset/SNP.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fiuncho/utils/Arena.h>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 /**
@@ -42,6 +52,19 @@
  * GenotypeTable's
  */
 
+/**
+ * Memory placement policies for the bit tables of a Dataset.
+ */
+
+enum class DatasetPlacement {
+    /** A single heap allocation, placed by the operating system */
+    Default,
+    /** A single allocation backed by huge pages */
+    HugePages,
+    /** Huge pages, with an additional copy of the tables in each NUMA node */
+    Replicated
+};
+
 template <class T> class Dataset
 {
   public:
@@ -60,63 +83,396 @@ template <class T> class Dataset
      *
      * @param tped Path to the tped input file
      * @param tfam Path to the tfam input file
+     * @param placement Memory placement policy of the tables
      * @return A Dataset object
      */
 
-    static Dataset<T> read(std::string tped, std::string tfam)
+    static Dataset<T>
+    read(std::string tped, std::string tfam,
+         const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        return read<sizeof(T)>(tped, tfam, placement);
+    }
+
+    /**
+     * Read input data and store it using a GenotypeTable representation. The
+     * underlying arrays used in the different tables are allocated contiguously
+     * in memory, with each array aligned to \a N bytes.
+     *
+     * @param tped Path to the tped input file
+     * @param tfam Path to the tfam input file
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <size_t N>
+    static Dataset<T>
+    read(std::string tped, std::string tfam,
+         const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        return read<N>(tped, tfam, {{0, std::numeric_limits<size_t>::max()}},
+                       placement);
+    }
+
+    /**
+     * Read a subset of the SNPs of the input data and store it using a
+     * GenotypeTable representation. SNPs are selected by their position in the
+     * tped file, and are stored in the same order as they appear in the file.
+     * The underlying arrays used in the different tables are allocated
+     * contiguously in memory, with each array aligned to \a N bytes.
+     *
+     * @param tped Path to the tped input file
+     * @param tfam Path to the tfam input file
+     * @param ranges Ranges [first, last) of SNP indices to read, sorted in
+     * ascending order and not overlapping
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <size_t N>
+    static Dataset<T>
+    read(std::string tped, std::string tfam,
+         const std::vector<std::pair<size_t, size_t>> &ranges,
+         const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        return read_subset<N>(tped, tfam, ranges, 0, 1, placement);
+    }
+
+    /**
+     * Read one slice of the individuals of the input data and store it using a
+     * GenotypeTable representation. Cases and controls are split separately in
+     * \a slices contiguous slices of similar size, following the order in which
+     * individuals appear in the tfam file. The resulting Dataset contains all
+     * SNPs, but only the cases and controls of the slice.
+     *
+     * @param tped Path to the tped input file
+     * @param tfam Path to the tfam input file
+     * @param slice Index of the slice to read
+     * @param slices Number of slices
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <size_t N>
+    static Dataset<T>
+    read_slice(std::string tped, std::string tfam, const size_t slice,
+               const size_t slices,
+               const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        return read_subset<N>(tped, tfam,
+                              {{0, std::numeric_limits<size_t>::max()}},
+                              slice, slices, placement);
+    }
+
+    /**
+     * Read input data in a background thread, returning as soon as the tfam
+     * file is read and the SNPs of the tped file are counted. The tables are
+     * populated in the same order as the SNPs appear in the tped file, and
+     * Dataset::wait can be used to wait for a particular SNP to be available.
+     * The DatasetPlacement::Replicated placement is handled as
+     * DatasetPlacement::HugePages, since tables can not be replicated until
+     * they are populated.
+     *
+     * @param tped Path to the tped input file
+     * @param tfam Path to the tfam input file
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <size_t N>
+    static Dataset<T>
+    stream(std::string tped, std::string tfam,
+           const DatasetPlacement placement = DatasetPlacement::Default)
     {
         std::vector<Individual> individuals;
-        std::vector<SNP> snps;
         size_t cases_count, ctrls_count;
         read_individuals(tfam, individuals, cases_count, ctrls_count);
-        read_snps(tped, individuals, snps);
-        // Allocate enough space for representing all SNPs for all individuals
-        constexpr size_t NBITS = sizeof(T) * 8; // Number of bits in T
-        const size_t cases_words = (cases_count + NBITS - 1) / NBITS,
-                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS;
-        // Find the address of the first aligned position inside the allocation
-        T *alloc = (T *)new T[(cases_words + ctrls_words) * 3 * snps.size()];
-
-        Dataset<uint64_t> d(alloc, cases_count, ctrls_count, snps.size());
-        populate(individuals, snps, alloc, d.table_vector, cases_words,
-                 ctrls_words);
+        const size_t snps_count = count_snps(tped);
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        const size_t count = (cases_words + ctrls_words) * 3 * snps_count;
+        T *ptr;
+        auto storage = allocate<N>(count, placement, ptr);
+
+        Dataset<T> d(std::move(storage), ptr, count, cases_count, ctrls_count,
+                     snps_count);
+        d.layout(cases_words, ctrls_words);
+        // The tables are not reallocated when the Dataset is moved
+        GenotypeTable<T> *tables = d.table_vector.data();
+        d.loader = std::make_shared<Loader>();
+        Loader &loader = *d.loader;
+        loader.thread = std::thread([&loader, tables, snps_count, tped,
+                                     individuals = std::move(individuals)]() {
+            size_t i = 0;
+            try {
+                std::ifstream file;
+                file.open(tped.c_str(), std::ios::in);
+                if (!file.is_open()) {
+                    throw std::runtime_error("Error while opening " + tped +
+                                             ", check file path/permissions");
+                }
+                SNP snp;
+                while (i < snps_count && file >> snp) {
+                    if (snp.genotypes.size() != individuals.size()) {
+                        throw std::runtime_error(
+                            "Error in " + tped + ":" + std::to_string(i + 1) +
+                            ": the number of nucleotides does not match "
+                            "the number of individuals");
+                    }
+                    encode(individuals, snp, tables[i]);
+                    loader.publish(++i);
+                }
+                if (i < snps_count) {
+                    throw std::runtime_error("Error in " + tped +
+                                             ": the file changed while "
+                                             "reading it");
+                }
+            } catch (const SNP::InvalidSNP &e) {
+                loader.error = std::make_exception_ptr(std::runtime_error(
+                    "Error in " + tped + ":" + std::to_string(i + 1) + ": " +
+                    e.what()));
+            } catch (...) {
+                loader.error = std::current_exception();
+            }
+            // Do not leave anyone waiting for the SNPs of a failed read
+            loader.publish(snps_count);
+        });
 
         return d;
     }
 
     /**
-     * Read input data and store it using a GenotypeTable representation. The
-     * underlying arrays used in the different tables are allocated contiguously
-     * in memory, with each array aligned to \a N bytes.
+     * Count the number of SNPs contained in a tped file, without parsing them.
      *
      * @param tped Path to the tped input file
+     * @return The number of SNPs in the file
+     */
+
+    static size_t count_snps(const std::string &tped)
+    {
+        std::ifstream file;
+        file.open(tped.c_str(), std::ios::in);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error while opening " + tped +
+                                     ", check file path/permissions");
+        }
+        size_t count = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            count++;
+        }
+        file.close();
+        return count;
+    }
+
+    /**
+     * Count the number of cases and controls contained in a tfam file.
+     *
      * @param tfam Path to the tfam input file
+     * @param cases Number of individuals in the case group
+     * @param ctrls Number of individuals in the control group
+     */
+
+    static void count_individuals(const std::string &tfam, size_t &cases,
+                                  size_t &ctrls)
+    {
+        std::vector<Individual> individuals;
+        read_individuals(tfam, individuals, cases, ctrls);
+    }
+
+    /**
+     * Number of values of type \a T needed to hold the tables of a data set,
+     * in the format returned by Dataset::raw.
+     *
+     * @param cases_count Number of individuals in the case group
+     * @param ctrls_count Number of individuals in the control group
+     * @param snps_count Number of SNPs
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return The number of values of the tables
+     */
+
+    template <size_t N>
+    static size_t raw_count(const size_t cases_count, const size_t ctrls_count,
+                            const size_t snps_count)
+    {
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        return (cases_words + ctrls_words) * 3 * snps_count;
+    }
+
+    /**
+     * Read input data into an existing allocation, in the same format
+     * returned by Dataset::raw, instead of allocating the tables. The
+     * allocation can later be used with Dataset::map.
+     *
+     * @param tped Path to the tped input file
+     * @param tfam Path to the tfam input file
+     * @param ptr Pointer to the allocation, aligned to \a N bytes
+     * @param count Number of values of the allocation, as returned by
+     * Dataset::raw_count for the input data
      * @tparam N number of bytes to align the underlying arrays to
-     * @return A Dataset object
      */
 
     template <size_t N>
-    static Dataset<T> read(std::string tped, std::string tfam)
+    static void read_into(const std::string &tped, const std::string &tfam,
+                          T *ptr, const size_t count)
     {
         std::vector<Individual> individuals;
         std::vector<SNP> snps;
         size_t cases_count, ctrls_count;
         read_individuals(tfam, individuals, cases_count, ctrls_count);
-        read_snps(tped, individuals, snps);
-        // Allocate enough space for representing all SNPs for all individuals
+        read_snps(tped, individuals, {{0, std::numeric_limits<size_t>::max()}},
+                  {}, snps);
+        if (raw_count<N>(cases_count, ctrls_count, snps.size()) != count) {
+            throw std::runtime_error("Error in " + tped +
+                                     ": the file changed while reading it");
+        }
         constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
         constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
         const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
                      ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
-        // Find the address of the first aligned position inside the allocation
-        T *alloc =
-            (T *)new T[(cases_words + ctrls_words) * 3 * snps.size() + NT];
+        // The padding of the tables is not written by the encoding
+        std::fill(ptr, ptr + count, 0);
+        std::vector<GenotypeTable<T>> tables;
+        populate(individuals, snps, ptr, tables, cases_words, ctrls_words);
+    }
+
+    /**
+     * Create a Dataset with the same layout used by Dataset::read, obtaining
+     * the contents of its tables through a callback instead of the input
+     * files. This allows building a Dataset from the tables of a Dataset read
+     * somewhere else, e.g. by another process.
+     *
+     * @param cases_count Number of individuals in the case group
+     * @param ctrls_count Number of individuals in the control group
+     * @param snps_count Number of SNPs
+     * @param fill Callable invoked as `fill(ptr, count)`, that must write the
+     * \a count values of type \a T holding all the tables starting at \a ptr,
+     * in the same format returned by Dataset::raw
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
 
-        T *ptr = ((T *)((((uintptr_t)alloc) + N - 1) / N * N));
+    template <size_t N, class F>
+    static Dataset<T>
+    create(const size_t cases_count, const size_t ctrls_count,
+           const size_t snps_count, F fill,
+           const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        const size_t count = (cases_words + ctrls_words) * 3 * snps_count;
+        T *ptr;
+        auto storage = allocate<N>(count, placement, ptr);
+
+        Dataset<T> d(std::move(storage), ptr, count, cases_count, ctrls_count,
+                     snps_count);
+        fill(ptr, count);
+        d.layout(cases_words, ctrls_words);
+        if (placement == DatasetPlacement::Replicated) {
+            d.replicate();
+        }
 
-        Dataset<uint64_t> d(alloc, cases_count, ctrls_count, snps.size());
-        populate(individuals, snps, ptr, d.table_vector, cases_words,
-                 ctrls_words);
+        return d;
+    }
+
+    /**
+     * Create a Dataset on top of an existing allocation that already holds
+     * the tables, in the same format returned by Dataset::raw. The allocation
+     * is not copied, and it is kept alive by \a storage for as long as the
+     * Dataset exists.
+     *
+     * @param cases_count Number of individuals in the case group
+     * @param ctrls_count Number of individuals in the control group
+     * @param snps_count Number of SNPs
+     * @param storage Owner of the allocation
+     * @param ptr Pointer to the first value of the tables, aligned to \a N
+     * bytes
+     * @tparam N number of bytes the underlying arrays are aligned to
+     * @return A Dataset object
+     */
+
+    template <size_t N>
+    static Dataset<T> map(const size_t cases_count, const size_t ctrls_count,
+                          const size_t snps_count,
+                          std::shared_ptr<void> storage, T *ptr)
+    {
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        const size_t count = (cases_words + ctrls_words) * 3 * snps_count;
+
+        Dataset<T> d(std::move(storage), ptr, count, cases_count, ctrls_count,
+                     snps_count);
+        d.layout(cases_words, ctrls_words);
+
+        return d;
+    }
+
+    /**
+     * Create a Dataset with the same layout used by Dataset::read, encoding
+     * the genotypes of each SNP obtained through a callback instead of the
+     * input files. This allows building a Dataset from data generated in
+     * memory.
+     *
+     * @param cases_count Number of individuals in the case group
+     * @param ctrls_count Number of individuals in the control group
+     * @param snps_count Number of SNPs
+     * @param genotypes Callable invoked as `genotypes(i, g)` for each SNP \a i
+     * in ascending order, that must store in the `std::vector<uint8_t>` \a g
+     * the genotype (0, 1 or 2) of every case followed by every control
+     * @param placement Memory placement policy of the tables
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <size_t N, class F>
+    static Dataset<T>
+    generate(const size_t cases_count, const size_t ctrls_count,
+             const size_t snps_count, F genotypes,
+             const DatasetPlacement placement = DatasetPlacement::Default)
+    {
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        const size_t count = (cases_words + ctrls_words) * 3 * snps_count;
+        T *ptr;
+        auto storage = allocate<N>(count, placement, ptr);
+
+        Dataset<T> d(std::move(storage), ptr, count, cases_count, ctrls_count,
+                     snps_count);
+        d.layout(cases_words, ctrls_words);
+        std::vector<Individual> individuals(cases_count + ctrls_count);
+        for (size_t j = 0; j < individuals.size(); j++) {
+            individuals[j].ph = j < cases_count ? 2 : 1;
+        }
+        SNP snp;
+        for (size_t i = 0; i < snps_count; i++) {
+            snp.genotypes.resize(individuals.size());
+            genotypes(i, snp.genotypes);
+            if (snp.genotypes.size() != individuals.size()) {
+                throw std::runtime_error(
+                    "The number of genotypes of SNP " + std::to_string(i) +
+                    " does not match the number of individuals");
+            }
+            encode(individuals, snp, d.table_vector[i]);
+        }
+        if (placement == DatasetPlacement::Replicated) {
+            d.replicate();
+        }
 
         return d;
     }
@@ -146,6 +502,83 @@ template <class T> class Dataset
 
     std::vector<GenotypeTable<T>> &data() { return table_vector; }
 
+    /**
+     * Access the contiguous allocation holding the tables of all SNPs. Each SNP
+     * takes \f$ 3 (cases\_words + ctrls\_words) \f$ values: the three rows of
+     * the cases subtable followed by the three rows of the controls subtable.
+     *
+     * @return A pointer to the first value of the allocation
+     */
+
+    const T *raw() const { return buffer; }
+
+    /**
+     * Number of values of type \a T in the allocation returned by
+     * Dataset::raw.
+     */
+
+    size_t raw_size() const { return buffer_size; }
+
+    /**
+     * Wait until the tables of the first \a count SNPs are populated. Datasets
+     * that are not created by Dataset::stream are always populated. If the
+     * background read fails, all SNPs are reported as available, and the error
+     * is raised by Dataset::finish.
+     *
+     * @param count Number of SNPs to wait for
+     * @return The number of SNPs available, that is at least \a count
+     */
+
+    size_t wait(const size_t count) const
+    {
+        if (!loader) {
+            return snps;
+        }
+        const size_t target = std::min(count, snps);
+        size_t ready = loader->ready.load(std::memory_order_acquire);
+        if (ready < target) {
+            std::unique_lock<std::mutex> lock(loader->mutex);
+            loader->cv.wait(lock, [&]() {
+                ready = loader->ready.load(std::memory_order_acquire);
+                return ready >= target;
+            });
+        }
+        return ready;
+    }
+
+    /**
+     * Wait until all the tables are populated, and raise the error of the
+     * background read started by Dataset::stream, if any.
+     */
+
+    void finish() const
+    {
+        if (loader && loader->thread.joinable()) {
+            loader->thread.join();
+        }
+        if (loader && loader->error) {
+            std::rethrow_exception(loader->error);
+        }
+    }
+
+    /**
+     * Access the copy of the GenotypeTable vector placed in a particular NUMA
+     * node. If the Dataset was not read with DatasetPlacement::Replicated, or
+     * there is no copy for that node, the main vector is returned instead.
+     *
+     * @param node NUMA node id
+     * @return A reference to the GenotypeTable vector
+     */
+
+    const std::vector<GenotypeTable<T>> &replica(const int node) const
+    {
+        if (node >= 0 && (size_t)node < replicas.size() &&
+            !replicas[node].tables.empty()) {
+            return replicas[node].tables;
+        }
+        return table_vector;
+    }
+
     //@}
 
     /**
@@ -177,9 +610,173 @@ template <class T> class Dataset
     //@}
 
   private:
-    Dataset(T *ptr, size_t cases_count, size_t ctrls_count, size_t snps_count)
-        : cases(cases_count), ctrls(ctrls_count), snps(snps_count), alloc(ptr)
+    // State of the background read of a Dataset created by Dataset::stream
+    struct Loader {
+        std::atomic<size_t> ready{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr error;
+        std::thread thread;
+
+        void publish(const size_t count)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.store(count, std::memory_order_release);
+            }
+            cv.notify_all();
+        }
+
+        ~Loader()
+        {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    };
+
+    struct Replica {
+        std::shared_ptr<void> storage;
+        std::vector<GenotypeTable<T>> tables;
+    };
+
+    Dataset(std::shared_ptr<void> storage, T *buffer, size_t buffer_size,
+            size_t cases_count, size_t ctrls_count, size_t snps_count)
+        : cases(cases_count), ctrls(ctrls_count), snps(snps_count),
+          storage(std::move(storage)), buffer(buffer), buffer_size(buffer_size)
+    {
+    }
+
+    // Create the views of the SNP tables over the buffer
+    void layout(const size_t cases_words, const size_t ctrls_words)
+    {
+        T *ptr = buffer;
+        table_vector.reserve(snps);
+        for (size_t i = 0; i < snps; i++) {
+            table_vector.emplace_back(ptr, cases_words, ptr + 3 * cases_words,
+                                      ctrls_words);
+            ptr += 3 * cases_words + 3 * ctrls_words;
+        }
+    }
+
+    template <size_t N>
+    static std::shared_ptr<void> allocate(const size_t count,
+                                          const DatasetPlacement placement,
+                                          T *&ptr)
+    {
+        if (placement == DatasetPlacement::Default) {
+            constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+            std::shared_ptr<T> alloc(new T[count + NT],
+                                     std::default_delete<T[]>());
+            // Find the address of the first aligned position inside the
+            // allocation
+            ptr = ((T *)((((uintptr_t)alloc.get()) + N - 1) / N * N));
+            return alloc;
+        } else {
+            // Mappings are page-aligned
+            auto arena = std::make_shared<Arena>(count * sizeof(T), true);
+            ptr = arena->allocate<T>(count);
+            return arena;
+        }
+    }
+
+    // Create a copy of the tables in every NUMA node, except for the node
+    // where the calling thread is running, that keeps using the original
+    // tables
+    void replicate()
+    {
+        const auto nodes = numa_nodes();
+        if (nodes.size() < 2) {
+            return;
+        }
+        const int cpu = sched_getcpu();
+        const int local_node = cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+        // Replicas are indexed by node id, which may have gaps
+        replicas.resize(nodes.back() + 1);
+        std::vector<std::thread> threads;
+        for (const int node : nodes) {
+            const auto cpus = numa_node_cpus(node);
+            if (node == local_node || cpus.empty()) {
+                continue;
+            }
+            // Allocate and copy the tables from a thread running in the target
+            // node, so that the first touch places the pages in that node
+            threads.emplace_back([this, node, cpus]() {
+                pin_thread(cpus);
+                Replica &r = replicas[node];
+                auto arena =
+                    std::make_shared<Arena>(buffer_size * sizeof(T), true);
+                T *ptr = arena->allocate<T>(buffer_size);
+                memcpy(ptr, buffer, buffer_size * sizeof(T));
+                r.tables.reserve(table_vector.size());
+                for (const auto &t : table_vector) {
+                    r.tables.emplace_back(ptr + (t.cases - buffer),
+                                          t.cases_words,
+                                          ptr + (t.ctrls - buffer),
+                                          t.ctrls_words);
+                }
+                r.storage = std::move(arena);
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+
+    template <size_t N>
+    static Dataset<T>
+    read_subset(const std::string &tped, const std::string &tfam,
+                const std::vector<std::pair<size_t, size_t>> &ranges,
+                const size_t slice, const size_t slices,
+                const DatasetPlacement placement)
     {
+        std::vector<Individual> individuals;
+        std::vector<SNP> snps;
+        size_t cases_count, ctrls_count;
+        read_individuals(tfam, individuals, cases_count, ctrls_count);
+        // Select the individuals of the slice
+        std::vector<bool> keep;
+        if (slices > 1) {
+            const size_t cases_first = cases_count * slice / slices,
+                         cases_last = cases_count * (slice + 1) / slices,
+                         ctrls_first = ctrls_count * slice / slices,
+                         ctrls_last = ctrls_count * (slice + 1) / slices;
+            std::vector<Individual> selected;
+            size_t cases_idx = 0, ctrls_idx = 0;
+            for (const auto &ind : individuals) {
+                const size_t idx = ind.ph == 1 ? ctrls_idx++ : cases_idx++;
+                keep.push_back(ind.ph == 1
+                                   ? idx >= ctrls_first && idx < ctrls_last
+                                   : idx >= cases_first && idx < cases_last);
+                if (keep.back()) {
+                    selected.push_back(ind);
+                }
+            }
+            read_snps(tped, individuals, ranges, keep, snps);
+            individuals.swap(selected);
+            cases_count = cases_last - cases_first;
+            ctrls_count = ctrls_last - ctrls_first;
+        } else {
+            read_snps(tped, individuals, ranges, keep, snps);
+        }
+        // Allocate enough space for representing all SNPs for all individuals
+        constexpr size_t NT = N / sizeof(T); // Number of T's in N bytes
+        constexpr size_t NBITS = N * 8;      // Number of bits in N bytes
+        const size_t cases_words = (cases_count + NBITS - 1) / NBITS * NT,
+                     ctrls_words = (ctrls_count + NBITS - 1) / NBITS * NT;
+        const size_t count = (cases_words + ctrls_words) * 3 * snps.size();
+        T *ptr;
+        auto storage = allocate<N>(count, placement, ptr);
+
+        Dataset<T> d(std::move(storage), ptr, count, cases_count, ctrls_count,
+                     snps.size());
+        populate(individuals, snps, ptr, d.table_vector, cases_words,
+                 ctrls_words);
+        if (placement == DatasetPlacement::Replicated) {
+            d.replicate();
+        }
+
+        return d;
     }
 
     inline static void read_individuals(const std::string &tfam,
@@ -208,9 +805,11 @@ template <class T> class Dataset
         file.close();
     }
 
-    inline static void read_snps(const std::string &tped,
-                                 const std::vector<Individual> &individuals,
-                                 std::vector<SNP> &snps)
+    inline static void
+    read_snps(const std::string &tped,
+              const std::vector<Individual> &individuals,
+              const std::vector<std::pair<size_t, size_t>> &ranges,
+              const std::vector<bool> &keep, std::vector<SNP> &snps)
     {
         std::ifstream file;
         file.open(tped.c_str(), std::ios::in);
@@ -218,22 +817,46 @@ template <class T> class Dataset
             throw std::runtime_error("Error while opening " + tped +
                                      ", check file path/permissions");
         }
+        size_t line = 0;
+        auto range = ranges.begin();
         try {
             SNP snp;
-            while (file >> snp) {
-                if (snp.genotypes.size() == individuals.size()) {
-                    snps.push_back(snp);
-                } else {
-                    throw std::runtime_error(
-                        "Error in " + tped + ":" +
-                        std::to_string(snps.size() + 1) +
-                        ": the number of nucleotides does not match "
-                        "the number of individuals");
+            while (range != ranges.end() && file.peek() != EOF) {
+                if (line >= range->second) {
+                    ++range;
+                    continue;
+                }
+                if (line < range->first) {
+                    // Skip the SNPs outside of the ranges without parsing them
+                    file.ignore(std::numeric_limits<std::streamsize>::max(),
+                                '\n');
+                } else if (file >> snp) {
+                    if (snp.genotypes.size() == individuals.size()) {
+                        // Discard the genotypes of the individuals that are
+                        // not kept
+                        if (!keep.empty()) {
+                            size_t kept = 0;
+                            for (size_t g = 0; g < keep.size(); g++) {
+                                if (keep[g]) {
+                                    snp.genotypes[kept++] = snp.genotypes[g];
+                                }
+                            }
+                            snp.genotypes.resize(kept);
+                        }
+                        snps.push_back(snp);
+                    } else {
+                        throw std::runtime_error(
+                            "Error in " + tped + ":" +
+                            std::to_string(line + 1) +
+                            ": the number of nucleotides does not match "
+                            "the number of individuals");
+                    }
                 }
+                ++line;
             }
         } catch (const SNP::InvalidSNP &e) {
             throw std::runtime_error("Error in " + tped + ":" +
-                                     std::to_string(snps.size() + 1) + ": " +
+                                     std::to_string(line + 1) + ": " +
                                      e.what());
         }
         file.close();
@@ -245,92 +868,99 @@ template <class T> class Dataset
                                 const size_t cases_words,
                                 const size_t ctrls_words)
     {
-        constexpr size_t BITS = sizeof(T) * 8; // Number of bits in T
-
-        // Buffers
-        T cases_buff[3], ctrls_buff[3];
         data.reserve(snps.size());
         for (size_t i = 0; i < snps.size(); i++) {
-            // Clear buffers
-            for (auto k = 0; k < 3; k++) {
-                ctrls_buff[k] = 0;
-                cases_buff[k] = 0;
-            }
-
             // Create bit table for each SNP
             data.emplace_back(ptr, cases_words, ptr + 3 * cases_words,
                               ctrls_words);
             ptr += 3 * cases_words + 3 * ctrls_words;
-            auto &table = data.back();
-            // Populate bit table with the snp information
-            size_t cases_cnt = 0;
-            size_t ctrls_cnt = 0;
-            for (size_t j = 0; j < inds.size(); j++) {
-                // For each individual, check phenotype class
-                if (inds[j].ph == 1) { // If it's a control append genotype to
-                    // the 3 control buffers
-                    for (auto k = 0; k < 3; k++) {
-                        ctrls_buff[k] =
-                            (ctrls_buff[k] << 1) + (snps[i].genotypes[j] == k);
-                    }
-                    ctrls_cnt++;
-                } else { // Else append genotype to the 3 cases buffers
-                    for (auto k = 0; k < 3; k++) {
-                        cases_buff[k] =
-                            (cases_buff[k] << 1) + (snps[i].genotypes[j] == k);
-                    }
-                    cases_cnt++;
+            encode(inds, snps[i], data.back());
+        }
+    }
+
+    // Populate the bit table of a single SNP
+    inline static void encode(const std::vector<Individual> &inds,
+                              const SNP &snp, GenotypeTable<T> &table)
+    {
+        constexpr size_t BITS = sizeof(T) * 8; // Number of bits in T
+        const size_t cw = table.cases_words, tw = table.ctrls_words;
+
+        // Buffers
+        T cases_buff[3] = {0, 0, 0}, ctrls_buff[3] = {0, 0, 0};
+        // Populate bit table with the snp information
+        size_t cases_cnt = 0;
+        size_t ctrls_cnt = 0;
+        for (size_t j = 0; j < inds.size(); j++) {
+            // For each individual, check phenotype class
+            if (inds[j].ph == 1) { // If it's a control append genotype to
+                // the 3 control buffers
+                for (auto k = 0; k < 3; k++) {
+                    ctrls_buff[k] =
+                        (ctrls_buff[k] << 1) + (snp.genotypes[j] == k);
                 }
+                ctrls_cnt++;
                 // If the buffer is full, write buffer into the bit table and
                 // clear the buffer
-                if (cases_cnt % BITS == 0) {
-                    const int offset = cases_cnt / BITS - 1;
-                    for (auto k = 0; k < 3; k++) {
-                        table.cases[k * cases_words + offset] = cases_buff[k];
-                        cases_buff[k] = 0;
-                    }
-                }
-                // Do the same for controls
                 if (ctrls_cnt % BITS == 0) {
-                    const int offset = ctrls_cnt / BITS - 1;
+                    const size_t offset = ctrls_cnt / BITS - 1;
                     for (auto k = 0; k < 3; k++) {
-                        table.ctrls[k * ctrls_words + offset] = ctrls_buff[k];
+                        table.ctrls[k * tw + offset] = ctrls_buff[k];
                         ctrls_buff[k] = 0;
                     }
                 }
-            }
-            // If the number of controls is not divisible by the bits in T
-            if (ctrls_cnt % BITS != 0) {
-                // Write last (incomplete) word from each row of the table
-                const int offset = ctrls_cnt / BITS;
+            } else { // Else append genotype to the 3 cases buffers
                 for (auto k = 0; k < 3; k++) {
-                    table.ctrls[k * ctrls_words + offset] = ctrls_buff[k];
+                    cases_buff[k] =
+                        (cases_buff[k] << 1) + (snp.genotypes[j] == k);
                 }
-            }
-            // Repeat for cases
-            if (cases_cnt % BITS != 0) {
-                const int offset = cases_cnt / BITS;
-                for (auto k = 0; k < 3; k++) {
-                    table.cases[k * cases_words + offset] = cases_buff[k];
+                cases_cnt++;
+                // Do the same for cases
+                if (cases_cnt % BITS == 0) {
+                    const size_t offset = cases_cnt / BITS - 1;
+                    for (auto k = 0; k < 3; k++) {
+                        table.cases[k * cw + offset] = cases_buff[k];
+                        cases_buff[k] = 0;
+                    }
                 }
             }
-            // Write 0 in the remaining uninitialized words of the controls
-            // array
-            for (auto i = (ctrls_cnt + BITS - 1) / BITS; i < ctrls_words; i++) {
-                for (auto k = 0; k < 3; k++) {
-                    table.ctrls[k * ctrls_words + i] = 0;
-                }
+        }
+        // If the number of controls is not divisible by the bits in T
+        if (ctrls_cnt % BITS != 0) {
+            // Write last (incomplete) word from each row of the table
+            const int offset = ctrls_cnt / BITS;
+            for (auto k = 0; k < 3; k++) {
+                table.ctrls[k * tw + offset] = ctrls_buff[k];
             }
-            // Repeat for cases
-            for (auto i = (cases_cnt + BITS - 1) / BITS; i < cases_words; i++) {
-                for (auto k = 0; k < 3; k++) {
-                    table.cases[k * cases_words + i] = 0;
-                }
+        }
+        // Repeat for cases
+        if (cases_cnt % BITS != 0) {
+            const int offset = cases_cnt / BITS;
+            for (auto k = 0; k < 3; k++) {
+                table.cases[k * cw + offset] = cases_buff[k];
+            }
+        }
+        // Write 0 in the remaining uninitialized words of the controls
+        // array
+        for (auto i = (ctrls_cnt + BITS - 1) / BITS; i < tw; i++) {
+            for (auto k = 0; k < 3; k++) {
+                table.ctrls[k * tw + i] = 0;
+            }
+        }
+        // Repeat for cases
+        for (auto i = (cases_cnt + BITS - 1) / BITS; i < cw; i++) {
+            for (auto k = 0; k < 3; k++) {
+                table.cases[k * cw + i] = 0;
             }
         }
     }
 
-    std::unique_ptr<T[]> alloc;
+    std::shared_ptr<void> storage;
+    T *buffer;
+    size_t buffer_size;
+    std::vector<Replica> replicas;
+    // Declared after the storage, so that the background read is joined
+    // before the tables are released
+    std::shared_ptr<Loader> loader;
 };
 
 #endif
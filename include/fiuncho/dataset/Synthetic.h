@@ -0,0 +1,407 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Synthetic.h
+ * @author Christian Ponte
+ * @brief Declares and implements the Synthetic class
+ */
+
+#ifndef FIUNCHO_SYNTHETIC_H
+#define FIUNCHO_SYNTHETIC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fiuncho/dataset/Dataset.h>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Penetrance models of an interaction between SNPs, which give the
+ * probability of an individual being a case from its genotypes at the SNPs of
+ * the interaction. Each model has a baseline penetrance \f$ b \f$, and an
+ * effect \f$ e \f$ that multiplies it for the genotypes at risk.
+ */
+
+enum class InteractionModel {
+    /** No association: \f$ b \f$ for all genotypes */
+    None,
+    /** \f$ b (1 + e) \f$ if the number of minor alleles carried at the SNPs
+       of the interaction is odd, \f$ b \f$ otherwise. SNPs have no marginal
+       effect for a minor allele frequency of 0.5 */
+    XOR,
+    /** \f$ b (1 + e) \f$ if at least one minor allele is carried at every
+       SNP of the interaction, \f$ b \f$ otherwise */
+    Threshold,
+    /** \f$ b (1 + e)^m \f$, where \f$ m \f$ is the number of minor
+       alleles carried at the SNPs of the interaction */
+    Multiplicative
+};
+
+/**
+ * @class Synthetic
+ * @brief Description of a synthetic data set of unrelated individuals. The
+ * minor allele frequency of each SNP is drawn uniformly from a range, and its
+ * genotypes follow the Hardy-Weinberg equilibrium for that frequency. There
+ * is no association between genotypes and phenotype, except for the SNPs of
+ * an interaction planted with Synthetic::plant.
+ *
+ * Each SNP is generated from its own random number generator, seeded with the
+ * seed of the data set and the index of the SNP, so that any SNP can be
+ * generated independently of the rest, and the same seed produces the same
+ * data set on any platform. The genotypes of the SNPs of the interaction are
+ * drawn together, for each individual, from their distribution conditioned
+ * on the phenotype of the individual.
+ */
+
+class Synthetic
+{
+  public:
+    /** Number of SNPs */
+    const size_t snps;
+    /** Number of individuals in the case group */
+    const size_t cases;
+    /** Number of individuals in the control group */
+    const size_t ctrls;
+    /** Smallest minor allele frequency of a SNP */
+    const double maf_min;
+    /** Largest minor allele frequency of a SNP */
+    const double maf_max;
+    /** Seed of the random number generators */
+    const uint64_t seed;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Describe a synthetic data set.
+     *
+     * @param snps Number of SNPs
+     * @param cases Number of individuals in the case group
+     * @param ctrls Number of individuals in the control group
+     * @param maf_min Smallest minor allele frequency of a SNP, in [0, 0.5]
+     * @param maf_max Largest minor allele frequency of a SNP, in [maf_min,
+     * 0.5]
+     * @param seed Seed of the random number generators
+     */
+
+    Synthetic(const size_t snps, const size_t cases, const size_t ctrls,
+              const double maf_min = 0.05, const double maf_max = 0.5,
+              const uint64_t seed = 0)
+        : snps(snps), cases(cases), ctrls(ctrls), maf_min(maf_min),
+          maf_max(maf_max), seed(seed), model(InteractionModel::None),
+          baseline(0), effect(0)
+    {
+        if (!(maf_min >= 0 && maf_min <= maf_max && maf_max <= 0.5)) {
+            throw std::runtime_error("The minor allele frequencies must "
+                                     "satisfy 0 <= minimum <= maximum <= 0.5");
+        }
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Plant an interaction between SNPs, replacing the previous one, if any.
+     *
+     * @param model Penetrance model of the interaction
+     * @param snps Indices of the SNPs of the interaction, without repetitions
+     * @param baseline Baseline penetrance of the model, in [0, 1]
+     * @param effect Effect of the genotypes at risk on the penetrance, which
+     * is capped at 1
+     */
+
+    void plant(const InteractionModel model, const std::vector<size_t> &snps,
+               const double baseline, const double effect)
+    {
+        if (snps.empty() || snps.size() > 10) {
+            throw std::runtime_error(
+                "An interaction has between 1 and 10 SNPs");
+        }
+        for (size_t i = 0; i < snps.size(); i++) {
+            if (snps[i] >= this->snps ||
+                std::count(snps.begin(), snps.end(), snps[i]) > 1) {
+                throw std::runtime_error(
+                    "The SNPs of an interaction must be different SNPs of "
+                    "the data set");
+            }
+        }
+        if (!(baseline >= 0 && baseline <= 1 && effect >= 0)) {
+            throw std::runtime_error("The baseline penetrance must be in "
+                                     "[0, 1] and the effect non-negative");
+        }
+        this->model = model;
+        this->baseline = baseline;
+        this->effect = effect;
+        interaction = snps;
+        // Cumulative distribution of the genotypes of the interaction, for
+        // cases and controls. Genotypes are numbered in base 3, with the
+        // first SNP in the least significant digit
+        size_t cells = 1;
+        for (size_t i = 0; i < snps.size(); i++) {
+            cells *= 3;
+        }
+        cases_cdf.assign(cells, 0);
+        ctrls_cdf.assign(cells, 0);
+        std::vector<double> p(snps.size());
+        for (size_t i = 0; i < snps.size(); i++) {
+            p[i] = maf(snps[i]);
+        }
+        std::vector<uint8_t> g(snps.size());
+        double cases_total = 0, ctrls_total = 0;
+        for (size_t c = 0; c < cells; c++) {
+            double frequency = 1;
+            for (size_t i = 0, x = c; i < snps.size(); i++, x /= 3) {
+                g[i] = x % 3;
+                frequency *= g[i] == 0   ? (1 - p[i]) * (1 - p[i])
+                             : g[i] == 1 ? 2 * p[i] * (1 - p[i])
+                                         : p[i] * p[i];
+            }
+            const double f = penetrance(g);
+            cases_total += frequency * f;
+            ctrls_total += frequency * (1 - f);
+            cases_cdf[c] = cases_total;
+            ctrls_cdf[c] = ctrls_total;
+        }
+        if ((cases > 0 && cases_total <= 0) ||
+            (ctrls > 0 && ctrls_total <= 0)) {
+            this->model = InteractionModel::None;
+            interaction.clear();
+            throw std::runtime_error(
+                "The penetrance model does not produce both cases and "
+                "controls");
+        }
+        for (size_t c = 0; c < cells; c++) {
+            cases_cdf[c] /= cases_total;
+            ctrls_cdf[c] /= ctrls_total;
+        }
+    }
+
+    /**
+     * Indices of the SNPs of the planted interaction, if any.
+     */
+
+    const std::vector<size_t> &planted() const { return interaction; }
+
+    /**
+     * Probability of an individual being a case according to the model of
+     * the planted interaction.
+     *
+     * @param genotypes Genotypes of the individual at each SNP of the
+     * interaction
+     */
+
+    double penetrance(const std::vector<uint8_t> &genotypes) const
+    {
+        unsigned int alleles = 0, carriers = 0;
+        for (const auto g : genotypes) {
+            alleles += g;
+            carriers += g > 0;
+        }
+        double f = baseline;
+        switch (model) {
+        case InteractionModel::XOR:
+            f *= alleles % 2 ? 1 + effect : 1;
+            break;
+        case InteractionModel::Threshold:
+            f *= carriers == genotypes.size() ? 1 + effect : 1;
+            break;
+        case InteractionModel::Multiplicative:
+            for (unsigned int a = 0; a < alleles; a++) {
+                f *= 1 + effect;
+            }
+            break;
+        default:
+            break;
+        }
+        return std::min(f, 1.0);
+    }
+
+    /**
+     * Minor allele frequency of a SNP.
+     *
+     * @param snp Index of the SNP
+     */
+
+    double maf(const size_t snp) const
+    {
+        auto rng = generator(snp);
+        return maf(rng);
+    }
+
+    /**
+     * Generate the genotypes of a SNP.
+     *
+     * @param snp Index of the SNP
+     * @param genotypes Vector where the genotype (0, 1 or 2) of every case
+     * followed by every control is stored
+     */
+
+    void genotypes(const size_t snp, std::vector<uint8_t> &genotypes) const
+    {
+        genotypes.resize(cases + ctrls);
+        const auto it = std::find(interaction.begin(), interaction.end(), snp);
+        if (it != interaction.end()) {
+            // Draw the genotypes of the whole interaction again, and keep the
+            // digit of this SNP
+            size_t digit = 1;
+            for (auto i = interaction.begin(); i != it; ++i) {
+                digit *= 3;
+            }
+            auto rng = generator(std::numeric_limits<size_t>::max());
+            for (size_t j = 0; j < genotypes.size(); j++) {
+                const auto &cdf = j < cases ? cases_cdf : ctrls_cdf;
+                const size_t c =
+                    std::upper_bound(cdf.begin(), cdf.end() - 1,
+                                     uniform(rng)) -
+                    cdf.begin();
+                genotypes[j] = c / digit % 3;
+            }
+            return;
+        }
+        auto rng = generator(snp);
+        const double p = maf(rng);
+        for (auto &g : genotypes) {
+            g = (uniform(rng) < p) + (uniform(rng) < p);
+        }
+    }
+
+    /**
+     * Generate the whole data set in memory, with the same layout used by
+     * Dataset::read.
+     *
+     * @param placement Memory placement policy of the tables
+     * @tparam T data type used to represent the individual information in the
+     * GenotypeTable's
+     * @tparam N number of bytes to align the underlying arrays to
+     * @return A Dataset object
+     */
+
+    template <class T, size_t N = sizeof(T)>
+    Dataset<T>
+    dataset(const DatasetPlacement placement = DatasetPlacement::Default) const
+    {
+        return Dataset<T>::template generate<N>(
+            cases, ctrls, snps,
+            [this](const size_t snp, std::vector<uint8_t> &g) {
+                genotypes(snp, g);
+            },
+            placement);
+    }
+
+    /**
+     * Write the data set to a pair of tped and tfam files, generating the SNPs
+     * in blocks so that the memory used does not depend on the number of
+     * SNPs. Cases are written before controls, and the alleles of each SNP are
+     * A for the major allele and C for the minor one.
+     *
+     * @param tped Path to the tped output file
+     * @param tfam Path to the tfam output file
+     * @param threads Number of threads generating the SNPs
+     */
+
+    void write(const std::string &tped, const std::string &tfam,
+               const unsigned int threads = 1) const
+    {
+        std::ofstream fam(tfam, std::ios::out);
+        for (size_t j = 0; j < cases + ctrls; j++) {
+            fam << "FAM" << j << " IND" << j << " 0 0 0 "
+                << (j < cases ? 2 : 1) << '\n';
+        }
+        fam.close();
+        if (!fam) {
+            throw std::runtime_error("Error writing file " + tfam);
+        }
+        std::ofstream ped(tped, std::ios::out);
+        static const char *calls[3] = {" A A", " A C", " C C"};
+        const size_t block = std::max(1u, threads) * 4;
+        std::vector<std::string> lines(block);
+        for (size_t first = 0; first < snps; first += block) {
+            const size_t count = std::min(block, snps - first);
+            // Each thread formats the lines of a strided subset of the block
+            const auto format = [&](const size_t id, const size_t stride) {
+                std::vector<uint8_t> g;
+                for (size_t i = id; i < count; i += stride) {
+                    genotypes(first + i, g);
+                    auto &line = lines[i];
+                    line = "1 rs" + std::to_string(first + i) + " 0 " +
+                           std::to_string(first + i + 1);
+                    line.reserve(line.size() + 4 * g.size() + 1);
+                    for (const auto x : g) {
+                        line.append(calls[x], 4);
+                    }
+                    line += '\n';
+                }
+            };
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < threads && t < count; t++) {
+                pool.emplace_back(format, t, std::min<size_t>(threads, count));
+            }
+            format(0, std::min<size_t>(std::max(1u, threads), count));
+            for (auto &t : pool) {
+                t.join();
+            }
+            for (size_t i = 0; i < count; i++) {
+                ped.write(lines[i].data(), lines[i].size());
+            }
+        }
+        ped.close();
+        if (!ped) {
+            throw std::runtime_error("Error writing file " + tped);
+        }
+    }
+
+    //@}
+
+  private:
+    InteractionModel model;
+    double baseline, effect;
+    std::vector<size_t> interaction;
+    // Cumulative distribution of the genotypes of the interaction
+    std::vector<double> cases_cdf, ctrls_cdf;
+
+    std::mt19937_64 generator(const size_t snp) const
+    {
+        std::seed_seq sequence{(uint32_t)seed, (uint32_t)(seed >> 32),
+                               (uint32_t)snp, (uint32_t)((uint64_t)snp >> 32)};
+        return std::mt19937_64(sequence);
+    }
+
+    double maf(std::mt19937_64 &rng) const
+    {
+        return maf_min + (maf_max - maf_min) * uniform(rng);
+    }
+
+    // Uniform value in [0, 1), computed the same way by every standard library
+    static double uniform(std::mt19937_64 &rng)
+    {
+        return (rng() >> 11) * (1.0 / (UINT64_C(1) << 53));
+    }
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Affinity.h
+ * @author Christian Ponte
+ *
+ * @brief Helper functions to query the CPU and NUMA topology of the system
+ * through sysfs, and to pin threads to a set of CPUs.
+ */
+
+#ifndef FIUNCHO_AFFINITY_H
+#define FIUNCHO_AFFINITY_H
+
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Parse a CPU list in the format used by sysfs and taskset, e.g. `0-3,8,10-11`.
+ *
+ * @param list String containing the CPU list
+ * @return Vector with the CPU ids, in the same order as they appear in the list
+ */
+
+inline std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    size_t prev = 0;
+    while (prev < list.size()) {
+        size_t pos = list.find(',', prev);
+        if (pos == std::string::npos) {
+            pos = list.size();
+        }
+        const std::string item = list.substr(prev, pos - prev);
+        const size_t dash = item.find('-');
+        try {
+            size_t end;
+            if (dash == std::string::npos) {
+                cpus.push_back(std::stoi(item, &end));
+                if (end != item.size()) {
+                    throw std::invalid_argument(item);
+                }
+            } else {
+                const int first = std::stoi(item.substr(0, dash), &end);
+                if (end != dash) {
+                    throw std::invalid_argument(item);
+                }
+                const int last = std::stoi(item.substr(dash + 1), &end);
+                if (end != item.size() - dash - 1 || last < first) {
+                    throw std::invalid_argument(item);
+                }
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } catch (const std::logic_error &) {
+            throw std::runtime_error("Invalid CPU list '" + list + "'");
+        }
+        prev = pos + 1;
+    }
+    for (const auto cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            throw std::runtime_error("Invalid CPU id " + std::to_string(cpu) +
+                                     " in CPU list '" + list + "'");
+        }
+    }
+    return cpus;
+}
+
+/**
+ * List the CPUs that the calling process is allowed to run on.
+ *
+ * @return Vector with the CPU ids in ascending order
+ */
+
+inline std::vector<int> available_cpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpuset)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+/**
+ * Ids of the NUMA nodes present in the system, in increasing order. Node ids
+ * are not necessarily contiguous. Systems without NUMA support are reported as
+ * having a single node 0.
+ *
+ * @return Vector with the NUMA node ids
+ */
+
+inline std::vector<int> numa_nodes()
+{
+    std::vector<int> nodes;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            const std::string name(entry->d_name);
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+                std::isdigit(name[4])) {
+                nodes.push_back(std::stoi(name.substr(4)));
+            }
+        }
+        closedir(dir);
+    }
+    if (nodes.empty()) {
+        nodes.push_back(0);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+/**
+ * NUMA node to which a CPU belongs.
+ *
+ * @param cpu CPU id
+ * @return The NUMA node of the CPU, or 0 if it cannot be determined
+ */
+
+inline int numa_node_of_cpu(const int cpu)
+{
+    int node = 0;
+    const std::string path =
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if (dir != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            const std::string name(entry->d_name);
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+                std::isdigit(name[4])) {
+                node = std::stoi(name.substr(4));
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return node;
+}
+
+/**
+ * CPUs that belong to a NUMA node.
+ *
+ * @param node NUMA node id
+ * @return Vector with the CPU ids of the node, empty if the node does not exist
+ */
+
+inline std::vector<int> numa_node_cpus(const int node)
+{
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!file.is_open() || !std::getline(file, list) || list.empty()) {
+        return std::vector<int>();
+    }
+    return parse_cpu_list(list);
+}
+
+/**
+ * SMT siblings of a CPU, i.e. the hardware threads that share its core.
+ *
+ * @param cpu CPU id
+ * @return Vector with the CPU ids of the core, including \a cpu itself
+ */
+
+inline std::vector<int> smt_siblings(const int cpu)
+{
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/topology/thread_siblings_list");
+    std::string list;
+    if (!file.is_open() || !std::getline(file, list) || list.empty()) {
+        return std::vector<int>(1, cpu);
+    }
+    return parse_cpu_list(list);
+}
+
+/**
+ * Reorder a CPU list so that SMT siblings appear next to each other. Each CPU
+ * is followed by its siblings that are also in the list, keeping the order in
+ * which the cores first appear.
+ *
+ * @param cpus CPU ids
+ * @return Vector with the same CPU ids, grouped by core
+ */
+
+inline std::vector<int> group_smt_siblings(const std::vector<int> &cpus)
+{
+    std::vector<int> grouped;
+    grouped.reserve(cpus.size());
+    std::vector<bool> used(cpus.size(), false);
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (used[i]) {
+            continue;
+        }
+        used[i] = true;
+        grouped.push_back(cpus[i]);
+        const auto siblings = smt_siblings(cpus[i]);
+        for (size_t j = i + 1; j < cpus.size(); ++j) {
+            if (!used[j] && std::find(siblings.begin(), siblings.end(),
+                                      cpus[j]) != siblings.end()) {
+                used[j] = true;
+                grouped.push_back(cpus[j]);
+            }
+        }
+    }
+    return grouped;
+}
+
+/**
+ * Restrict the calling thread to run on a set of CPUs.
+ *
+ * @param cpus CPU ids the thread is allowed to run on
+ * @return 0 on success, or the error number returned by
+ * `pthread_setaffinity_np`
+ */
+
+inline int pin_thread(const std::vector<int> &cpus)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (const auto cpu : cpus) {
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
+
+#endif
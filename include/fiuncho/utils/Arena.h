@@ -0,0 +1,187 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Arena.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_ARENA_H
+#define FIUNCHO_ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @class Arena
+ * @brief Bump allocator over a single memory mapping. All the allocations
+ * served by an Arena are placed contiguously in memory and aligned to
+ * Arena::alignment bytes, so that a block of tables can be allocated with a
+ * single system call instead of one heap allocation per table.
+ *
+ * The mapping is backed by huge pages when possible, and its pages are touched
+ * by the constructor. Constructing the Arena from the thread that is going to
+ * use it places the memory in the NUMA node of that thread.
+ */
+
+class Arena
+{
+  public:
+#ifdef ALIGN
+    static constexpr size_t alignment = ALIGN;
+#else
+    static constexpr size_t alignment = alignof(std::max_align_t);
+#endif
+
+    Arena(const Arena &) = delete;
+    Arena(Arena &&other) noexcept
+        : base(other.base), length(other.length), offset(other.offset)
+    {
+        other.base = nullptr;
+        other.length = 0;
+        other.offset = 0;
+    }
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a new Arena able to serve up to \a capacity bytes. When \a
+     * huge_pages is true, the mapping is first requested with `MAP_HUGETLB`,
+     * falling back to transparent huge pages through `madvise` if no huge pages
+     * are reserved in the system.
+     *
+     * @param capacity Number of bytes available in the arena
+     * @param huge_pages Request huge pages for the mapping
+     */
+
+    explicit Arena(const size_t capacity, const bool huge_pages = true)
+        : base(nullptr), length(0), offset(0)
+    {
+        if (capacity == 0) {
+            return;
+        }
+        constexpr size_t HUGE_PAGE = 2 << 20;
+        if (huge_pages && capacity >= HUGE_PAGE) {
+            length = (capacity + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+            void *ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                base = (char *)ptr;
+            }
+        }
+        if (base == nullptr) {
+            const size_t page = sysconf(_SC_PAGESIZE);
+            length = (capacity + page - 1) / page * page;
+            void *ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            base = (char *)ptr;
+#ifdef MADV_HUGEPAGE
+            if (huge_pages && length >= HUGE_PAGE) {
+                madvise(base, length, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        // First touch from the calling thread
+        memset(base, 0, length);
+    }
+
+    //@}
+
+    ~Arena()
+    {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+    }
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Number of bytes that an allocation of \a count values of type \a T takes
+     * from the arena, including the padding required to keep the following
+     * allocation aligned.
+     *
+     * @param count Number of values of type \a T
+     * @tparam T Data type of the allocation
+     * @return The number of bytes used from the arena
+     */
+
+    template <class T> static constexpr size_t footprint(const size_t count)
+    {
+        return (count * sizeof(T) + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * Allocate \a count values of type \a T from the arena. The memory returned
+     * remains valid until the Arena is cleared or destroyed, and it is
+     * zero-initialized unless the arena has been cleared before.
+     *
+     * @param count Number of values of type \a T
+     * @tparam T Data type of the allocation
+     * @return Pointer to the first value of the allocation
+     */
+
+    template <class T> T *allocate(const size_t count)
+    {
+        const size_t bytes = footprint<T>(count);
+        if (offset + bytes > length) {
+            throw std::bad_alloc();
+        }
+        T *ptr = (T *)(base + offset);
+        offset += bytes;
+        return ptr;
+    }
+
+    /**
+     * Release all allocations at once, keeping the mapping for reuse.
+     */
+
+    void clear() noexcept { offset = 0; }
+
+    /**
+     * Number of bytes already allocated from the arena.
+     */
+
+    size_t size() const { return offset; }
+
+    /**
+     * Number of bytes mapped by the arena.
+     */
+
+    size_t capacity() const { return length; }
+
+    //@}
+
+  private:
+    char *base;
+    size_t length;
+    size_t offset;
+};
+
+#endif
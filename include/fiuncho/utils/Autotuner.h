@@ -0,0 +1,384 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Autotuner.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_AUTOTUNER_H
+#define FIUNCHO_AUTOTUNER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fiuncho/ContingencyTable.h>
+#include <fiuncho/GenotypeTable.h>
+#include <fiuncho/algorithms/MutualInformation.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/MaxArray.h>
+#include <fiuncho/utils/Result.h>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @class Autotuner
+ * @brief Selects the number of contingency tables that the threads of a
+ * ThreadedSearch fill before computing their MI, for the host and the data set
+ * in use. Each candidate size is timed on the first SNPs of the data set for a
+ * fraction of a second, and the fastest one is used. The sizes selected can be
+ * stored in a cache file, keyed by the CPU model, the instruction set of the
+ * implementation, the order and the number of words of the cases and
+ * controls, so that later executions on the same kind of host and data set
+ * skip the measurements.
+ */
+
+class Autotuner
+{
+    // Sizes already selected by this object, by key
+    std::map<std::string, int> tuned;
+
+  public:
+    /**
+     * Largest number of SNPs of the data set used during the measurements
+     */
+    static constexpr size_t SAMPLE = 1024;
+
+    /** Whether the block size is measured or the default one is used */
+    const bool enabled;
+    /** Path to the cache file, or empty if no cache is used */
+    const std::string cache;
+    /** Seconds spent measuring all the candidates */
+    const double budget;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create an Autotuner object.
+     *
+     * @param enabled If false, Autotuner::block_size always returns the
+     * default size of the order, without measuring nor reading the cache
+     * @param cache Path to the file where the sizes selected are stored and
+     * looked up. If empty, the sizes are measured on every execution
+     * @param budget Seconds spent measuring the candidates for each order and
+     * data set
+     */
+
+    Autotuner(const bool enabled = false, const std::string &cache = "",
+              const double budget = 0.25)
+        : enabled(enabled), cache(cache), budget(budget)
+    {
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Number of contingency tables per block used when no measurements are
+     * available.
+     *
+     * @param order Order of the search
+     * @return The default block size
+     */
+
+    static int default_block_size(const unsigned short order)
+    {
+        return std::max((int)(16384 / powf(3, order - 2)), 1);
+    }
+
+    /**
+     * Block sizes measured for an order: from a sixteenth to twice the default
+     * block size, in powers of two.
+     *
+     * @param order Order of the search
+     * @return Candidate block sizes, in increasing order
+     */
+
+    static std::vector<int> candidates(const unsigned short order)
+    {
+        const int size = default_block_size(order);
+        std::vector<int> sizes;
+        for (int shift = 4; shift >= 0; --shift) {
+            if ((size >> shift) > 0 &&
+                (sizes.empty() || sizes.back() != size >> shift)) {
+                sizes.push_back(size >> shift);
+            }
+        }
+        sizes.push_back(size * 2);
+        return sizes;
+    }
+
+    /**
+     * Model name of the CPU of the host, as reported by the operating system.
+     *
+     * @return The model name, or "unknown" if it is not available
+     */
+
+    static std::string cpu_model()
+    {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.compare(0, 10, "model name") == 0) {
+                const auto pos = line.find(':');
+                if (pos != std::string::npos) {
+                    const auto first = line.find_first_not_of(" \t", pos + 1);
+                    if (first != std::string::npos) {
+                        return line.substr(first);
+                    }
+                }
+            }
+        }
+        return "unknown";
+    }
+
+    /**
+     * Key of the block size of a search in the cache file.
+     *
+     * @param order Order of the search
+     * @param cases_words Number of words of each table of cases
+     * @param ctrls_words Number of words of each table of controls
+     * @return Tab-separated CPU model, instruction set, order, and words of
+     * the cases and controls
+     */
+
+    static std::string key(const unsigned short order, const size_t cases_words,
+                           const size_t ctrls_words)
+    {
+#ifdef FIUNCHO_ISA
+        const std::string isa = FIUNCHO_ISA;
+#else
+        const std::string isa = "unknown";
+#endif
+        return cpu_model() + '\t' + isa + '\t' + std::to_string(order) + '\t' +
+               std::to_string(cases_words) + '\t' + std::to_string(ctrls_words);
+    }
+
+    /**
+     * Look up a block size in a cache file.
+     *
+     * @param path Path to the cache file
+     * @param key Key of the block size
+     * @return The block size stored, or 0 if the file or the key do not exist
+     */
+
+    static int lookup(const std::string &path, const std::string &key)
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            const auto pos = line.rfind('\t');
+            if (pos == key.size() && line.compare(0, pos, key) == 0) {
+                try {
+                    return std::max(std::stoi(line.substr(pos + 1)), 0);
+                } catch (const std::logic_error &) {
+                    return 0;
+                }
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Store a block size in a cache file, replacing the previous size of the
+     * same key. The file is replaced atomically, so that concurrent processes
+     * never read a partial file.
+     *
+     * @param path Path to the cache file
+     * @param key Key of the block size
+     * @param block_size Block size
+     */
+
+    static void store(const std::string &path, const std::string &key,
+                      const int block_size)
+    {
+        std::vector<std::string> lines;
+        {
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line)) {
+                const auto pos = line.rfind('\t');
+                if (!(pos == key.size() && line.compare(0, pos, key) == 0)) {
+                    lines.push_back(line);
+                }
+            }
+        }
+        lines.push_back(key + '\t' + std::to_string(block_size));
+        const std::string tmp = path + ".tmp" + std::to_string(getpid());
+        std::ofstream file(tmp);
+        for (const auto &line : lines) {
+            file << line << '\n';
+        }
+        file.close();
+        if (!file || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Error writing the autotuning cache " +
+                                     path);
+        }
+    }
+
+    /**
+     * Measure the number of combinations per second evaluated by a thread
+     * using a given block size. The thread fills and scores blocks of
+     * contingency tables for the combinations of the first
+     * Autotuner::SAMPLE SNPs of the data set, in the same order as a search.
+     *
+     * @param dataset Dataset from which the SNPs are read
+     * @param order Order of the search
+     * @param block_size Number of contingency tables per block
+     * @param seconds Minimum duration of the measurement. At least one block
+     * is filled and scored
+     * @return Combinations evaluated per second
+     */
+
+    static double throughput(const Dataset<uint64_t> &dataset,
+                             const unsigned short order, const int block_size,
+                             const double seconds)
+    {
+        const size_t snps = dataset.snps < SAMPLE ? dataset.snps : SAMPLE;
+        if (snps < order) {
+            throw std::runtime_error(
+                "The data set contains fewer SNPs than the order of the "
+                "search");
+        }
+        dataset.wait(snps);
+        const size_t cases_words = dataset[0].cases_words,
+                     ctrls_words = dataset[0].ctrls_words;
+        std::vector<GenotypeTable<uint64_t>> gts;
+        gts.reserve(order - 2);
+        for (auto o = 2; o < order; ++o) {
+            gts.emplace_back(o, cases_words, ctrls_words);
+        }
+        std::vector<ContingencyTable<uint32_t>> cts;
+        cts.reserve(block_size);
+        for (auto i = 0; i < block_size; ++i) {
+            cts.emplace_back(order, cases_words, ctrls_words);
+        }
+        std::vector<Result<int, float>> r(block_size);
+        for (auto &result : r) {
+            result.combination.resize(order);
+        }
+        MutualInformation<float> mi(dataset.cases, dataset.ctrls);
+        MaxArray<Result<int, float>> maxarray(1);
+        // Combinations of consecutive SNPs starting at first, followed by SNP
+        // i
+        size_t first = 0, i = order - 1, combinations = 0;
+        const auto combine = [&]() {
+            if (order > 2) {
+                GenotypeTable<uint64_t>::combine(dataset[first],
+                                                 dataset[first + 1], gts[0]);
+                for (auto o = 1; o < order - 2; ++o) {
+                    GenotypeTable<uint64_t>::combine(
+                        gts[o - 1], dataset[first + o + 1], gts[o]);
+                }
+            }
+        };
+        const auto start = std::chrono::steady_clock::now();
+        double elapsed;
+        combine();
+        do {
+            for (auto j = 0; j < block_size; ++j, ++i) {
+                if (i == snps) {
+                    first = (first + 1) % (snps - order + 1);
+                    i = first + order - 1;
+                    combine();
+                }
+                r[j].combination[0] = first;
+                r[j].combination.back() = i;
+                GenotypeTable<uint64_t>::combine_and_popcnt(
+                    order > 2 ? gts.back() : dataset[first], dataset[i],
+                    cts[j]);
+            }
+            for (auto j = 0; j < block_size; ++j) {
+                r[j].val = mi.compute(cts[j]);
+            }
+            for (auto j = 0; j < block_size; ++j) {
+                maxarray.add(r[j]);
+            }
+            combinations += block_size;
+            elapsed = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+        } while (elapsed < seconds);
+        return combinations / std::max(elapsed, 1e-9);
+    }
+
+    /**
+     * Number of contingency tables per block to use in a search. If the
+     * Autotuner is enabled, the size is read from the cache file or, if not
+     * found, the candidate sizes are measured in turns during
+     * Autotuner::budget seconds, and the fastest one is selected and stored in
+     * the cache file. The size is kept by the object, so that later calls for
+     * the same order and data set shape return immediately.
+     *
+     * @param dataset Dataset from which the SNPs are read
+     * @param order Order of the search
+     * @return The number of contingency tables per block
+     */
+
+    int block_size(const Dataset<uint64_t> &dataset, const unsigned short order)
+    {
+        if (!enabled || dataset.snps < order) {
+            return default_block_size(order);
+        }
+        const auto k =
+            key(order, dataset[0].cases_words, dataset[0].ctrls_words);
+        auto it = tuned.find(k);
+        if (it != tuned.end()) {
+            return it->second;
+        }
+        int best = cache.empty() ? 0 : lookup(cache, k);
+        if (best == 0) {
+            // Alternate between the candidates so that all of them are
+            // equally affected by the warm up of the caches and the frequency
+            // changes of the CPU, and keep the best measurement of each one
+            constexpr int rounds = 3;
+            const auto sizes = candidates(order);
+            const double slice = budget / (rounds * sizes.size());
+            std::vector<double> speed(sizes.size(), 0);
+            for (auto round = 0; round < rounds; ++round) {
+                for (size_t s = 0; s < sizes.size(); ++s) {
+                    speed[s] = std::max(
+                        speed[s], throughput(dataset, order, sizes[s], slice));
+                }
+            }
+            best = sizes[std::max_element(speed.begin(), speed.end()) -
+                         speed.begin()];
+            if (!cache.empty()) {
+                store(cache, k, best);
+            }
+        }
+        tuned[k] = best;
+        return best;
+    }
+
+    //@}
+};
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Estimate.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_ESTIMATE_H
+#define FIUNCHO_ESTIMATE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fiuncho/ContingencyTable.h>
+#include <fiuncho/GenotypeTable.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Arena.h>
+#include <fiuncho/utils/Result.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @class Estimate
+ * @brief Prediction of the resources needed by a search, written as a JSON
+ * document. The program measures the costs of a single process on the host
+ * where it runs: the time spent reading the data set, the combinations
+ * evaluated per second by one thread and the time spent merging results. The
+ * Estimate extrapolates them to a job of Estimate::ranks processes with
+ * Estimate::threads threads each, assuming that every thread runs on its own
+ * core, that the combinations are evenly split among the threads, and that
+ * the results are gathered through a reduction tree over a network of
+ * Estimate::latency seconds and Estimate::bandwidth bytes per second.
+ */
+
+class Estimate
+{
+  public:
+    /** Version of the program */
+    std::string version;
+    /** Instruction set of the implementation */
+    std::string isa;
+    /** Order of the combinations */
+    unsigned int order;
+    /** Number of results requested */
+    unsigned int outputs;
+    /** Number of processes of the job */
+    unsigned int ranks;
+    /** Number of threads of each process */
+    unsigned int threads;
+    /** Whether the data set is read by the first process and broadcast */
+    bool broadcast;
+    /** Number of SNPs of the data set */
+    size_t snps;
+    /** Number of cases of the data set */
+    size_t cases;
+    /** Number of controls of the data set */
+    size_t ctrls;
+    /** 64-bit words per genotype of a SNP, for the cases */
+    size_t cases_words;
+    /** 64-bit words per genotype of a SNP, for the controls */
+    size_t ctrls_words;
+    /** Bytes taken by the data set in memory */
+    uint64_t dataset_bytes;
+    /** Total number of combinations of the search */
+    uint64_t combinations;
+    /** Number of contingency tables per block of each thread */
+    int block_size;
+    /** Seconds spent reading the data set, measured */
+    double load;
+    /** Peak resident set size after reading the data set, in bytes */
+    uint64_t load_rss;
+    /** Seconds spent selecting the block size before the search */
+    double tuning;
+    /** Combinations evaluated per second by one thread, measured */
+    double rate;
+    /** Seconds spent merging the results of the threads of a process,
+       measured */
+    double merge;
+    /** Seconds spent merging two blocks of results during the reduction,
+       measured */
+    double pair_merge;
+    /** Latency of a message between processes, in seconds */
+    double latency;
+    /** Bandwidth between processes, in bytes per second */
+    double bandwidth;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create an empty Estimate object, for a single process and thread and
+     * a network with a latency of 5 microseconds and 1 GB/s of bandwidth.
+     */
+
+    Estimate()
+        : order(0), outputs(0), ranks(1), threads(1), broadcast(false),
+          snps(0), cases(0), ctrls(0), cases_words(0), ctrls_words(0),
+          dataset_bytes(0), combinations(0), block_size(0), load(0),
+          load_rss(0), tuning(0), rate(0), merge(0), pair_merge(0),
+          latency(5e-6), bandwidth(1e9)
+    {
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Fill in the dimensions of the data set.
+     */
+
+    void dataset(const Dataset<uint64_t> &dataset)
+    {
+        snps = dataset.snps;
+        cases = dataset.cases;
+        ctrls = dataset.ctrls;
+        cases_words = dataset.snps > 0 ? dataset[0].cases_words : 0;
+        ctrls_words = dataset.snps > 0 ? dataset[0].ctrls_words : 0;
+        dataset_bytes = dataset.raw_size() * sizeof(uint64_t);
+    }
+
+    /**
+     * Number of messages sent in sequence by the reduction tree that gathers
+     * the results, or that broadcasts the data set.
+     */
+
+    unsigned int steps() const
+    {
+        return ranks > 1 ? (unsigned int)std::ceil(std::log2(ranks)) : 0;
+    }
+
+    /**
+     * Predicted seconds spent by each process reading the data set.
+     */
+
+    double load_time() const
+    {
+        return load +
+               steps() * (broadcast ? latency + dataset_bytes / bandwidth : 0);
+    }
+
+    /**
+     * Combinations evaluated by the thread with the largest share of the
+     * search.
+     */
+
+    uint64_t per_thread() const
+    {
+        const uint64_t workers =
+            std::max<uint64_t>((uint64_t)ranks * threads, 1);
+        return combinations / workers + (combinations % workers != 0);
+    }
+
+    /**
+     * Predicted seconds spent by the slowest thread searching.
+     */
+
+    double compute_time() const { return rate > 0 ? per_thread() / rate : 0; }
+
+    /**
+     * Predicted seconds spent gathering the results of all threads and
+     * processes in the first process.
+     */
+
+    double gather_time() const
+    {
+        const double message =
+            (double)outputs * (order * sizeof(int) + sizeof(float));
+        return merge + steps() * (latency + message / bandwidth + pair_merge);
+    }
+
+    /**
+     * Predicted seconds elapsed from the start to the end of the execution.
+     */
+
+    double total_time() const
+    {
+        return load_time() + tuning + compute_time() + gather_time();
+    }
+
+    /**
+     * Predicted bytes of memory used by each process: the resident memory
+     * measured after reading the data set, plus the buffers of its threads.
+     */
+
+    uint64_t memory() const
+    {
+        const size_t ct = Arena::footprint<uint32_t>(
+            ContingencyTable<uint32_t>::required_size(order));
+        uint64_t scratch = (uint64_t)block_size * (ct + sizeof(float) +
+                                                   order * sizeof(int));
+        for (unsigned int o = 2; o < order; ++o) {
+            scratch += Arena::footprint<uint64_t>(
+                GenotypeTable<uint64_t>::required_size(o, cases_words,
+                                                       ctrls_words));
+        }
+        return load_rss + threads * scratch;
+    }
+
+    /**
+     * Format the estimate as a JSON document.
+     */
+
+    std::string json() const
+    {
+        std::ostringstream os;
+        os << "{\n  \"version\": \"" << version << "\",\n  \"isa\": \"" << isa
+           << "\",\n  \"order\": " << order << ",\n  \"outputs\": " << outputs
+           << ",\n  \"ranks\": " << ranks << ",\n  \"threads\": " << threads
+           << ",\n  \"broadcast\": " << (broadcast ? "true" : "false")
+           << ",\n  \"dataset\": {\"snps\": " << snps
+           << ", \"cases\": " << cases << ", \"ctrls\": " << ctrls
+           << ", \"cases_words\": " << cases_words
+           << ", \"ctrls_words\": " << ctrls_words
+           << ", \"bytes\": " << dataset_bytes
+           << "},\n  \"combinations\": " << combinations
+           << ",\n  \"combinations_per_thread\": " << per_thread()
+           << ",\n  \"block_size\": " << block_size
+           << ",\n  \"measured\": {\"load_time\": " << load
+           << ", \"load_rss\": " << load_rss
+           << ", \"combinations_per_second_per_thread\": " << rate
+           << ", \"merge_time\": " << merge
+           << ", \"pair_merge_time\": " << pair_merge
+           << "},\n  \"network\": {\"latency\": " << latency
+           << ", \"bandwidth\": " << bandwidth
+           << "},\n  \"predicted\": {\"load_time\": " << load_time()
+           << ", \"tuning_time\": " << tuning
+           << ", \"compute_time\": " << compute_time()
+           << ", \"gather_time\": " << gather_time()
+           << ", \"total_time\": " << total_time()
+           << ", \"memory_per_rank\": " << memory() << "}\n}\n";
+        return os.str();
+    }
+
+    /**
+     * Write the estimate to a file, as a JSON document.
+     */
+
+    void write(const std::string &path) const
+    {
+        std::ofstream file(path, std::ios::out);
+        file << json();
+        if (!file) {
+            throw std::runtime_error("Error writing file " + path);
+        }
+    }
+
+    /**
+     * Measure the seconds spent sorting \a count results of order \a order and
+     * keeping the best \a outputs, as done when merging the results of several
+     * threads or processes.
+     *
+     * @param count Number of results merged
+     * @param outputs Number of results kept
+     * @param order Order of the combinations
+     * @return The shortest time of several repetitions, in seconds
+     */
+
+    static double merge_time(const size_t count, const size_t outputs,
+                             const unsigned int order)
+    {
+        std::vector<Result<int, float>> results(count);
+        double best = std::numeric_limits<double>::max();
+        for (auto repetition = 0; repetition < 5; ++repetition) {
+            // Pseudo-random values, so that the sort is not trivial
+            uint32_t state = 2463534242u + repetition;
+            for (auto &r : results) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                r.combination.assign(order, (int)(state % 1024));
+                r.val = state * 2.3283064e-10f;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            std::sort(results.rbegin(), results.rend());
+            if (results.size() > outputs) {
+                results.resize(outputs);
+            }
+            best = std::min(best, std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+            results.resize(count);
+        }
+        return best;
+    }
+
+    //@}
+};
+
+#endif
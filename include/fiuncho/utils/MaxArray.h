@@ -70,6 +70,10 @@ template <typename T> class MaxArray
     }
 
     size_t size() const { return current_size; }
+
+    bool full() const { return current_size == maxsize; }
+
+    const T &min() const { return *min_pos; }
 };
 
 #endif
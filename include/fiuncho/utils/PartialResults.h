@@ -0,0 +1,234 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file PartialResults.h
+ * @author Christian Ponte
+ *
+ * @brief Binary files with the results of one part of a search that has been
+ * split into independent jobs, and the k-way merge of several of these files
+ * into the final results.
+ */
+
+#ifndef FIUNCHO_PARTIALRESULTS_H
+#define FIUNCHO_PARTIALRESULTS_H
+
+#include <cstdint>
+#include <cstring>
+#include <fiuncho/utils/Result.h>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @class PartialResults
+ * @brief Binary file containing the results of the *part*-th out of *parts*
+ * ranges of a search. The file starts with a header identifying the part and
+ * the order of the search, followed by the results in descending order of
+ * their value, serialized with `Result::serialize`.
+ */
+
+class PartialResults
+{
+  public:
+    /**
+     * @name Attributes
+     */
+    //@{
+
+    //! Index of the part, starting from 0
+    uint64_t part;
+    //! Number of parts in which the search was split
+    uint64_t parts;
+    //! Order of the combinations
+    uint64_t order;
+    //! Number of results stored in the file
+    uint64_t count;
+
+    //@}
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Open a partial results file for reading. Results are read one at a time
+     * with `next`, without loading the whole file into memory.
+     *
+     * @param path Path to the file
+     */
+
+    PartialResults(const std::string &path) : file(path, std::ios::binary)
+    {
+        char m[magic_size];
+        uint64_t header[4];
+        file.read(m, magic_size);
+        file.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!file || std::memcmp(m, magic(), magic_size) != 0) {
+            throw std::runtime_error("File " + path +
+                                     " is not a partial results file");
+        }
+        part = header[0];
+        parts = header[1];
+        order = header[2];
+        count = header[3];
+        this->path = path;
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Read the next result of the file.
+     *
+     * @param r Result where the contents are stored
+     * @return False if all results have already been read
+     */
+
+    bool next(Result<int, float> &r)
+    {
+        if (read == count) {
+            return false;
+        }
+        Result<int, float>::deserialize(file, r);
+        if (!file || r.combination.size() != order) {
+            throw std::runtime_error("File " + path + " is truncated");
+        }
+        ++read;
+        return true;
+    }
+
+    /**
+     * Write the results of a part of the search to a partial results file.
+     *
+     * @param path Path to the file
+     * @param part Index of the part, starting from 0
+     * @param parts Number of parts in which the search was split
+     * @param order Order of the combinations
+     * @param results Results of the part, in descending order
+     */
+
+    static void write(const std::string &path, const uint64_t part,
+                      const uint64_t parts, const uint64_t order,
+                      const std::vector<Result<int, float>> &results)
+    {
+        std::ofstream of(path, std::ios::out | std::ios::binary);
+        const uint64_t header[4] = {part, parts, order, results.size()};
+        of.write(magic(), magic_size);
+        of.write(reinterpret_cast<const char *>(header), sizeof(header));
+        for (const auto &r : results) {
+            Result<int, float>::serialize(of, r);
+        }
+        of.close();
+        if (!of) {
+            throw std::runtime_error("Error writing file " + path);
+        }
+    }
+
+    /**
+     * Merge the results of all parts of a search. The files are read in
+     * parallel, keeping a single result per file in memory. All parts must be
+     * present exactly once.
+     *
+     * @param paths Paths to the partial results files
+     * @param outputs Maximum number of results to return
+     * @return Vector with the results, in descending order
+     */
+
+    static std::vector<Result<int, float>>
+    merge(const std::vector<std::string> &paths, const unsigned int outputs)
+    {
+        std::vector<PartialResults> files;
+        files.reserve(paths.size());
+        for (const auto &path : paths) {
+            files.emplace_back(path);
+        }
+        check_parts(files);
+        // Heap with the next result of each file
+        typedef std::pair<Result<int, float>, size_t> Entry;
+        auto compare = [](const Entry &a, const Entry &b) {
+            return a.first < b.first;
+        };
+        std::priority_queue<Entry, std::vector<Entry>, decltype(compare)> heap(
+            compare);
+        for (size_t i = 0; i < files.size(); ++i) {
+            Result<int, float> r;
+            if (files[i].next(r)) {
+                heap.emplace(std::move(r), i);
+            }
+        }
+        std::vector<Result<int, float>> results;
+        while (results.size() < outputs && !heap.empty()) {
+            Entry e = heap.top();
+            heap.pop();
+            results.push_back(e.first);
+            if (files[e.second].next(e.first)) {
+                heap.push(std::move(e));
+            }
+        }
+        return results;
+    }
+
+    //@}
+
+  private:
+    // Identifier at the beginning of the file
+    static constexpr size_t magic_size = 8;
+    static const char *magic() { return "FIUNCHOP"; }
+
+    // Check that the files contain each part of the same search exactly once
+    static void check_parts(const std::vector<PartialResults> &files)
+    {
+        if (files.empty()) {
+            throw std::runtime_error("No partial results files to merge");
+        }
+        const uint64_t parts = files[0].parts, order = files[0].order;
+        std::vector<bool> found(parts, false);
+        for (const auto &f : files) {
+            if (f.parts != parts || f.order != order || f.part >= parts) {
+                throw std::runtime_error("File " + f.path +
+                                         " belongs to a different search");
+            }
+            if (found[f.part]) {
+                throw std::runtime_error("Part " + std::to_string(f.part + 1) +
+                                         "/" + std::to_string(parts) +
+                                         " is repeated");
+            }
+            found[f.part] = true;
+        }
+        for (uint64_t i = 0; i < parts; ++i) {
+            if (!found[i]) {
+                throw std::runtime_error("Part " + std::to_string(i + 1) + "/" +
+                                         std::to_string(parts) +
+                                         " is missing");
+            }
+        }
+    }
+
+    std::string path;
+    std::ifstream file;
+    uint64_t read = 0;
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file PerfCounters.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_PERFCOUNTERS_H
+#define FIUNCHO_PERFCOUNTERS_H
+
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @class PerfCounters
+ * @brief Hardware performance counters of the calling thread, read through
+ * the perf_event_open system call. The counters are opened as a single group
+ * when the object is created, and count the user-space events of the thread
+ * that created it until the object is destroyed.
+ *
+ * Events that the kernel or the CPU do not support, or that the user is not
+ * allowed to count (see `/proc/sys/kernel/perf_event_paranoid`), are left out
+ * of the group and read as NaN, so that the program runs as usual without
+ * them.
+ */
+
+class PerfCounters
+{
+  public:
+    /**
+     * Number of events counted: cycles, instructions, L1 data cache misses,
+     * last level cache misses and data TLB misses.
+     */
+
+    static constexpr int events = 5;
+
+    /**
+     * Count of each event, scaled to the time the counters were enabled if the
+     * kernel multiplexed them with other events, or NaN if unavailable.
+     */
+
+    typedef std::array<double, events> Values;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Open the counters of the calling thread. It does not throw if some or
+     * all of them cannot be opened.
+     */
+
+    PerfCounters() : leader(-1), opened(0)
+    {
+        static const uint32_t types[events] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+        static const uint64_t configs[events] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            cache(PERF_COUNT_HW_CACHE_L1D), cache(PERF_COUNT_HW_CACHE_LL),
+            cache(PERF_COUNT_HW_CACHE_DTLB)};
+        for (int e = 0; e < events; ++e) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[e];
+            attr.config = configs[e];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            const int fd =
+                syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd == -1) {
+                // Keep the reason why the first event failed
+                if (message.empty()) {
+                    message = std::string(name(e)) + ": " +
+                              std::strerror(errno);
+                }
+                fds[e] = -1;
+                index[e] = -1;
+                continue;
+            }
+            if (leader == -1) {
+                leader = fd;
+            }
+            fds[e] = fd;
+            index[e] = opened++;
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+
+    ~PerfCounters()
+    {
+        for (const auto fd : fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Check whether any of the counters could be opened.
+     */
+
+    bool available() const { return opened > 0; }
+
+    /**
+     * Reason why the first event that could not be opened failed, or an empty
+     * string if all events were opened.
+     */
+
+    const std::string &error() const { return message; }
+
+    /**
+     * Read the current value of all counters with a single system call.
+     */
+
+    Values read() const
+    {
+        Values values;
+        values.fill(std::numeric_limits<double>::quiet_NaN());
+        // Number of events, time enabled, time running and the values
+        uint64_t buffer[3 + events];
+        if (opened == 0 || ::read(leader, buffer, sizeof(buffer)) <
+                               (ssize_t)((3 + opened) * sizeof(uint64_t))) {
+            return values;
+        }
+        // The group may not have been scheduled yet
+        if (buffer[2] == 0) {
+            for (int e = 0; e < events; ++e) {
+                values[e] = index[e] == -1 ? values[e] : 0;
+            }
+            return values;
+        }
+        const double scale = (double)buffer[1] / buffer[2];
+        for (int e = 0; e < events; ++e) {
+            if (index[e] != -1) {
+                values[e] = buffer[3 + index[e]] * scale;
+            }
+        }
+        return values;
+    }
+
+    //@}
+
+    /**
+     * Difference between two readings of the counters.
+     */
+
+    static Values delta(const Values &from, const Values &to)
+    {
+        Values values;
+        for (int e = 0; e < events; ++e) {
+            values[e] = to[e] - from[e];
+        }
+        return values;
+    }
+
+    /**
+     * Name of the i-th event.
+     */
+
+    static const char *name(const int i)
+    {
+        static const char *names[events] = {"cycles", "instructions",
+                                            "L1D misses", "LLC misses",
+                                            "DTLB misses"};
+        return names[i];
+    }
+
+    /**
+     * Format the instructions per cycle, and the count of each event per unit
+     * of work.
+     *
+     * @param values Counts of the events
+     * @param n Units of work done while counting, such as combinations
+     * @param unit Name of the unit of work
+     */
+
+    static std::string str(const Values &values, const double n,
+                           const std::string &unit)
+    {
+        std::ostringstream os;
+        os.precision(3);
+        if (!std::isnan(values[0]) && !std::isnan(values[1])) {
+            os << "IPC " << (values[0] > 0 ? values[1] / values[0] : 0)
+               << ", ";
+        }
+        os << "per " << unit << ':';
+        bool any = false;
+        for (int e = 0; e < events; ++e) {
+            if (!std::isnan(values[e])) {
+                os << (any ? ", " : " ") << (n > 0 ? values[e] / n : 0) << ' '
+                   << name(e);
+                any = true;
+            }
+        }
+        if (!any) {
+            return "hardware counters not available";
+        }
+        return os.str();
+    }
+
+  private:
+    int fds[events], index[events];
+    int leader, opened;
+    std::string message;
+
+    // Configuration of the read misses of a cache
+    static constexpr uint64_t cache(const uint64_t id)
+    {
+        return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+};
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file PhaseTimer.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_PHASETIMER_H
+#define FIUNCHO_PHASETIMER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef PERF_COUNTERS
+#include <fiuncho/utils/PerfCounters.h>
+#endif
+
+/**
+ * Phases of the search of a thread.
+ */
+
+enum class Phase {
+    /** Combining the genotype tables of the first SNPs of the combinations */
+    Combine,
+    /** Filling contingency tables with GenotypeTable::combine_and_popcnt */
+    Popcount,
+    /** Computing the MutualInformation of the contingency tables */
+    MI,
+    /** Inserting the results in the MaxArray of the thread */
+    TopK,
+    /** Waiting for SNPs being read, or for the other threads of a pipeline */
+    Wait
+};
+
+/**
+ * @class PhaseTimer
+ * @brief Breakdown of the time spent by a thread in each Phase of the search.
+ * The thread calls PhaseTimer::lap at the end of each phase, which adds the
+ * time elapsed since the previous lap to that phase, reading the time stamp
+ * counter of the CPU where available.
+ *
+ * Timers are only enabled in BENCHMARK builds. Otherwise, all methods are
+ * empty and the calls are removed by the compiler. Builds that also define
+ * PERF_COUNTERS read the PerfCounters of the thread at each lap, and add the
+ * hardware events counted since the previous lap to the phase as well.
+ */
+
+class PhaseTimer
+{
+  public:
+    /**
+     * Number of phases.
+     */
+
+    static constexpr int phases = 5;
+
+    /**
+     * Number of values measured by a timer: the seconds spent in each phase,
+     * the number of combinations evaluated and, with PERF_COUNTERS, the count
+     * of each hardware event in each phase.
+     */
+
+#ifdef PERF_COUNTERS
+    static constexpr int fields = phases + 1 + phases * PerfCounters::events;
+#else
+    static constexpr int fields = phases + 1;
+#endif
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Start the timer, discarding the time of previous laps. It must be called
+     * from the thread being measured.
+     */
+
+    void start()
+    {
+#ifdef BENCHMARK
+        for (auto &c : cycles) {
+            c = 0;
+        }
+#ifdef PERF_COUNTERS
+        counters.reset(new PerfCounters());
+        if (!counters->available()) {
+            static std::once_flag warned;
+            std::call_once(warned, [this]() {
+                std::cerr << "Hardware counters not available ("
+                          << counters->error() << ")\n";
+            });
+        }
+        for (auto &c : counts) {
+            c.fill(0);
+        }
+        last_counts = counters->read();
+#endif
+        first_time = std::chrono::steady_clock::now();
+        first = last = ticks();
+#endif
+    }
+
+    /**
+     * Add the time elapsed since the previous lap to a phase.
+     */
+
+    void lap(const Phase phase)
+    {
+#ifdef BENCHMARK
+        const uint64_t now = ticks();
+        cycles[static_cast<int>(phase)] += now - last;
+        last = now;
+#ifdef PERF_COUNTERS
+        const auto values = counters->read();
+        auto &c = counts[static_cast<int>(phase)];
+        for (int e = 0; e < PerfCounters::events; ++e) {
+            c[e] += values[e] - last_counts[e];
+        }
+        last_counts = values;
+#endif
+#else
+        (void)phase;
+#endif
+    }
+
+    /**
+     * Stop the timer, and add its values to the totals of the process.
+     *
+     * @param combinations Number of combinations evaluated by the thread
+     * @return Vector with the PhaseTimer::fields values of the timer
+     */
+
+    std::vector<double> stop(const uint64_t combinations = 0)
+    {
+        std::vector<double> seconds(fields, 0);
+#ifdef BENCHMARK
+        // Ticks are converted to seconds with the rate measured by this timer
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - first_time;
+        const uint64_t total = ticks() - first;
+        for (int p = 0; p < phases; ++p) {
+            seconds[p] = total > 0 ? cycles[p] * elapsed.count() / total : 0;
+        }
+        seconds[phases] = combinations;
+#ifdef PERF_COUNTERS
+        for (int p = 0; p < phases; ++p) {
+            std::copy(counts[p].begin(), counts[p].end(),
+                      seconds.begin() + phases + 1 + p * PerfCounters::events);
+        }
+        counters.reset();
+#endif
+        std::lock_guard<std::mutex> lock(mutex());
+        for (int f = 0; f < fields; ++f) {
+            totals()[f] += seconds[f];
+        }
+#else
+        (void)combinations;
+#endif
+        return seconds;
+    }
+
+    //@}
+
+    /**
+     * Values of all the timers of this process since the beginning of the
+     * execution.
+     */
+
+    static std::vector<double> &totals()
+    {
+        static std::vector<double> values(fields, 0);
+        return values;
+    }
+
+    /**
+     * Name of the i-th phase.
+     */
+
+    static const char *name(const int i)
+    {
+        static const char *names[phases] = {"combine", "popcount", "mi",
+                                            "topk", "wait"};
+        return names[i];
+    }
+
+    /**
+     * Format the seconds spent in each phase and their share of the total and,
+     * with PERF_COUNTERS, the instructions per cycle of each phase and the
+     * count of each event per combination.
+     *
+     * @param values Vector with the PhaseTimer::fields values of a timer
+     */
+
+    static std::string str(const std::vector<double> &values)
+    {
+        double total = 0;
+        for (int p = 0; p < phases; ++p) {
+            total += values[p];
+        }
+        std::ostringstream os;
+        for (int p = 0; p < phases; ++p) {
+            os << (p > 0 ? ", " : "") << name(p) << ' ' << values[p] << "s ("
+               << (total > 0 ? 100 * values[p] / total : 0) << "%";
+#ifdef PERF_COUNTERS
+            const double *c = &values[phases + 1 + p * PerfCounters::events];
+            if (c[0] > 0 && !std::isnan(c[1])) {
+                os << ", IPC " << c[1] / c[0];
+            }
+#endif
+            os << ')';
+        }
+#ifdef PERF_COUNTERS
+        PerfCounters::Values sum;
+        sum.fill(0);
+        for (int p = 0; p < phases; ++p) {
+            for (int e = 0; e < PerfCounters::events; ++e) {
+                sum[e] += values[phases + 1 + p * PerfCounters::events + e];
+            }
+        }
+        os << "; " << PerfCounters::str(sum, values[phases], "combination");
+#endif
+        return os.str();
+    }
+
+  private:
+#ifdef BENCHMARK
+    uint64_t cycles[phases];
+    uint64_t first, last;
+    std::chrono::steady_clock::time_point first_time;
+#ifdef PERF_COUNTERS
+    std::unique_ptr<PerfCounters> counters;
+    PerfCounters::Values counts[phases], last_counts;
+#endif
+
+    static std::mutex &mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,411 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Progress.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_PROGRESS_H
+#define FIUNCHO_PROGRESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fiuncho/utils/MaxArray.h>
+#include <fiuncho/utils/Result.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Progress
+ * @brief Monitor of the progress of a search. While a Progress object exists,
+ * the threads of the searches count the combinations they evaluate in their
+ * own Progress::Counter, and a monitor thread samples all counters
+ * periodically to report the number of combinations evaluated per second, the
+ * percentage of the search completed, the estimated time left and the lowest
+ * value among the best results found so far.
+ *
+ * Counters are only updated once per block of combinations, with relaxed
+ * atomic operations on a cache line owned by the thread, so monitoring does
+ * not slow down the search.
+ */
+
+class Progress
+{
+    // Counter of a single thread, in its own cache line
+    struct Slot {
+        alignas(64) std::atomic<uint64_t> combinations;
+        std::atomic<float> threshold;
+        // Guarded by the mutex of the Progress object
+        bool used;
+    };
+
+  public:
+    /**
+     * State of the search at some point in time.
+     */
+
+    struct Sample {
+        /** Combinations evaluated since the Progress object was created */
+        uint64_t combinations;
+        /** Lower bound of the lowest value among the best results, or minus
+           infinity if not enough results have been found yet */
+        float threshold;
+        /** Number of processes still running the search */
+        uint64_t running;
+    };
+
+    /**
+     * Function that combines the Sample of this process with those of the
+     * rest of processes running the search, replacing it with the result.
+     * It is called by the monitor thread of every process at the same time.
+     */
+
+    typedef std::function<void(Sample &)> Reduce;
+
+    /**
+     * @class Counter
+     * @brief Counter of the combinations evaluated by a thread of a search.
+     * Counters created while there is no Progress object do nothing.
+     */
+
+    class Counter
+    {
+        Progress *const progress;
+        Slot *slot;
+
+      public:
+        Counter(const Counter &) = delete;
+
+        Counter(Counter &&other) : progress(other.progress), slot(other.slot)
+        {
+            other.slot = nullptr;
+        }
+
+        Counter()
+            : progress(active()),
+              slot(progress == nullptr ? nullptr : progress->acquire())
+        {
+        }
+
+        ~Counter()
+        {
+            if (slot != nullptr) {
+                progress->release(slot);
+            }
+        }
+
+        /**
+         * Add \a n combinations to the counter. Only the thread that owns the
+         * counter may call this method.
+         */
+
+        void add(const uint64_t n)
+        {
+            if (slot != nullptr) {
+                slot->combinations.store(
+                    slot->combinations.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Publish the lowest value among the results kept by the thread, once
+         * the thread has found as many results as requested.
+         */
+
+        void bound(const MaxArray<Result<int, float>> &maxarray)
+        {
+            if (slot != nullptr && maxarray.full() &&
+                maxarray.min().val >
+                    slot->threshold.load(std::memory_order_relaxed)) {
+                slot->threshold.store(maxarray.min().val,
+                                      std::memory_order_relaxed);
+            }
+        }
+    };
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a Progress object and start its monitor thread. Only one Progress
+     * object can exist at a time.
+     *
+     * @param total Number of combinations of the search
+     * @param completed Number of combinations completed before the creation
+     * of this object, such as those of a resumed search
+     * @param interval Number of seconds between two reports
+     * @param path Path to the file where reports are written, one per line as
+     * tab-separated values. If empty, reports are written to the standard
+     * error as text
+     * @param reduce Function used to combine the samples of all processes. If
+     * empty, only the counters of this process are reported
+     * @param report If false, the monitor thread takes part in the reductions
+     * but does not write any report
+     */
+
+    Progress(const uint64_t total, const uint64_t completed,
+             const double interval, const std::string &path = "",
+             const Reduce &reduce = Reduce(), const bool report = true)
+        : total(total), completed(completed), interval(interval), path(path),
+          reduce(reduce), report(report), retired{0, min_threshold(), 0},
+          stopping(false)
+    {
+        if (interval <= 0) {
+            throw std::runtime_error("Progress interval must be positive");
+        }
+        if (active() != nullptr) {
+            throw std::runtime_error("Only one Progress object can exist");
+        }
+        if (report && !path.empty()) {
+            file.open(path, std::ios::out);
+            file << "elapsed\tcombinations\ttotal\tpercent\trate\teta\t"
+                    "threshold"
+                 << std::endl;
+            if (!file) {
+                throw std::runtime_error("Error writing file " + path);
+            }
+        }
+        active() = this;
+        monitor = std::thread(&Progress::run, this);
+    }
+
+    Progress(const Progress &) = delete;
+
+    /**
+     * Stop the monitor thread after a last report. With a Reduce function,
+     * it waits until the Progress objects of all processes are destroyed.
+     */
+
+    ~Progress()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        monitor.join();
+        active() = nullptr;
+    }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Sample the counters of this process.
+     *
+     * @return Sample of this process, with Sample::running set to 1
+     */
+
+    Sample sample()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return local();
+    }
+
+    /**
+     * Format a number of seconds as `[<d>d ]hh:mm:ss`.
+     */
+
+    static std::string duration(const double seconds)
+    {
+        if (!(seconds >= 0) || seconds > 1e12) {
+            return "unknown";
+        }
+        const uint64_t s = seconds + 0.5;
+        char str[32];
+        if (s >= 86400) {
+            snprintf(str, sizeof(str), "%lud %02lu:%02lu:%02lu",
+                     (unsigned long)(s / 86400),
+                     (unsigned long)(s % 86400 / 3600),
+                     (unsigned long)(s % 3600 / 60), (unsigned long)(s % 60));
+        } else {
+            snprintf(str, sizeof(str), "%02lu:%02lu:%02lu",
+                     (unsigned long)(s / 3600), (unsigned long)(s % 3600 / 60),
+                     (unsigned long)(s % 60));
+        }
+        return str;
+    }
+
+    //@}
+
+  private:
+    const uint64_t total, completed;
+    const double interval;
+    const std::string path;
+    const Reduce reduce;
+    const bool report;
+    std::ofstream file;
+    // Slots of all counters, and slots not in use by any counter
+    std::deque<Slot> slots;
+    std::vector<Slot *> free_slots;
+    // Combinations and threshold of the counters already destroyed
+    Sample retired;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping;
+    std::thread monitor;
+
+    static Progress *&active()
+    {
+        static Progress *progress = nullptr;
+        return progress;
+    }
+
+    static float min_threshold()
+    {
+        return -std::numeric_limits<float>::infinity();
+    }
+
+    Slot *acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_slots.empty()) {
+            slots.emplace_back();
+            free_slots.push_back(&slots.back());
+        }
+        Slot *slot = free_slots.back();
+        free_slots.pop_back();
+        slot->combinations.store(0);
+        slot->threshold.store(min_threshold());
+        slot->used = true;
+        return slot;
+    }
+
+    void release(Slot *slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.combinations += slot->combinations.load();
+        retired.threshold = std::max(retired.threshold, slot->threshold.load());
+        slot->used = false;
+        free_slots.push_back(slot);
+    }
+
+    // Add up the counters in use and those already destroyed. The mutex must
+    // be held by the caller
+    Sample local() const
+    {
+        Sample s = retired;
+        for (const auto &slot : slots) {
+            if (slot.used) {
+                s.combinations +=
+                    slot.combinations.load(std::memory_order_relaxed);
+                s.threshold =
+                    std::max(s.threshold,
+                             slot.threshold.load(std::memory_order_relaxed));
+            }
+        }
+        s.running = 1;
+        return s;
+    }
+
+    // Write a report of the combined Sample of all processes
+    void write(const Sample &s, const double elapsed, const double rate)
+    {
+        const uint64_t done = completed + s.combinations;
+        const double percent =
+            total > 0 ? std::min(100.0, 100.0 * done / total) : 100.0;
+        const double eta =
+            s.running == 0
+                ? 0
+                : (total > done ? total - done : 0) /
+                      (s.combinations / std::max(elapsed, 1e-9));
+        // No threshold until some thread keeps as many results as requested
+        const bool bounded = s.threshold != min_threshold();
+        std::ostringstream os;
+        if (file.is_open()) {
+            os << elapsed << '\t' << done << '\t' << total << '\t' << percent
+               << '\t' << rate << '\t' << eta << '\t';
+            if (bounded) {
+                os << s.threshold << '\n';
+            } else {
+                os << "nan\n";
+            }
+            file << os.str() << std::flush;
+        } else {
+            os.precision(3);
+            os << "Progress: " << std::fixed << percent << "% (" << done
+               << " of " << total << " combinations) in " << duration(elapsed)
+               << ", " << std::scientific << rate << " combinations/s, ETA "
+               << duration(eta) << ", threshold ";
+            os.unsetf(std::ios::floatfield);
+            if (bounded) {
+                os << s.threshold << '\n';
+            } else {
+                os << "unknown\n";
+            }
+            std::cerr << os.str() << std::flush;
+        }
+    }
+
+    // Sample the counters every interval, and once more after the search ends
+    void run()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto last = start;
+        uint64_t last_combinations = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            // Once this process stops, the remaining reductions are paced by
+            // the processes still running
+            cv.wait_for(lock, std::chrono::duration<double>(interval),
+                        [this]() { return stopping; });
+            Sample s = local();
+            s.running = stopping ? 0 : 1;
+            lock.unlock();
+            if (reduce) {
+                reduce(s);
+            }
+            const auto now = std::chrono::steady_clock::now();
+            const std::chrono::duration<double> elapsed = now - start,
+                                                since = now - last;
+            if (report) {
+                write(s, elapsed.count(),
+                      (s.combinations - last_combinations) /
+                          std::max(since.count(), 1e-9));
+            }
+            last = now;
+            last_combinations = s.combinations;
+            lock.lock();
+            if (s.running == 0) {
+                break;
+            }
+        }
+    }
+};
+
+#endif
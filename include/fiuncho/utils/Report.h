@@ -0,0 +1,305 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Report.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_REPORT_H
+#define FIUNCHO_REPORT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fiuncho/dataset/Dataset.h>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+/**
+ * @class Report
+ * @brief Summary of an execution, written as a JSON document. While a Report
+ * object exists, the searches add the time spent and the combinations
+ * evaluated by each of their threads to it, and the program fills in the rest
+ * of the fields: the data set, the time spent reading it and searching, and
+ * the processes taking part in the execution.
+ */
+
+class Report
+{
+  public:
+    /**
+     * Work done by a thread, added up over all the searches run.
+     */
+
+    struct Thread {
+        /** Seconds spent searching */
+        double seconds;
+        /** Combinations evaluated */
+        uint64_t combinations;
+    };
+
+    /**
+     * Work done by a process.
+     */
+
+    struct Process {
+        /** Seconds spent reading the data set */
+        double load;
+        /** Seconds spent searching */
+        double compute;
+        /** Peak resident set size, in bytes */
+        uint64_t peak_rss;
+        /** Work done by each thread */
+        std::vector<Thread> threads;
+    };
+
+    /**
+     * @class Suspend
+     * @brief While a Suspend object exists, the work of the threads of the
+     * searches is not added to the active Report, e.g. during measurements
+     * that are not part of the search.
+     */
+
+    class Suspend
+    {
+        Report *const report;
+
+      public:
+        Suspend() : report(active()) { active() = nullptr; }
+
+        Suspend(const Suspend &) = delete;
+
+        ~Suspend() { active() = report; }
+    };
+
+    /** Version of the program */
+    std::string version;
+    /** Search class used by each process */
+    std::string backend;
+    /** Instruction set of the implementation */
+    std::string isa;
+    /** Policy used to distribute the work among processes */
+    std::string scheduling;
+    /** Order of the combinations */
+    unsigned int order;
+    /** Number of results requested */
+    unsigned int outputs;
+    /** Number of SNPs of the data set */
+    size_t snps;
+    /** Number of cases of the data set */
+    size_t cases;
+    /** Number of controls of the data set */
+    size_t ctrls;
+    /** 64-bit words per genotype of a SNP, for the cases */
+    size_t cases_words;
+    /** 64-bit words per genotype of a SNP, for the controls */
+    size_t ctrls_words;
+    /** Processes of the execution. Only the first one, this process, is
+       filled in until the processes are gathered */
+    std::vector<Process> processes;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create an empty Report object, which collects the work of the threads of
+     * the searches until it is destroyed. Only one Report object can exist at
+     * a time.
+     */
+
+    Report()
+        : order(0), outputs(0), snps(0), cases(0), ctrls(0), cases_words(0),
+          ctrls_words(0), processes(1, Process{0, 0, 0, {}}),
+          start(std::chrono::steady_clock::now())
+    {
+        if (active() != nullptr) {
+            throw std::runtime_error("Only one Report object can exist");
+        }
+        active() = this;
+    }
+
+    Report(const Report &) = delete;
+
+    ~Report() { active() = nullptr; }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Work done by this process.
+     */
+
+    Process &local() { return processes[0]; }
+
+    /**
+     * Fill in the dimensions of the data set.
+     */
+
+    template <class T> void dataset(const Dataset<T> &dataset)
+    {
+        snps = dataset.snps;
+        cases = dataset.cases;
+        ctrls = dataset.ctrls;
+        cases_words = dataset.snps > 0 ? dataset[0].cases_words : 0;
+        ctrls_words = dataset.snps > 0 ? dataset[0].ctrls_words : 0;
+    }
+
+    /**
+     * Format the report as a JSON document. The seconds elapsed are measured
+     * since the creation of the object.
+     */
+
+    std::string json() const
+    {
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        double load = 0, compute = 0, slowest = 0, busy = 0;
+        uint64_t peak_rss = 0, combinations = 0, threads = 0;
+        for (const auto &p : processes) {
+            load = std::max(load, p.load);
+            compute = std::max(compute, p.compute);
+            peak_rss = std::max(peak_rss, p.peak_rss);
+            for (const auto &t : p.threads) {
+                slowest = std::max(slowest, t.seconds);
+                busy += t.seconds;
+                combinations += t.combinations;
+                threads++;
+            }
+        }
+        std::ostringstream os;
+        os << "{\n  \"version\": \"" << version << "\",\n  \"backend\": \""
+           << backend << "\",\n  \"isa\": \"" << isa
+           << "\",\n  \"scheduling\": \"" << scheduling
+           << "\",\n  \"order\": " << order << ",\n  \"outputs\": " << outputs
+           << ",\n  \"processes\": " << processes.size()
+           << ",\n  \"threads\": " << threads
+           << ",\n  \"dataset\": {\"snps\": " << snps
+           << ", \"cases\": " << cases << ", \"ctrls\": " << ctrls
+           << ", \"cases_words\": " << cases_words
+           << ", \"ctrls_words\": " << ctrls_words
+           << "},\n  \"elapsed\": " << elapsed.count()
+           << ",\n  \"load_time\": " << load
+           << ",\n  \"compute_time\": " << compute
+           << ",\n  \"combinations\": " << combinations
+           << ",\n  \"combinations_per_second\": "
+           << (compute > 0 ? combinations / compute : 0)
+           << ",\n  \"peak_rss\": " << peak_rss
+           << ",\n  \"imbalance\": "
+           << (busy > 0 ? slowest * threads / busy : 1)
+           << ",\n  \"ranks\": [";
+        for (size_t r = 0; r < processes.size(); ++r) {
+            const auto &p = processes[r];
+            uint64_t n = 0;
+            for (const auto &t : p.threads) {
+                n += t.combinations;
+            }
+            os << (r > 0 ? "," : "") << "\n    {\"rank\": " << r
+               << ", \"load_time\": " << p.load
+               << ", \"compute_time\": " << p.compute
+               << ", \"peak_rss\": " << p.peak_rss
+               << ", \"combinations\": " << n << ", \"threads\": [";
+            for (size_t i = 0; i < p.threads.size(); ++i) {
+                os << (i > 0 ? ", " : "")
+                   << "{\"time\": " << p.threads[i].seconds
+                   << ", \"combinations\": " << p.threads[i].combinations
+                   << '}';
+            }
+            os << "]}";
+        }
+        os << "\n  ]\n}\n";
+        return os.str();
+    }
+
+    /**
+     * Write the report to a file, as a JSON document.
+     */
+
+    void write(const std::string &path) const
+    {
+        std::ofstream file(path, std::ios::out);
+        file << json();
+        if (!file) {
+            throw std::runtime_error("Error writing file " + path);
+        }
+    }
+
+    //@}
+
+    /**
+     * Report being filled in, or nullptr if there is none.
+     */
+
+    static Report *current() { return active(); }
+
+    /**
+     * Add the work done by the thread \a id of a search to the active Report,
+     * if any.
+     */
+
+    static void thread(const unsigned int id, const double seconds,
+                       const uint64_t combinations)
+    {
+        Report *report = active();
+        if (report == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(report->mutex);
+        auto &threads = report->local().threads;
+        if (threads.size() <= id) {
+            threads.resize(id + 1, Thread{0, 0});
+        }
+        threads[id].seconds += seconds;
+        threads[id].combinations += combinations;
+    }
+
+    /**
+     * Peak resident set size of this process, in bytes.
+     */
+
+    static uint64_t peak_rss()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        return (uint64_t)usage.ru_maxrss * 1024;
+    }
+
+  private:
+    const std::chrono::steady_clock::time_point start;
+    std::mutex mutex;
+
+    static Report *&active()
+    {
+        static Report *report = nullptr;
+        return report;
+    }
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file RingBuffer.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_RINGBUFFER_H
+#define FIUNCHO_RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @class RingBuffer
+ * @brief Lock-free single-producer single-consumer ring over an array of slots
+ * owned by the producer. Slots are filled and consumed in place: the producer
+ * writes into the slot returned by RingBuffer::back and publishes it with
+ * RingBuffer::push, while the consumer reads the slot returned by
+ * RingBuffer::front and hands it back with RingBuffer::pop.
+ *
+ * @tparam T Slot type
+ */
+
+template <class T> class RingBuffer
+{
+    T *slots;
+    const size_t capacity;
+    // Producer and consumer indices are kept in separate cache lines. They
+    // are padded a full line apart instead of over-aligned, which plain new
+    // does not honour before C++17
+    static constexpr size_t LINE = 64;
+    char pad0[LINE];
+    std::atomic<size_t> head;
+    char pad1[LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char pad2[LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<bool> closed;
+
+  public:
+    RingBuffer(const RingBuffer &) = delete;
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create an empty RingBuffer of \a capacity slots. The slots must be
+     * attached by the producer with RingBuffer::attach before its first push.
+     *
+     * @param capacity Number of slots of the ring
+     */
+
+    explicit RingBuffer(const size_t capacity)
+        : slots(nullptr), capacity(capacity), head(0), tail(0), closed(false)
+    {
+    }
+
+    //@}
+
+    /**
+     * @name Producer methods
+     */
+    //@{
+
+    /**
+     * Set the array of \a capacity slots used by the ring. The array is
+     * published to the consumer by the following RingBuffer::push.
+     *
+     * @param slots Pointer to the first slot
+     */
+
+    void attach(T *slots) { this->slots = slots; }
+
+    /**
+     * Slot where the next value is to be written.
+     *
+     * @return Pointer to a free slot, or nullptr if the ring is full
+     */
+
+    T *back()
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == capacity) {
+            return nullptr;
+        }
+        return &slots[t % capacity];
+    }
+
+    /**
+     * Publish the slot returned by the last call to RingBuffer::back.
+     */
+
+    void push()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    /**
+     * Signal that no more slots will be pushed.
+     */
+
+    void close() { closed.store(true, std::memory_order_release); }
+
+    //@}
+
+    /**
+     * @name Consumer methods
+     */
+    //@{
+
+    /**
+     * Oldest slot published by the producer.
+     *
+     * @return Pointer to the slot, or nullptr if the ring is empty
+     */
+
+    T *front()
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[h % capacity];
+    }
+
+    /**
+     * Return the slot obtained with RingBuffer::front to the producer.
+     */
+
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    /**
+     * Check if the producer has closed the ring and all its slots have been
+     * consumed.
+     *
+     * @return True if no more slots will be available
+     */
+
+    bool drained() const
+    {
+        return closed.load(std::memory_order_acquire) &&
+               head.load(std::memory_order_relaxed) ==
+                   tail.load(std::memory_order_acquire);
+    }
+
+    //@}
+};
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file Tracer.h
+ * @author Christian Ponte
+ */
+
+#ifndef FIUNCHO_TRACER_H
+#define FIUNCHO_TRACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @class Tracer
+ * @brief Timeline of the execution. While a Tracer object exists, every
+ * Tracer::Scope records the interval during which it was open in a buffer of
+ * the thread that created it, and the timeline can be written in the Chrome
+ * trace event format, which can be inspected with Perfetto or
+ * `chrome://tracing`.
+ *
+ * Each thread only appends events to its own buffer, without any locking.
+ * Buffers have a fixed capacity: once full, a thread keeps its first events and
+ * replaces its oldest later events, so that the timeline shows the beginning
+ * and the end of the execution, and the number of events dropped in between is
+ * written along with them. Without a Tracer object, scopes do nothing besides
+ * checking whether there is one.
+ */
+
+class Tracer
+{
+    struct Event {
+        const char *name;
+        uint64_t begin, end;
+    };
+
+    // Events of a single thread: the first events recorded, followed by a
+    // ring with the last ones once the buffer is full
+    struct Buffer {
+        int thread;
+        size_t capacity, recorded;
+        std::vector<Event> events;
+
+        void record(const Event &e)
+        {
+            if (events.size() < capacity) {
+                events.push_back(e);
+            } else {
+                events[first_kept()] = e;
+            }
+            ++recorded;
+        }
+
+        // Number of events of the ring, after the first ones
+        size_t ring() const { return capacity - capacity / 2; }
+
+        // Position of the oldest event of the ring
+        size_t first_kept() const
+        {
+            return capacity / 2 +
+                   (recorded < capacity ? 0 : (recorded - capacity) % ring());
+        }
+
+        size_t dropped() const
+        {
+            return recorded > capacity ? recorded - capacity : 0;
+        }
+    };
+
+  public:
+    /**
+     * @class Scope
+     * @brief Interval of the execution of a thread, recorded as an event of the
+     * active Tracer, if any.
+     */
+
+    class Scope
+    {
+        Buffer *const buffer;
+        const char *const name;
+        uint64_t first;
+        bool open;
+
+      public:
+        /**
+         * Open the scope.
+         *
+         * @param name Name of the event, which must outlive the Tracer
+         */
+
+        explicit Scope(const char *name)
+            : buffer(local()), name(name), first(buffer ? now() : 0),
+              open(true)
+        {
+        }
+
+        Scope(const Scope &) = delete;
+
+        ~Scope() { end(); }
+
+        /**
+         * Open the scope again, if it was closed.
+         */
+
+        void begin()
+        {
+            if (buffer != nullptr && !open) {
+                first = now();
+                open = true;
+            }
+        }
+
+        /**
+         * Close the scope, and record the interval since it was opened.
+         */
+
+        void end()
+        {
+            if (buffer != nullptr && open) {
+                buffer->record({name, first, now()});
+                open = false;
+            }
+        }
+    };
+
+    /**
+     * @name Constructors
+     */
+    //@{
+
+    /**
+     * Create a Tracer object, which records the events of all threads until
+     * it is destroyed. Only one Tracer object can exist at a time.
+     *
+     * @param capacity Maximum number of events kept by each thread, at least
+     * 2. Half of them are the first events of the thread, and the rest are
+     * its last events
+     */
+
+    explicit Tracer(const size_t capacity = 1 << 16)
+        : id(++count()), origin(now()), capacity(capacity)
+    {
+        if (capacity < 2) {
+            throw std::runtime_error(
+                "Tracer buffers must keep at least 2 events");
+        }
+        if (active() != nullptr) {
+            throw std::runtime_error("Only one Tracer object can exist");
+        }
+        active() = this;
+    }
+
+    Tracer(const Tracer &) = delete;
+
+    ~Tracer() { active() = nullptr; }
+
+    //@}
+
+    /**
+     * @name Methods
+     */
+    //@{
+
+    /**
+     * Time at which the Tracer was created, in nanoseconds of the steady
+     * clock of this process.
+     */
+
+    uint64_t start() const { return origin; }
+
+    /**
+     * Number of events kept so far. No thread may be inside a Scope.
+     */
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = 0;
+        for (const auto &b : buffers) {
+            n += b.events.size();
+        }
+        return n;
+    }
+
+    /**
+     * Number of events dropped so far because the buffer of their thread was
+     * full. No thread may be inside a Scope.
+     */
+
+    size_t dropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = 0;
+        for (const auto &b : buffers) {
+            n += b.dropped();
+        }
+        return n;
+    }
+
+    /**
+     * Write the events kept so far to a stream, as a comma-separated list of
+     * Chrome trace events. The events dropped by each thread are replaced by
+     * a single instant event, with their number as its argument. No thread
+     * may be inside a Scope.
+     *
+     * @param os Output stream
+     * @param process Process id of the events
+     * @param offset Nanoseconds added to the steady clock of this process to
+     * convert it to the reference clock
+     * @param reference Time of the reference clock, in nanoseconds, at which
+     * the timeline starts
+     */
+
+    void json(std::ostream &os, const int process, const int64_t offset,
+              const uint64_t reference) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto flags = os.flags();
+        const auto precision = os.precision(3);
+        os << std::fixed;
+        os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << process
+           << ",\"tid\":0,\"args\":{\"name\":\"process " << process << "\"}}";
+        for (const auto &b : buffers) {
+            os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+               << process << ",\"tid\":" << b.thread
+               << ",\"args\":{\"name\":\"thread " << b.thread << "\"}}";
+            const auto event = [&](const Event &e) {
+                const int64_t ts = (int64_t)(e.begin + offset - reference);
+                os << ",\n{\"name\":\"" << e.name
+                   << "\",\"cat\":\"fiuncho\",\"ph\":\"X\",\"pid\":" << process
+                   << ",\"tid\":" << b.thread << ",\"ts\":" << ts / 1e3
+                   << ",\"dur\":" << (e.end - e.begin) / 1e3 << '}';
+            };
+            if (b.dropped() == 0) {
+                for (const auto &e : b.events) {
+                    event(e);
+                }
+                continue;
+            }
+            const size_t half = b.capacity / 2, oldest = b.first_kept();
+            for (size_t i = 0; i < half; ++i) {
+                event(b.events[i]);
+            }
+            const int64_t ts =
+                (int64_t)(b.events[oldest].begin + offset - reference);
+            os << ",\n{\"name\":\"dropped events\",\"cat\":\"fiuncho\","
+                  "\"ph\":\"i\",\"s\":\"t\",\"pid\":"
+               << process << ",\"tid\":" << b.thread << ",\"ts\":" << ts / 1e3
+               << ",\"args\":{\"count\":" << b.dropped() << "}}";
+            for (size_t i = 0; i < b.ring(); ++i) {
+                event(b.events[half + (oldest - half + i) % b.ring()]);
+            }
+        }
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+    /**
+     * Format the events kept so far as a comma-separated list of Chrome trace
+     * events, as written by Tracer::json to a stream.
+     */
+
+    std::string json(const int process, const int64_t offset,
+                     const uint64_t reference) const
+    {
+        std::ostringstream os;
+        json(os, process, offset, reference);
+        return os.str();
+    }
+
+    /**
+     * Write the events kept so far by this process to a file, as a Chrome
+     * trace. No thread may be inside a Scope.
+     */
+
+    void write(const std::string &path) const
+    {
+        std::ofstream file(path, std::ios::out);
+        prologue(file);
+        json(file, 0, 0, origin);
+        epilogue(file);
+        if (!file) {
+            throw std::runtime_error("Error writing file " + path);
+        }
+    }
+
+    //@}
+
+    /**
+     * Write the beginning of a Chrome trace. It is followed by the events of
+     * one or more processes as written by Tracer::json, separated by
+     * Tracer::separator.
+     */
+
+    static void prologue(std::ostream &os)
+    {
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    }
+
+    /**
+     * Write the separator between the events of two processes in a Chrome
+     * trace.
+     */
+
+    static void separator(std::ostream &os) { os << ",\n"; }
+
+    /**
+     * Write the end of a Chrome trace, after the events of the last process.
+     */
+
+    static void epilogue(std::ostream &os) { os << "\n]}\n"; }
+
+    /**
+     * Current time of the steady clock, in nanoseconds.
+     */
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+  private:
+    const uint64_t id, origin;
+    const size_t capacity;
+    std::deque<Buffer> buffers;
+    mutable std::mutex mutex;
+
+    static Tracer *&active()
+    {
+        static Tracer *tracer = nullptr;
+        return tracer;
+    }
+
+    // Number of Tracer objects created, used to tell them apart
+    static uint64_t &count()
+    {
+        static uint64_t n = 0;
+        return n;
+    }
+
+    // Buffer of the calling thread in the active Tracer, created on its first
+    // event, or nullptr if there is no active Tracer
+    static Buffer *local()
+    {
+        Tracer *tracer = active();
+        if (tracer == nullptr) {
+            return nullptr;
+        }
+        thread_local uint64_t owner = 0;
+        thread_local Buffer *buffer = nullptr;
+        if (owner != tracer->id) {
+            std::lock_guard<std::mutex> lock(tracer->mutex);
+            tracer->buffers.push_back({(int)tracer->buffers.size(),
+                                       tracer->capacity, 0,
+                                       std::vector<Event>()});
+            buffer = &tracer->buffers.back();
+            buffer->events.reserve(std::min<size_t>(tracer->capacity, 1024));
+            owner = tracer->id;
+        }
+        return buffer;
+    }
+};
+
+#endif
@@ -37,3 +37,19 @@ ContingencyTable<uint32_t>::ContingencyTable(const short order,
       ctrls(cases + size)
 {
 }
+
+template <>
+ContingencyTable<uint32_t>::ContingencyTable(const short order,
+                                             const size_t cases_words,
+                                             const size_t ctrls_words,
+                                             uint32_t *ptr)
+    : size((size_t)(std::pow(3, order) + 15) / 16 * 16),
+      cases_words(cases_words), ctrls_words(ctrls_words), alloc(nullptr),
+      cases(ptr), ctrls(cases + size)
+{
+}
+
+template <> size_t ContingencyTable<uint32_t>::required_size(const short order)
+{
+    return ((size_t)(std::pow(3, order) + 15) / 16 * 16) * 2;
+}
@@ -35,3 +35,18 @@ ContingencyTable<uint32_t>::ContingencyTable(const short order,
       cases(alloc.get()), ctrls(cases + size)
 {
 }
+
+template <>
+ContingencyTable<uint32_t>::ContingencyTable(const short order,
+                                             const size_t cases_words,
+                                             const size_t ctrls_words,
+                                             uint32_t *ptr)
+    : size(std::pow(3, order)), cases_words(cases_words),
+      ctrls_words(ctrls_words), alloc(nullptr), cases(ptr), ctrls(cases + size)
+{
+}
+
+template <> size_t ContingencyTable<uint32_t>::required_size(const short order)
+{
+    return (size_t)std::pow(3, order) * 2;
+}
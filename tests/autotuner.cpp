@@ -0,0 +1,132 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/SlicedSearch.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Autotuner.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+#ifdef ALIGN
+constexpr size_t ALIGNMENT = ALIGN;
+#else
+constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
+
+TEST(AutotunerTest, Candidates)
+{
+    // The candidates are increasing and include the default size
+    for (unsigned short o = 2; o < 12; o++) {
+        const auto sizes = Autotuner::candidates(o);
+        EXPECT_TRUE(std::is_sorted(sizes.begin(), sizes.end()));
+        EXPECT_EQ(sizes.end(), std::adjacent_find(sizes.begin(), sizes.end()));
+        EXPECT_GT(sizes[0], 0);
+        EXPECT_NE(sizes.end(), std::find(sizes.begin(), sizes.end(),
+                                         Autotuner::default_block_size(o)));
+    }
+    EXPECT_EQ(16384, Autotuner::default_block_size(2));
+}
+
+TEST(AutotunerTest, Tune)
+{
+    const auto dataset = Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam);
+    // Disabled, the default size is used
+    Autotuner disabled;
+    EXPECT_EQ(Autotuner::default_block_size(3),
+              disabled.block_size(dataset, 3));
+    // Every candidate evaluates combinations
+    for (const auto size : Autotuner::candidates(3)) {
+        EXPECT_GT(Autotuner::throughput(dataset, 3, size, 0), 0);
+    }
+    // Enabled, one of the candidates is selected and stored in the cache
+    char path[] = "/tmp/fiuncho_autotuneXXXXXX";
+    close(mkstemp(path));
+    Autotuner tuner(true, path, 0.05);
+    const int size = tuner.block_size(dataset, 3);
+    const auto sizes = Autotuner::candidates(3);
+    EXPECT_NE(sizes.end(), std::find(sizes.begin(), sizes.end(), size));
+    const auto key = Autotuner::key(3, dataset[0].cases_words,
+                                    dataset[0].ctrls_words);
+    EXPECT_EQ(size, Autotuner::lookup(path, key));
+    EXPECT_EQ(0, Autotuner::lookup(path, key + "0"));
+    // The sizes in the cache are used without measuring them again, and
+    // replace the previous ones
+    Autotuner::store(path, key, 7);
+    Autotuner::store(path, Autotuner::key(2, 1, 1), 5);
+    EXPECT_EQ(7, Autotuner(true, path).block_size(dataset, 3));
+    EXPECT_EQ(5, Autotuner::lookup(path, Autotuner::key(2, 1, 1)));
+    std::ifstream file(path);
+    EXPECT_EQ(2, std::count(std::istreambuf_iterator<char>(file),
+                            std::istreambuf_iterator<char>(), '\n'));
+    remove(path);
+}
+
+TEST(AutotunerTest, Search)
+{
+    // The results do not depend on the block size, including blocks smaller
+    // than the slots of a pipeline
+    const auto dataset = Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam);
+    char path[] = "/tmp/fiuncho_autotuneXXXXXX";
+    close(mkstemp(path));
+    Autotuner::store(path,
+                     Autotuner::key(3, dataset[0].cases_words,
+                                    dataset[0].ctrls_words),
+                     1);
+    Distribution<int> distribution(dataset.snps, 2, 1, 0);
+    for (const unsigned int pipeline : {0, 1}) {
+        ThreadedSearch search(2, {}, false, pipeline, Autotuner(true, path));
+        const auto results = search.run(dataset, 3, distribution, 100);
+        EXPECT_EQ(100, results.size());
+        EXPECT_TRUE(matches_mpi3snp_output(results));
+    }
+    // Including blocks smaller than the number of threads that reduce them
+    SlicedSearch sliced(3, {}, Autotuner(true, path));
+    const auto results = sliced.run(dataset, 3, distribution, 100);
+    EXPECT_EQ(100, results.size());
+    EXPECT_TRUE(matches_mpi3snp_output(results));
+    ThreadedSearch tuned(2, {}, true, 0, Autotuner(true, "", 0.05));
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> d(dataset.snps, o - 1, 1, 0);
+        const auto results = tuned.run(dataset, o, d, 100);
+        EXPECT_FALSE(has_repeated_elements(results));
+        EXPECT_TRUE(ascending_combinations(results));
+        if (o == 3) {
+            EXPECT_TRUE(matches_mpi3snp_output(results));
+        }
+    }
+    remove(path);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
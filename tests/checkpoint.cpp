@@ -0,0 +1,127 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cstdlib>
+#include <fiuncho/Checkpoint.h>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+// Path to a new temporary directory
+std::string temporary_directory()
+{
+    char path[] = "/tmp/fiuncho_ckptXXXXXX";
+    return mkdtemp(path);
+}
+
+void expect_same_values(const std::vector<Result<int, float>> &result,
+                        const std::vector<Result<int, float>> &expected)
+{
+    ASSERT_EQ(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(result[i].val, expected[i].val);
+    }
+    EXPECT_FALSE(has_repeated_elements(result));
+}
+
+TEST(CheckpointTest, Run)
+{
+    // Checkpointed searches find the same results as a regular search
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch search(4);
+    const auto directory = temporary_directory();
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        auto expected = search.run(dataset, o, distribution, 100);
+        Checkpoint progress(directory, 0, dataset.snps, o, 100, 0, 16);
+        progress.clear();
+        EXPECT_FALSE(progress.pending().empty());
+        EXPECT_EQ(0, progress.completed());
+        auto result = progress.run(search, dataset);
+        expect_same_values(result, expected);
+        if (o == 3) {
+            EXPECT_TRUE(matches_mpi3snp_output(result));
+        }
+        EXPECT_TRUE(progress.pending().empty());
+        EXPECT_EQ(Distribution<int>::binomial(dataset.snps, o),
+                  progress.completed());
+        progress.clear();
+    }
+    rmdir(directory.c_str());
+}
+
+TEST(CheckpointTest, Resume)
+{
+    // Interrupt a search run by three processes after two of them complete
+    // their chunks, and resume it with a single process
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch search(2);
+    const auto directory = temporary_directory();
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        auto expected = search.run(dataset, o, distribution, 50);
+        Checkpoint(directory, 0, dataset.snps, o, 50, 0).clear();
+        size_t total = 0;
+        for (int rank = 0; rank < 2; ++rank) {
+            Checkpoint progress(directory, rank, dataset.snps, o, 50, 0, 16);
+            total = progress.pending().size();
+            progress.run(search, dataset, rank, 3);
+        }
+        Checkpoint progress(directory, 0, dataset.snps, o, 50, 0, 16);
+        progress.load(true);
+        EXPECT_EQ(total / 3, progress.pending().size());
+        expect_same_values(progress.run(search, dataset), expected);
+        // A second resume has nothing left to explore
+        Checkpoint finished(directory, 0, dataset.snps, o, 50, 0);
+        finished.load(true);
+        EXPECT_TRUE(finished.pending().empty());
+        expect_same_values(finished.run(search, dataset), expected);
+        // Files of a different search are rejected
+        Checkpoint other(directory, 0, dataset.snps, o + 1, 50, 0);
+        EXPECT_THROW(other.load(true), std::runtime_error);
+        other.clear();
+    }
+    rmdir(directory.c_str());
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
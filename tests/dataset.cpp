@@ -16,9 +16,14 @@
  */
 
 #include <bitset>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fiuncho/dataset/Dataset.h>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <string>
+#include <unistd.h>
 
 std::string tped, tfam;
 
@@ -73,6 +78,261 @@ TEST(DatasetTest, Dataset)
         EXPECT_EQ(dataset.ctrls, count);
     }
 }
+
+TEST(DatasetTest, Create)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    const auto copy = Dataset<uint64_t>::create<N>(
+        dataset.cases, dataset.ctrls, dataset.snps,
+        [&](uint64_t *ptr, size_t count) {
+            ASSERT_EQ(dataset.raw_size(), count);
+            memcpy(ptr, dataset.raw(), count * sizeof(uint64_t));
+        });
+
+    ASSERT_EQ(dataset.snps, copy.snps);
+    EXPECT_EQ(dataset.cases, copy.cases);
+    EXPECT_EQ(dataset.ctrls, copy.ctrls);
+    for (size_t i = 0; i < dataset.snps; i++) {
+        ASSERT_EQ(dataset[i].cases_words, copy[i].cases_words);
+        ASSERT_EQ(dataset[i].ctrls_words, copy[i].ctrls_words);
+        EXPECT_EQ(0, memcmp(dataset[i].cases, copy[i].cases,
+                            3 * dataset[i].cases_words * sizeof(uint64_t)));
+        EXPECT_EQ(0, memcmp(dataset[i].ctrls, copy[i].ctrls,
+                            3 * dataset[i].ctrls_words * sizeof(uint64_t)));
+    }
+}
+
+TEST(DatasetTest, Map)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    // Copy the tables to an external, aligned allocation
+    std::shared_ptr<uint64_t> storage(
+        new uint64_t[dataset.raw_size() + N / sizeof(uint64_t)],
+        std::default_delete<uint64_t[]>());
+    uint64_t *ptr =
+        (uint64_t *)((((uintptr_t)storage.get()) + N - 1) / N * N);
+    memcpy(ptr, dataset.raw(), dataset.raw_size() * sizeof(uint64_t));
+    const auto mapped = Dataset<uint64_t>::map<N>(
+        dataset.cases, dataset.ctrls, dataset.snps, storage, ptr);
+
+    ASSERT_EQ(dataset.snps, mapped.snps);
+    EXPECT_EQ(ptr, mapped.raw());
+    EXPECT_EQ(dataset.raw_size(), mapped.raw_size());
+    for (size_t i = 0; i < dataset.snps; i++) {
+        ASSERT_EQ(dataset[i].cases_words, mapped[i].cases_words);
+        ASSERT_EQ(dataset[i].ctrls_words, mapped[i].ctrls_words);
+        EXPECT_EQ(0, memcmp(dataset[i].cases, mapped[i].cases,
+                            3 * dataset[i].cases_words * sizeof(uint64_t)));
+        EXPECT_EQ(0, memcmp(dataset[i].ctrls, mapped[i].ctrls,
+                            3 * dataset[i].ctrls_words * sizeof(uint64_t)));
+    }
+}
+
+TEST(DatasetTest, ReadInto)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    size_t cases, ctrls;
+    Dataset<uint64_t>::count_individuals(tfam, cases, ctrls);
+    EXPECT_EQ(dataset.cases, cases);
+    EXPECT_EQ(dataset.ctrls, ctrls);
+    const size_t count = Dataset<uint64_t>::raw_count<N>(
+        cases, ctrls, Dataset<uint64_t>::count_snps(tped));
+    ASSERT_EQ(dataset.raw_size(), count);
+    // Read the tables into an external, aligned allocation
+    std::shared_ptr<uint64_t> storage(new uint64_t[count + N / sizeof(uint64_t)],
+                                      std::default_delete<uint64_t[]>());
+    uint64_t *ptr =
+        (uint64_t *)((((uintptr_t)storage.get()) + N - 1) / N * N);
+    Dataset<uint64_t>::read_into<N>(tped, tfam, ptr, count);
+    EXPECT_THROW(Dataset<uint64_t>::read_into<N>(tped, tfam, ptr, count - 1),
+                 std::runtime_error);
+    const auto mapped =
+        Dataset<uint64_t>::map<N>(cases, ctrls, dataset.snps, storage, ptr);
+    // Compare the words that hold individuals, since the padding of the
+    // tables read is not initialized
+    const size_t cases_used = (cases + 63) / 64,
+                 ctrls_used = (ctrls + 63) / 64;
+    for (size_t i = 0; i < dataset.snps; i++) {
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_EQ(0, memcmp(dataset[i].cases + k * dataset[i].cases_words,
+                                mapped[i].cases + k * mapped[i].cases_words,
+                                cases_used * sizeof(uint64_t)));
+            EXPECT_EQ(0, memcmp(dataset[i].ctrls + k * dataset[i].ctrls_words,
+                                mapped[i].ctrls + k * mapped[i].ctrls_words,
+                                ctrls_used * sizeof(uint64_t)));
+        }
+    }
+}
+
+TEST(DatasetTest, Ranges)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    EXPECT_EQ(dataset.snps, Dataset<uint64_t>::count_snps(tped));
+    // Read SNPs 1, 2, 5 and 9, ignoring the ranges past the end of the file
+    const std::vector<size_t> expected{1, 2, 5, 9};
+    const auto subset = Dataset<uint64_t>::read<N>(
+        tped, tfam, {{1, 3}, {5, 6}, {9, 12}, {15, 20}});
+
+    ASSERT_EQ(expected.size(), subset.snps);
+    EXPECT_EQ(dataset.cases, subset.cases);
+    EXPECT_EQ(dataset.ctrls, subset.ctrls);
+    for (size_t i = 0; i < subset.snps; i++) {
+        const auto &t = dataset[expected[i]];
+        ASSERT_EQ(t.cases_words, subset[i].cases_words);
+        ASSERT_EQ(t.ctrls_words, subset[i].ctrls_words);
+        EXPECT_EQ(0, memcmp(t.cases, subset[i].cases,
+                            3 * t.cases_words * sizeof(uint64_t)));
+        EXPECT_EQ(0, memcmp(t.ctrls, subset[i].ctrls,
+                            3 * t.ctrls_words * sizeof(uint64_t)));
+    }
+}
+
+size_t popcount(const uint64_t *row, const size_t words)
+{
+    size_t count = 0;
+    for (size_t w = 0; w < words; w++) {
+        count += std::bitset<64>(row[w]).count();
+    }
+    return count;
+}
+
+TEST(DatasetTest, Slice)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    // The slices cover all the individuals, and the genotype counts of each
+    // SNP add up to the counts of the whole data set
+    const size_t slices = 3;
+    std::vector<std::vector<size_t>> counts(dataset.snps,
+                                            std::vector<size_t>(6, 0));
+    size_t cases = 0, ctrls = 0;
+    for (size_t s = 0; s < slices; s++) {
+        const auto slice =
+            Dataset<uint64_t>::read_slice<N>(tped, tfam, s, slices);
+        ASSERT_EQ(dataset.snps, slice.snps);
+        cases += slice.cases;
+        ctrls += slice.ctrls;
+        for (size_t i = 0; i < slice.snps; i++) {
+            const auto &t = slice[i];
+            for (size_t k = 0; k < 3; k++) {
+                counts[i][k] +=
+                    popcount(t.cases + k * t.cases_words, t.cases_words);
+                counts[i][3 + k] +=
+                    popcount(t.ctrls + k * t.ctrls_words, t.ctrls_words);
+            }
+        }
+    }
+    EXPECT_EQ(dataset.cases, cases);
+    EXPECT_EQ(dataset.ctrls, ctrls);
+    for (size_t i = 0; i < dataset.snps; i++) {
+        const auto &t = dataset[i];
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_EQ(popcount(t.cases + k * t.cases_words, t.cases_words),
+                      counts[i][k]);
+            EXPECT_EQ(popcount(t.ctrls + k * t.ctrls_words, t.ctrls_words),
+                      counts[i][3 + k]);
+        }
+    }
+}
+
+TEST(DatasetTest, Interleaved)
+{
+    // Alternate cases and controls, so that the words of one class fill while
+    // individuals of the other class are read
+    char directory[] = "/tmp/fiuncho_interleavedXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(directory));
+    const std::string path = std::string(directory) + "/interleaved";
+    const size_t individuals = 300;
+    std::ofstream tped_file(path + ".tped"), tfam_file(path + ".tfam");
+    const char *genotypes[] = {"A A", "A G", "G G"};
+    for (size_t s = 0; s < 3; s++) {
+        tped_file << "1 rs" << s << " 0 " << s;
+        for (size_t j = 0; j < individuals; j++) {
+            tped_file << ' ' << genotypes[(j * (s + 1)) % 3];
+        }
+        tped_file << '\n';
+    }
+    for (size_t j = 0; j < individuals; j++) {
+        tfam_file << j << ' ' << j << " 0 0 1 " << 1 + j % 2 << '\n';
+    }
+    tped_file.close();
+    tfam_file.close();
+#ifdef ALIGN
+    const auto dataset =
+        Dataset<uint64_t>::read<ALIGN>(path + ".tped", path + ".tfam");
+#else
+    const auto dataset =
+        Dataset<uint64_t>::read(path + ".tped", path + ".tfam");
+#endif
+    std::remove((path + ".tped").c_str());
+    std::remove((path + ".tfam").c_str());
+    rmdir(directory);
+    ASSERT_EQ(individuals / 2, dataset.cases);
+    ASSERT_EQ(individuals / 2, dataset.ctrls);
+    // Each individual has exactly one genotype
+    for (size_t i = 0; i < dataset.snps; i++) {
+        const auto &t = dataset[i];
+        size_t cases = 0, ctrls = 0;
+        for (size_t k = 0; k < 3; k++) {
+            cases += popcount(t.cases + k * t.cases_words, t.cases_words);
+            ctrls += popcount(t.ctrls + k * t.ctrls_words, t.ctrls_words);
+        }
+        EXPECT_EQ(dataset.cases, cases);
+        EXPECT_EQ(dataset.ctrls, ctrls);
+    }
+}
+
+TEST(DatasetTest, Stream)
+{
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+    const auto streamed = Dataset<uint64_t>::stream<N>(tped, tfam);
+
+    ASSERT_EQ(dataset.snps, streamed.snps);
+    EXPECT_EQ(dataset.cases, streamed.cases);
+    EXPECT_EQ(dataset.ctrls, streamed.ctrls);
+    EXPECT_GE(streamed.wait(3), 3);
+    EXPECT_EQ(dataset.snps, streamed.wait(dataset.snps + 1));
+    EXPECT_NO_THROW(streamed.finish());
+    for (size_t i = 0; i < dataset.snps; i++) {
+        ASSERT_EQ(dataset[i].cases_words, streamed[i].cases_words);
+        ASSERT_EQ(dataset[i].ctrls_words, streamed[i].ctrls_words);
+        EXPECT_EQ(0, memcmp(dataset[i].cases, streamed[i].cases,
+                            3 * dataset[i].cases_words * sizeof(uint64_t)));
+        EXPECT_EQ(0, memcmp(dataset[i].ctrls, streamed[i].ctrls,
+                            3 * dataset[i].ctrls_words * sizeof(uint64_t)));
+    }
+    // Datasets read at once are always available
+    EXPECT_EQ(dataset.snps, dataset.wait(dataset.snps));
+}
 } // namespace
 
 int main(int argc, char **argv)
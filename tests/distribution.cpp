@@ -0,0 +1,138 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fiuncho/Distribution.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+std::vector<std::vector<int>> enumerate(const Distribution<int> &d)
+{
+    std::vector<std::vector<int>> combinations;
+    for (auto c = d.begin(); c < d.end(); ++c) {
+        combinations.push_back(*c);
+    }
+    return combinations;
+}
+
+TEST(DistributionTest, Rank)
+{
+    const int n = 12;
+    for (int k = 1; k < 5; ++k) {
+        const auto all = enumerate(Distribution<int>(n, k, 1, 0));
+        ASSERT_EQ(Distribution<int>::binomial(n, k), all.size());
+        std::vector<int> c(k);
+        for (size_t i = 0; i < all.size(); ++i) {
+            EXPECT_EQ(i, Distribution<int>::rank(n, all[i]));
+            ASSERT_TRUE(Distribution<int>::unrank(n, i, c));
+            EXPECT_EQ(all[i], c);
+        }
+        EXPECT_FALSE(Distribution<int>::unrank(n, all.size(), c));
+    }
+}
+
+TEST(DistributionTest, Range)
+{
+    const int n = 15, k = 3;
+    const auto all = enumerate(Distribution<int>(n, k, 1, 0));
+    const uint64_t first = 37, last = 301;
+    // The layers of a range cover the range exactly once
+    const Distribution<int> range(n, k, first, last, 1, 0);
+    std::vector<std::vector<int>> covered;
+    for (auto t = 0; t < 4; ++t) {
+        const auto layer = enumerate(range.layer(4, t));
+        covered.insert(covered.end(), layer.begin(), layer.end());
+    }
+    std::sort(covered.begin(), covered.end());
+    ASSERT_EQ(last - first, covered.size());
+    for (size_t i = 0; i < covered.size(); ++i) {
+        EXPECT_EQ(all[first + i], covered[i]);
+    }
+    // Empty ranges and ranges past the end
+    EXPECT_TRUE(enumerate(Distribution<int>(n, k, 10, 10, 1, 0)).empty());
+    EXPECT_TRUE(
+        enumerate(Distribution<int>(n, k, all.size(), all.size() + 5, 1, 0))
+            .empty());
+}
+
+TEST(DistributionTest, Suffixes)
+{
+    const int n = 10;
+    const Distribution<int> d(n, 1, 1, 0);
+    EXPECT_EQ(0, d.suffix_first);
+    EXPECT_EQ(n, d.suffix_last);
+    // Restricting the suffixes keeps the combinations and the range, and
+    // layers inherit the restriction
+    const auto s = Distribution<int>(n, 1, 2, 5, 1, 0).suffixes(6, 8);
+    EXPECT_EQ(6, s.suffix_first);
+    EXPECT_EQ(8, s.suffix_last);
+    EXPECT_EQ(enumerate(Distribution<int>(n, 1, 2, 5, 1, 0)), enumerate(s));
+    const auto layer = s.layer(2, 1);
+    EXPECT_EQ(6, layer.suffix_first);
+    EXPECT_EQ(8, layer.suffix_last);
+    EXPECT_EQ(2, layer.first);
+    EXPECT_EQ(5, layer.last);
+}
+
+TEST(DistributionTest, Part)
+{
+    const int n = 40, k = 2, parts = 7;
+    const uint64_t total = Distribution<int>::binomial(n, k + 1);
+    // Parts are contiguous, cover all combinations and extend into about the
+    // same number of combinations of size k + 1
+    uint64_t next = 0;
+    for (int i = 0; i < parts; ++i) {
+        const auto d = Distribution<int>::part(n, k, i, parts);
+        EXPECT_EQ(next, d.first);
+        next = d.last;
+        uint64_t extended = 0;
+        for (const auto &c : enumerate(d)) {
+            extended += n - c.back() - 1;
+        }
+        EXPECT_NEAR(total / parts, extended, 2 * n);
+    }
+    EXPECT_EQ(Distribution<int>::binomial(n, k), next);
+}
+
+TEST(DistributionTest, Extensions)
+{
+    // Count the extensions of the combinations before each index
+    const int n = 15;
+    for (int k = 1; k < 4; ++k) {
+        const uint64_t count = Distribution<int>::binomial(n, k);
+        uint64_t extended = 0, p = 0;
+        for (const auto &c :
+             enumerate(Distribution<int>(n, k, 0, count, 1, 0))) {
+            EXPECT_EQ(extended, Distribution<int>::extensions(n, k, p++));
+            extended += n - c.back() - 1;
+        }
+        EXPECT_EQ(Distribution<int>::binomial(n, k + 1), extended);
+        EXPECT_EQ(extended, Distribution<int>::extensions(n, k, count));
+    }
+}
+
+TEST(DistributionTest, Binomial)
+{
+    EXPECT_EQ(0, Distribution<int>::binomial(3, 4));
+    EXPECT_EQ(1, Distribution<int>::binomial(7, 0));
+    EXPECT_EQ(499999500000ULL, Distribution<int>::binomial(1000000, 2));
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(),
+              Distribution<int>::binomial(1000000, 5));
+}
+} // namespace
@@ -0,0 +1,121 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <chrono>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/dataset/Synthetic.h>
+#include <fiuncho/utils/Autotuner.h>
+#include <fiuncho/utils/Estimate.h>
+#include <gtest/gtest.h>
+
+std::string tped, tfam;
+
+namespace
+{
+#ifdef ALIGN
+constexpr size_t ALIGNMENT = ALIGN;
+#else
+constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
+
+TEST(EstimateTest, Model)
+{
+    Estimate estimate;
+    estimate.order = 3;
+    estimate.outputs = 10;
+    estimate.combinations = 1000;
+    estimate.rate = 100;
+    estimate.load = 2;
+    estimate.dataset_bytes = 1000000;
+    estimate.merge = 0.5;
+    estimate.pair_merge = 0.25;
+    // A single process and thread computes all combinations
+    EXPECT_EQ(0, estimate.steps());
+    EXPECT_EQ(1000, estimate.per_thread());
+    EXPECT_DOUBLE_EQ(10, estimate.compute_time());
+    EXPECT_DOUBLE_EQ(2, estimate.load_time());
+    EXPECT_DOUBLE_EQ(0.5, estimate.gather_time());
+    EXPECT_DOUBLE_EQ(12.5, estimate.total_time());
+    // The combinations are split among all threads, rounding up, and the
+    // results are reduced in a tree of ceil(log2(ranks)) steps
+    estimate.ranks = 5;
+    estimate.threads = 3;
+    EXPECT_EQ(3, estimate.steps());
+    EXPECT_EQ(67, estimate.per_thread());
+    EXPECT_DOUBLE_EQ(0.67, estimate.compute_time());
+    EXPECT_DOUBLE_EQ(2, estimate.load_time());
+    EXPECT_DOUBLE_EQ(0.5 + 3 * (5e-6 + 160 / 1e9 + 0.25),
+                     estimate.gather_time());
+    // Broadcasting the data set adds its transfer along the tree
+    estimate.broadcast = true;
+    EXPECT_DOUBLE_EQ(2 + 3 * (5e-6 + 1e-3), estimate.load_time());
+    // Every thread adds its buffers to the memory of the process
+    estimate.block_size = 8;
+    const uint64_t one = estimate.memory();
+    estimate.threads = 4;
+    EXPECT_EQ(one / 3 * 4, estimate.memory());
+    const auto json = estimate.json();
+    EXPECT_NE(std::string::npos, json.find("\"combinations_per_thread\": 50"));
+    EXPECT_NE(std::string::npos, json.find("\"predicted\": {"));
+}
+
+TEST(EstimateTest, Prediction)
+{
+    const auto read = Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam);
+    Estimate estimate;
+    estimate.dataset(read);
+    EXPECT_EQ(read.snps, estimate.snps);
+    EXPECT_EQ(read[0].cases_words, estimate.cases_words);
+    EXPECT_EQ(read.raw_size() * sizeof(uint64_t), estimate.dataset_bytes);
+    // The predicted compute time of a search is in the order of its actual
+    // duration
+    const auto dataset =
+        Synthetic(60, 500, 500, 0.05, 0.5, 1).dataset<uint64_t, ALIGNMENT>();
+    estimate.order = 3;
+    estimate.combinations = Distribution<int>::binomial(dataset.snps, 3);
+    estimate.block_size = Autotuner::default_block_size(3);
+    estimate.rate =
+        Autotuner::throughput(dataset, 3, estimate.block_size, 0.05);
+    EXPECT_GT(estimate.rate, 0);
+    ThreadedSearch search(1, {}, true);
+    Distribution<int> distribution(dataset.snps, 2, 1, 0);
+    double elapsed = 1e9;
+    for (auto i = 0; i < 3; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        search.run(dataset, 3, distribution, 10);
+        elapsed = std::min(elapsed, std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() -
+                                        start)
+                                        .count());
+    }
+    EXPECT_LT(estimate.compute_time(), elapsed * 10);
+    EXPECT_GT(estimate.compute_time(), elapsed / 10);
+    EXPECT_GT(Estimate::merge_time(100, 10, 3), 0);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
@@ -18,6 +18,7 @@
 #include <bitset>
 #include <fiuncho/ContingencyTable.h>
 #include <fiuncho/GenotypeTable.h>
+#include <fiuncho/utils/Arena.h>
 #include <gtest/gtest.h>
 
 #ifdef ALIGN
@@ -237,4 +238,33 @@ TEST(GenotypeTableTest, popcnt)
     }
 #endif
 }
+
+TEST(GenotypeTableTest, arena)
+{
+    uint32_t popcnt_cases[9] = {256, 128, 256, 128, 256, 256, 256, 256, 512};
+    uint64_t popcnt_ctrls[9] = {512, 512, 256, 512, 1024, 512, 256, 512, 512};
+
+    const size_t gt_size = GenotypeTable<uint64_t>::required_size(2, 8, 16),
+                 ct_size = ContingencyTable<uint32_t>::required_size(2);
+    Arena arena(Arena::footprint<uint64_t>(gt_size) +
+                2 * Arena::footprint<uint32_t>(ct_size));
+    GenotypeTable<uint64_t> gtable(2, 8, 16, arena.allocate<uint64_t>(gt_size));
+    ContingencyTable<uint32_t> ctable1(2, 8, 16,
+                                       arena.allocate<uint32_t>(ct_size)),
+        ctable2(2, 8, 16, arena.allocate<uint32_t>(ct_size));
+    EXPECT_EQ(0, (uintptr_t)ctable1.cases % Arena::alignment);
+    EXPECT_EQ(0, (uintptr_t)ctable2.cases % Arena::alignment);
+    EXPECT_GE(ctable2.cases, ctable1.ctrls + ctable1.size);
+
+    GenotypeTable<uint64_t>::combine(t1, t2, gtable);
+    GenotypeTable<uint64_t>::combine_and_popcnt(t1, t2, ctable1);
+    GenotypeTable<uint64_t>::combine_and_popcnt(t1, t2, ctable2);
+
+    for (auto i = 0; i < 9; i++) {
+        EXPECT_EQ(ctable1.cases[i], popcnt_cases[i]);
+        EXPECT_EQ(ctable1.ctrls[i], popcnt_ctrls[i]);
+        EXPECT_EQ(ctable2.cases[i], popcnt_cases[i]);
+        EXPECT_EQ(ctable2.ctrls[i], popcnt_ctrls[i]);
+    }
+}
 } // namespace
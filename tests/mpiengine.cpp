@@ -16,10 +16,16 @@
  */
 
 #include "utils.h"
+#include <algorithm>
 #include <fiuncho/MPIEngine.h>
+#include <fiuncho/MPISlicedSearch.h>
 #include <fiuncho/ThreadedSearch.h>
 #include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Affinity.h>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <unistd.h>
 
 std::string tped, tfam;
 
@@ -46,11 +52,317 @@ TEST(MPIEngineTest, General)
         }
     }
 }
+
+TEST(MPIEngineTest, Broadcast)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine engine(DatasetPlacement::Default, true);
+    auto results = engine.run<ThreadedSearch>(tped, tfam, 3, 100, 4);
+    if (rank == 0) {
+        EXPECT_EQ(results.size(), 100);
+        EXPECT_FALSE(has_repeated_elements(results));
+        EXPECT_TRUE(ascending_combinations(results));
+        EXPECT_TRUE(matches_mpi3snp_output(results));
+    }
+}
+
+TEST(MPIEngineTest, Shared)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    for (auto broadcast : {false, true}) {
+        MPIEngine engine(DatasetPlacement::Default, broadcast, true);
+        auto results = engine.run<ThreadedSearch>(tped, tfam, 3, 100, 4);
+        if (rank == 0) {
+            EXPECT_EQ(results.size(), 100);
+            EXPECT_FALSE(has_repeated_elements(results));
+            EXPECT_TRUE(ascending_combinations(results));
+            EXPECT_TRUE(matches_mpi3snp_output(results));
+        }
+    }
+}
+
+TEST(MPIEngineTest, Dynamic)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine reference;
+    MPIEngine engine(DatasetPlacement::Default, false, false,
+                     MPIScheduling::Dynamic);
+    for (auto o = 2; o < 5; o++) {
+        auto expected = reference.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        auto results = engine.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        if (rank == 0) {
+            ASSERT_EQ(results.size(), expected.size());
+            for (size_t i = 0; i < results.size(); i++) {
+                EXPECT_EQ(results[i].combination, expected[i].combination);
+                EXPECT_EQ(results[i].val, expected[i].val);
+            }
+            if (o == 3) {
+                EXPECT_TRUE(matches_mpi3snp_output(results));
+            }
+        }
+    }
+}
+
+TEST(MPIEngineTest, Weighted)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine reference;
+    // Uneven explicit weights, and weights measured through calibration
+    MPIEngine uneven(DatasetPlacement::Default, false, false,
+                     MPIScheduling::Weighted, rank + 1);
+    MPIEngine calibrated(DatasetPlacement::Default, false, false,
+                         MPIScheduling::Weighted);
+    for (auto o = 2; o < 5; o++) {
+        auto expected = reference.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        for (auto engine : {&uneven, &calibrated}) {
+            auto results = engine->run<ThreadedSearch>(tped, tfam, o, 100, 4);
+            if (rank == 0) {
+                ASSERT_EQ(results.size(), expected.size());
+                for (size_t i = 0; i < results.size(); i++) {
+                    EXPECT_EQ(results[i].combination,
+                              expected[i].combination);
+                    EXPECT_EQ(results[i].val, expected[i].val);
+                }
+            }
+        }
+    }
+}
+
+TEST(MPIEngineTest, BlockPairs)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine reference;
+    auto expected = reference.run<ThreadedSearch>(tped, tfam, 2, 100, 4);
+    // Default number of blocks, a single block, uneven blocks, one block per
+    // SNP and more blocks than SNPs
+    for (unsigned int blocks : {0, 1, 3, 10, 16}) {
+        MPIEngine engine(DatasetPlacement::Default, false, false,
+                         MPIScheduling::BlockPairs, 0, blocks);
+        auto results = engine.run<ThreadedSearch>(tped, tfam, 2, 100, 4);
+        if (rank == 0) {
+            ASSERT_EQ(results.size(), expected.size());
+            for (size_t i = 0; i < results.size(); i++) {
+                EXPECT_EQ(results[i].combination, expected[i].combination);
+                EXPECT_EQ(results[i].val, expected[i].val);
+            }
+        }
+    }
+    MPIEngine engine(DatasetPlacement::Default, false, false,
+                     MPIScheduling::BlockPairs);
+    EXPECT_THROW(engine.run<ThreadedSearch>(tped, tfam, 3, 100, 4),
+                 std::runtime_error);
+}
+
+TEST(MPIEngineTest, Individuals)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine reference;
+    MPIEngine engine(DatasetPlacement::Default, false, false,
+                     MPIScheduling::Individuals);
+    for (auto o = 2; o < 5; o++) {
+        auto expected = reference.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        auto results = engine.run<MPISlicedSearch>(tped, tfam, o, 100, 3);
+        if (rank == 0) {
+            ASSERT_EQ(results.size(), expected.size());
+            for (size_t i = 0; i < results.size(); i++) {
+                EXPECT_EQ(results[i].combination, expected[i].combination);
+                EXPECT_EQ(results[i].val, expected[i].val);
+            }
+            if (o == 3) {
+                EXPECT_TRUE(matches_mpi3snp_output(results));
+            }
+        }
+    }
+    EXPECT_THROW(engine.run<ThreadedSearch>(tped, tfam, 2, 100, 4),
+                 std::runtime_error);
+    // Thread 0 runs in the calling thread, which keeps its affinity
+    const auto cpus = available_cpus();
+    engine.run<MPISlicedSearch>(tped, tfam, 3, 10, 2,
+                                std::vector<int>{cpus.back()});
+    EXPECT_EQ(cpus, available_cpus());
+}
+
+TEST(MPIEngineTest, Checkpoint)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    // Process 0 creates the checkpoint directory
+    char directory[] = "/tmp/fiuncho_ckptXXXXXX";
+    if (rank == 0) {
+        mkdtemp(directory);
+    }
+    MPI_Bcast(directory, sizeof(directory), MPI_CHAR, 0, MPI_COMM_WORLD);
+    MPIEngine reference;
+    MPIEngine engine(DatasetPlacement::Default, false, false,
+                     MPIScheduling::Static, 0, 0, false, directory, false, 0);
+    MPIEngine resumed(DatasetPlacement::Default, false, false,
+                      MPIScheduling::Static, 0, 0, false, directory, true, 0);
+    for (auto o = 2; o < 5; o++) {
+        auto expected = reference.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        auto results = engine.run<ThreadedSearch>(tped, tfam, o, 100, 4);
+        // Resuming a completed search returns the same results
+        auto again = resumed.run<ThreadedSearch>(tped, tfam, o, 100, 2);
+        if (rank == 0) {
+            ASSERT_EQ(results.size(), expected.size());
+            ASSERT_EQ(again.size(), expected.size());
+            for (size_t i = 0; i < results.size(); i++) {
+                EXPECT_EQ(results[i].val, expected[i].val);
+                EXPECT_EQ(again[i].val, expected[i].val);
+            }
+            EXPECT_FALSE(has_repeated_elements(again));
+        }
+    }
+    MPIEngine dynamic(DatasetPlacement::Default, false, false,
+                      MPIScheduling::Dynamic, 0, 0, false, directory);
+    EXPECT_THROW(dynamic.run<ThreadedSearch>(tped, tfam, 3, 100, 4),
+                 std::runtime_error);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+        Checkpoint(directory, 0, 0, 2, 0, 0).clear();
+        rmdir(directory);
+    }
+}
+
+TEST(MPIEngineTest, Progress)
+{
+    // The last report of process 0 adds up the combinations of all processes
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    char path[] = "/tmp/fiuncho_progressXXXXXX";
+    if (rank == 0) {
+        close(mkstemp(path));
+    }
+    MPI_Bcast(path, sizeof(path), MPI_CHAR, 0, MPI_COMM_WORLD);
+    const std::vector<MPIScheduling> policies = {
+        MPIScheduling::Static, MPIScheduling::Dynamic,
+        MPIScheduling::Weighted, MPIScheduling::Individuals};
+    for (const auto scheduling : policies) {
+        MPIEngine engine(DatasetPlacement::Default, false, false, scheduling,
+                         0, 0, false, "", false, 600, 0.001, path);
+        for (auto o = 2; o < 4; o++) {
+            if (scheduling == MPIScheduling::Individuals) {
+                engine.run<MPISlicedSearch>(tped, tfam, o, 10, 2);
+            } else {
+                engine.run<ThreadedSearch>(tped, tfam, o, 10, 2);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+            if (rank == 0) {
+                std::ifstream is(path);
+                std::string line, last;
+                while (std::getline(is, line)) {
+                    last = line;
+                }
+                double elapsed;
+                uint64_t combinations, total;
+                std::istringstream(last) >> elapsed >> combinations >> total;
+                EXPECT_EQ(o == 2 ? 45 : 120, total);
+                EXPECT_EQ(total, combinations);
+            }
+        }
+    }
+    if (rank == 0) {
+        std::remove(path);
+    }
+}
+
+TEST(MPIEngineTest, Trace)
+{
+    // Process 0 writes the events of all processes to a single timeline
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    char path[] = "/tmp/fiuncho_traceXXXXXX";
+    if (rank == 0) {
+        close(mkstemp(path));
+    }
+    MPI_Bcast(path, sizeof(path), MPI_CHAR, 0, MPI_COMM_WORLD);
+    MPIEngine engine(DatasetPlacement::Default, false, false,
+                     MPIScheduling::Static, 0, 0, false, "", false, 600, 0, "",
+                     path);
+    engine.run<ThreadedSearch>(tped, tfam, 3, 10, 2);
+    if (rank == 0) {
+        std::ifstream is(path);
+        std::stringstream trace;
+        trace << is.rdbuf();
+        const auto count = [&trace](const std::string &s) {
+            size_t n = 0, pos = 0;
+            while ((pos = trace.str().find(s, pos)) != std::string::npos) {
+                n++;
+                pos += s.size();
+            }
+            return n;
+        };
+        EXPECT_EQ(0, trace.str().find("{\"displayTimeUnit\""));
+        EXPECT_EQ((size_t)size, count("\"name\":\"process_name\""));
+        EXPECT_EQ((size_t)size, count("\"name\":\"dataset load\""));
+        EXPECT_EQ((size_t)size, count("\"name\":\"MPI_Reduce\""));
+        EXPECT_LE((size_t)size, count("\"name\":\"block score\""));
+        EXPECT_EQ(0, count("\"ts\":-"));
+        std::remove(path);
+    }
+}
+
+TEST(MPIEngineTest, Report)
+{
+    // Process 0 receives the work done by every process, which evaluate all
+    // combinations between them. The calibration of weighted scheduling is
+    // not counted
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    for (auto scheduling : {MPIScheduling::Static, MPIScheduling::Dynamic,
+                            MPIScheduling::BlockPairs,
+                            MPIScheduling::Weighted}) {
+        Report report;
+        MPIEngine engine(DatasetPlacement::Default, false, false, scheduling,
+                         0, 0);
+        engine.run<ThreadedSearch>(tped, tfam, 2, 10, 2);
+        if (rank == 0) {
+            ASSERT_EQ((size_t)size, report.processes.size());
+            uint64_t combinations = 0;
+            for (const auto &p : report.processes) {
+                EXPECT_LE(0, p.load);
+                EXPECT_LE(0, p.compute);
+                EXPECT_LT(0, p.peak_rss);
+                for (const auto &t : p.threads) {
+                    combinations += t.combinations;
+                }
+            }
+            EXPECT_EQ(Distribution<int>::binomial(report.snps, 2),
+                      combinations);
+        }
+    }
+}
+
+TEST(MPIEngineTest, Reduction)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPIEngine engine;
+    // Request more outputs than combinations available, so that every process
+    // contributes a partially filled block
+    auto results = engine.run<ThreadedSearch>(tped, tfam, 2, 1000, 2);
+    if (rank == 0) {
+        EXPECT_EQ(results.size(), 45);
+        EXPECT_FALSE(has_repeated_elements(results));
+        EXPECT_TRUE(ascending_combinations(results));
+        EXPECT_TRUE(std::is_sorted(results.rbegin(), results.rend()));
+    } else {
+        EXPECT_TRUE(results.empty());
+    }
+}
 } // namespace
 
 int main(int argc, char **argv)
 {
-    MPI_Init(&argc, &argv);
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
     ::testing::InitGoogleTest(&argc, argv);
 
     // Delete listeners for all processes minus the first
@@ -0,0 +1,98 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cstdio>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/PartialResults.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+// Path to a new temporary file
+std::string temporary_file()
+{
+    char path[] = "/tmp/fiuncho_partXXXXXX";
+    const int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+TEST(PartialResultsTest, Merge)
+{
+    // Split the search in parts, and merge the results of all parts
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch search(4);
+    const unsigned int parts = 3, outputs = 100;
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        auto expected = search.run(dataset, o, distribution, outputs);
+        std::vector<std::string> paths;
+        for (unsigned int i = 0; i < parts; ++i) {
+            const auto part =
+                Distribution<int>::part(dataset.snps, o - 1, i, parts);
+            paths.push_back(temporary_file());
+            PartialResults::write(paths.back(), i, parts, o,
+                                  search.run(dataset, o, part, outputs));
+        }
+        // Files are merged in any order
+        std::swap(paths.front(), paths.back());
+        auto result = PartialResults::merge(paths, outputs);
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            EXPECT_EQ(result[i].val, expected[i].val);
+        }
+        EXPECT_FALSE(has_repeated_elements(result));
+        EXPECT_TRUE(ascending_combinations(result));
+        if (o == 3) {
+            EXPECT_TRUE(matches_mpi3snp_output(result));
+        }
+        // All parts are required exactly once
+        const auto first = paths.front();
+        paths.erase(paths.begin());
+        EXPECT_THROW(PartialResults::merge(paths, outputs), std::runtime_error);
+        paths.push_back(paths.front());
+        EXPECT_THROW(PartialResults::merge(paths, outputs), std::runtime_error);
+        std::remove(first.c_str());
+        for (const auto &path : paths) {
+            std::remove(path.c_str());
+        }
+    }
+    // Other files are rejected
+    EXPECT_THROW(PartialResults::merge({tfam}, outputs), std::runtime_error);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Phase timers are only enabled in BENCHMARK builds
+#ifndef BENCHMARK
+#define BENCHMARK
+#endif
+
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/PerfCounters.h>
+#include <fiuncho/utils/PhaseTimer.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+TEST(PhaseTimerTest, Lap)
+{
+    // Laps add the time since the previous lap to their phase
+    PhaseTimer timer;
+    timer.start();
+    usleep(20000);
+    timer.lap(Phase::Wait);
+    timer.lap(Phase::MI);
+    const auto seconds = timer.stop();
+    ASSERT_EQ((size_t)PhaseTimer::fields, seconds.size());
+    EXPECT_NEAR(0.02, seconds[static_cast<int>(Phase::Wait)], 0.015);
+    EXPECT_LT(seconds[static_cast<int>(Phase::MI)], 0.001);
+    EXPECT_EQ(0, seconds[static_cast<int>(Phase::Combine)]);
+    EXPECT_EQ(0, seconds[static_cast<int>(Phase::Popcount)]);
+}
+
+TEST(PhaseTimerTest, Search)
+{
+    // Every thread of the search adds its phases to the totals of the process
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch standalone(2), pipelined(2, {}, false, 1);
+    for (auto search : {&standalone, &pipelined}) {
+        for (auto o = 2; o < 5; o++) {
+            auto &totals = PhaseTimer::totals();
+            std::fill(totals.begin(), totals.end(), 0);
+            Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+            search->run(dataset, o, distribution, 10);
+            EXPECT_GT(totals[static_cast<int>(Phase::Popcount)], 0);
+            EXPECT_GT(totals[static_cast<int>(Phase::MI)], 0);
+            EXPECT_GT(totals[static_cast<int>(Phase::TopK)], 0);
+            EXPECT_EQ(Distribution<int>::binomial(dataset.snps, o),
+                      totals[PhaseTimer::phases]);
+            if (o == 2) {
+                EXPECT_EQ(0, totals[static_cast<int>(Phase::Combine)]);
+            } else {
+                EXPECT_GT(totals[static_cast<int>(Phase::Combine)], 0);
+            }
+        }
+    }
+}
+
+TEST(PerfCountersTest, Read)
+{
+    // Counters either count the events of the thread, or read as NaN if perf
+    // events are not permitted
+    PerfCounters counters;
+    const auto before = counters.read();
+    volatile double x = 0;
+    for (int i = 0; i < 1000000; ++i) {
+        x = x + i;
+    }
+    const auto counts = PerfCounters::delta(before, counters.read());
+    if (counters.available()) {
+        for (int e = 0; e < PerfCounters::events; ++e) {
+            EXPECT_TRUE(std::isnan(counts[e]) || counts[e] >= 0);
+        }
+        if (!std::isnan(counts[1])) {
+            EXPECT_GT(counts[1], 1000000);
+        }
+    } else {
+        EXPECT_FALSE(counters.error().empty());
+        for (const auto c : counts) {
+            EXPECT_TRUE(std::isnan(c));
+        }
+        EXPECT_EQ("hardware counters not available",
+                  PerfCounters::str(counts, 10, "combination"));
+    }
+    PerfCounters::Values values = {200, 300, 10, 1, 0};
+    EXPECT_EQ("IPC 1.5, per combination: 20 cycles, 30 instructions, "
+              "1 L1D misses, 0.1 LLC misses, 0 DTLB misses",
+              PerfCounters::str(values, 10, "combination"));
+    values[1] = NAN;
+    EXPECT_EQ("per iteration: 20 cycles, 1 L1D misses, 0.1 LLC misses, "
+              "0 DTLB misses",
+              PerfCounters::str(values, 10, "iteration"));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
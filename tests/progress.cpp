@@ -0,0 +1,128 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cstdio>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/SlicedSearch.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Progress.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+// Path to a new temporary file
+std::string temporary_file()
+{
+    char path[] = "/tmp/fiuncho_progressXXXXXX";
+    const int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+TEST(ProgressTest, Count)
+{
+    // Every search counts each combination once, and the threshold is a lower
+    // bound of the lowest value among the best results
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    const unsigned int outputs = 5;
+    ThreadedSearch single(1), threaded(4), pipelined(3, {}, false, 2);
+    SlicedSearch sliced(3);
+    std::vector<Search *> searches = {&single, &threaded, &pipelined, &sliced};
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        for (auto search : searches) {
+            Progress progress(Distribution<int>::binomial(dataset.snps, o), 0,
+                              3600, "", Progress::Reduce(), false);
+            auto result = search->run(dataset, o, distribution, outputs);
+            const auto sample = progress.sample();
+            EXPECT_EQ(Distribution<int>::binomial(dataset.snps, o),
+                      sample.combinations);
+            EXPECT_LE(sample.threshold, result.back().val);
+            if (search == &single) {
+                EXPECT_EQ(result.back().val, sample.threshold);
+            }
+        }
+    }
+    // Counters do nothing without a Progress object
+    Progress::Counter counter;
+    counter.add(1);
+}
+
+TEST(ProgressTest, Report)
+{
+    // The last report of the file covers the whole search
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch search(2);
+    const auto path = temporary_file();
+    const uint64_t total = Distribution<int>::binomial(dataset.snps, 3);
+    {
+        Progress progress(total + 10, 10, 0.001, path);
+        Distribution<int> distribution(dataset.snps, 2, 1, 0);
+        search.run(dataset, 3, distribution, 10);
+        usleep(10000);
+    }
+    std::ifstream is(path);
+    std::string header, line, last;
+    std::getline(is, header);
+    EXPECT_EQ("elapsed\tcombinations\ttotal\tpercent\trate\teta\tthreshold",
+              header);
+    size_t lines = 0;
+    while (std::getline(is, line)) {
+        last = line;
+        lines++;
+    }
+    EXPECT_GT(lines, 1);
+    double elapsed, percent, rate, eta;
+    uint64_t combinations, reported;
+    std::istringstream fields(last);
+    fields >> elapsed >> combinations >> reported >> percent >> rate >> eta;
+    EXPECT_EQ(total + 10, combinations);
+    EXPECT_EQ(total + 10, reported);
+    EXPECT_EQ(100, percent);
+    EXPECT_EQ(0, eta);
+    std::remove(path.c_str());
+    EXPECT_EQ("00:00:59", Progress::duration(59.4));
+    EXPECT_EQ("1d 01:01:01", Progress::duration(90061));
+    EXPECT_EQ("unknown", Progress::duration(-1));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
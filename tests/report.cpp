@@ -0,0 +1,127 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cstdio>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/SlicedSearch.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Report.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+TEST(ReportTest, Json)
+{
+    // The totals of the report are computed from the work of every thread
+    Report report;
+    EXPECT_THROW(Report(), std::runtime_error);
+    EXPECT_EQ(&report, Report::current());
+    report.backend = "ThreadedSearch";
+    report.local().compute = 2;
+    Report::thread(1, 1.5, 300);
+    Report::thread(0, 0.5, 100);
+    Report::thread(1, 0.5, 100);
+    report.processes.push_back({1, 4, 1024, {{2, 400}}});
+    ASSERT_EQ(2, report.local().threads.size());
+    EXPECT_EQ(2, report.local().threads[1].seconds);
+    EXPECT_EQ(400, report.local().threads[1].combinations);
+    EXPECT_LT(0, Report::peak_rss());
+    {
+        // Work done while the report is suspended is not added
+        Report::Suspend suspend;
+        EXPECT_EQ(nullptr, Report::current());
+        Report::thread(0, 1, 1000);
+    }
+    EXPECT_EQ(&report, Report::current());
+    EXPECT_EQ(100, report.local().threads[0].combinations);
+
+    const auto json = report.json();
+    EXPECT_NE(std::string::npos, json.find("\"backend\": \"ThreadedSearch\""));
+    EXPECT_NE(std::string::npos, json.find("\"processes\": 2,"));
+    EXPECT_NE(std::string::npos, json.find("\"threads\": 3,"));
+    EXPECT_NE(std::string::npos, json.find("\"load_time\": 1,"));
+    EXPECT_NE(std::string::npos, json.find("\"compute_time\": 4,"));
+    EXPECT_NE(std::string::npos, json.find("\"combinations\": 900,"));
+    EXPECT_NE(std::string::npos,
+              json.find("\"combinations_per_second\": 225,"));
+    EXPECT_NE(std::string::npos, json.find("\"peak_rss\": 1024,"));
+    // The slowest threads take 2 seconds, and the average 1.5 seconds
+    EXPECT_NE(std::string::npos, json.find("\"imbalance\": 1.33333,"));
+    EXPECT_NE(std::string::npos, json.find("{\"rank\": 1,"));
+}
+
+TEST(ReportTest, Search)
+{
+    // Searches add every combination evaluated to the report of each of their
+    // threads
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch threaded(3);
+    SlicedSearch sliced(2);
+    std::vector<Search *> searches = {&threaded, &sliced};
+    for (auto o = 2; o < 5; o++) {
+        for (auto search : searches) {
+            Report report;
+            report.dataset(dataset);
+            EXPECT_EQ(dataset.snps, report.snps);
+            EXPECT_EQ(dataset[0].cases_words, report.cases_words);
+            Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+            search->run(dataset, o, distribution, 10);
+            uint64_t combinations = 0;
+            for (const auto &t : report.local().threads) {
+                EXPECT_LE(0, t.seconds);
+                combinations += t.combinations;
+            }
+            EXPECT_EQ(Distribution<int>::binomial(dataset.snps, o),
+                      combinations);
+
+            char path[] = "/tmp/fiuncho_reportXXXXXX";
+            close(mkstemp(path));
+            report.write(path);
+            std::ifstream file(path);
+            std::stringstream contents;
+            contents << file.rdbuf();
+            EXPECT_EQ(0, contents.str().find("{\n  \"version\""));
+            remove(path);
+        }
+        // Without a report, searches run as usual
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        EXPECT_EQ(10, threaded.run(dataset, o, distribution, 10).size());
+    }
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
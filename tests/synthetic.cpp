@@ -0,0 +1,209 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/dataset/Individual.h>
+#include <fiuncho/dataset/SNP.h>
+#include <fiuncho/dataset/Synthetic.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+#ifdef ALIGN
+constexpr size_t ALIGNMENT = ALIGN;
+#else
+constexpr size_t ALIGNMENT = sizeof(uint64_t);
+#endif
+
+TEST(SyntheticTest, Generate)
+{
+    // A Dataset generated from the genotypes of the input files is identical
+    // to the Dataset read from them
+    std::vector<Individual> individuals;
+    std::vector<SNP> snps;
+    std::ifstream fam(tfam), ped(tped);
+    Individual ind;
+    while (fam >> ind) {
+        individuals.push_back(ind);
+    }
+    SNP snp;
+    while (ped >> snp) {
+        snps.push_back(snp);
+    }
+    size_t cases = 0;
+    for (const auto &i : individuals) {
+        cases += i.ph == 2;
+    }
+    const auto generated = Dataset<uint64_t>::generate<ALIGNMENT>(
+        cases, individuals.size() - cases, snps.size(),
+        [&](const size_t i, std::vector<uint8_t> &g) {
+            g.clear();
+            for (const auto ph : {2, 1}) {
+                for (size_t j = 0; j < individuals.size(); j++) {
+                    if (individuals[j].ph == ph) {
+                        g.push_back(snps[i].genotypes[j]);
+                    }
+                }
+            }
+        });
+    const auto read = Dataset<uint64_t>::read<ALIGNMENT>(tped, tfam);
+    ASSERT_EQ(read.snps, generated.snps);
+    EXPECT_EQ(read.cases, generated.cases);
+    EXPECT_EQ(read.ctrls, generated.ctrls);
+    ASSERT_EQ(read.raw_size(), generated.raw_size());
+    EXPECT_EQ(0, memcmp(read.raw(), generated.raw(),
+                        read.raw_size() * sizeof(uint64_t)));
+    // The callback must produce a genotype for every individual
+    EXPECT_THROW(Dataset<uint64_t>::generate<ALIGNMENT>(
+                     10, 10, 1,
+                     [](const size_t, std::vector<uint8_t> &g) { g.clear(); }),
+                 std::runtime_error);
+}
+
+TEST(SyntheticTest, Reproducible)
+{
+    // The same seed generates the same data set, and each SNP follows the
+    // Hardy-Weinberg equilibrium of its minor allele frequency
+    const Synthetic a(50, 1000, 3000, 0.1, 0.4, 7),
+        b(50, 1000, 3000, 0.1, 0.4, 7), c(50, 1000, 3000, 0.1, 0.4, 8);
+    const auto da = a.dataset<uint64_t, ALIGNMENT>(),
+               db = b.dataset<uint64_t, ALIGNMENT>(),
+               dc = c.dataset<uint64_t, ALIGNMENT>();
+    EXPECT_EQ(50, da.snps);
+    EXPECT_EQ(1000, da.cases);
+    EXPECT_EQ(3000, da.ctrls);
+    EXPECT_EQ(0, memcmp(da.raw(), db.raw(), da.raw_size() * sizeof(uint64_t)));
+    EXPECT_NE(0, memcmp(da.raw(), dc.raw(), da.raw_size() * sizeof(uint64_t)));
+    std::vector<uint8_t> g;
+    for (size_t s = 0; s < a.snps; s++) {
+        const double p = a.maf(s);
+        EXPECT_GE(p, 0.1);
+        EXPECT_LE(p, 0.4);
+        a.genotypes(s, g);
+        ASSERT_EQ(4000, g.size());
+        double alleles = 0;
+        for (const auto x : g) {
+            ASSERT_LE(x, 2);
+            alleles += x;
+        }
+        EXPECT_NEAR(p, alleles / (2 * g.size()), 0.04);
+    }
+    EXPECT_THROW(Synthetic(10, 10, 10, 0.3, 0.2), std::runtime_error);
+    EXPECT_THROW(Synthetic(10, 10, 10, 0.1, 0.6), std::runtime_error);
+}
+
+TEST(SyntheticTest, Search)
+{
+    // Searches run on a synthetic data set as on any other
+    const auto dataset =
+        Synthetic(40, 100, 120, 0.05, 0.5, 1).dataset<uint64_t, ALIGNMENT>();
+    ThreadedSearch search(2);
+    Distribution<int> distribution(dataset.snps, 2, 1, 0);
+    const auto results = search.run(dataset, 3, distribution, 10);
+    EXPECT_EQ(10, results.size());
+    EXPECT_FALSE(has_repeated_elements(results));
+}
+
+TEST(SyntheticTest, Plant)
+{
+    // The search finds the planted interaction of every model as the best
+    // combination
+    const std::vector<std::pair<InteractionModel, double>> models = {
+        {InteractionModel::XOR, 4},
+        {InteractionModel::Threshold, 4},
+        {InteractionModel::Multiplicative, 1}};
+    ThreadedSearch search(2);
+    for (const auto &m : models) {
+        for (const auto &planted :
+             {std::vector<size_t>{3, 11}, std::vector<size_t>{2, 7, 19}}) {
+            Synthetic synthetic(24, 600, 600, 0.3, 0.5, 5);
+            synthetic.plant(m.first, planted, 0.1, m.second);
+            EXPECT_EQ(planted, synthetic.planted());
+            const auto dataset = synthetic.dataset<uint64_t, ALIGNMENT>();
+            const int order = planted.size();
+            Distribution<int> distribution(dataset.snps, order - 1, 1, 0);
+            const auto results = search.run(dataset, order, distribution, 1);
+            ASSERT_EQ(1, results.size());
+            EXPECT_EQ(std::vector<int>(planted.begin(), planted.end()),
+                      results[0].combination);
+        }
+    }
+    // Penetrances of each model
+    Synthetic synthetic(4, 10, 10);
+    synthetic.plant(InteractionModel::XOR, {0, 1}, 0.1, 2);
+    EXPECT_DOUBLE_EQ(0.1, synthetic.penetrance({1, 1}));
+    EXPECT_DOUBLE_EQ(0.3, synthetic.penetrance({2, 1}));
+    synthetic.plant(InteractionModel::Threshold, {0, 1}, 0.1, 2);
+    EXPECT_DOUBLE_EQ(0.1, synthetic.penetrance({0, 2}));
+    EXPECT_DOUBLE_EQ(0.3, synthetic.penetrance({1, 2}));
+    synthetic.plant(InteractionModel::Multiplicative, {0, 1}, 0.1, 2);
+    EXPECT_DOUBLE_EQ(0.9, synthetic.penetrance({1, 1}));
+    EXPECT_DOUBLE_EQ(1, synthetic.penetrance({2, 1}));
+    // Invalid interactions
+    EXPECT_THROW(synthetic.plant(InteractionModel::XOR, {0, 0}, 0.1, 1),
+                 std::runtime_error);
+    EXPECT_THROW(synthetic.plant(InteractionModel::XOR, {0, 4}, 0.1, 1),
+                 std::runtime_error);
+    EXPECT_THROW(synthetic.plant(InteractionModel::None, {0, 1}, 0, 1),
+                 std::runtime_error);
+}
+
+TEST(SyntheticTest, Write)
+{
+    // The files written are read as the same data set generated in memory
+    Synthetic synthetic(37, 70, 130, 0.05, 0.5, 3);
+    synthetic.plant(InteractionModel::Threshold, {30, 4}, 0.2, 1);
+    char tped_path[] = "/tmp/fiuncho_tpedXXXXXX",
+         tfam_path[] = "/tmp/fiuncho_tfamXXXXXX";
+    close(mkstemp(tped_path));
+    close(mkstemp(tfam_path));
+    for (const unsigned int threads : {1, 3}) {
+        synthetic.write(tped_path, tfam_path, threads);
+        const auto read =
+            Dataset<uint64_t>::read<ALIGNMENT>(tped_path, tfam_path);
+        const auto generated = synthetic.dataset<uint64_t, ALIGNMENT>();
+        ASSERT_EQ(generated.snps, read.snps);
+        EXPECT_EQ(generated.cases, read.cases);
+        EXPECT_EQ(generated.ctrls, read.ctrls);
+        ASSERT_EQ(generated.raw_size(), read.raw_size());
+        EXPECT_EQ(0, memcmp(generated.raw(), read.raw(),
+                            read.raw_size() * sizeof(uint64_t)));
+    }
+    remove(tped_path);
+    remove(tfam_path);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}
@@ -16,10 +16,12 @@
  */
 
 #include "utils.h"
+#include <cstring>
 #include <fiuncho/Distribution.h>
 #include <fiuncho/Search.h>
 #include <fiuncho/ThreadedSearch.h>
 #include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Affinity.h>
 #include <gtest/gtest.h>
 
 std::string tped, tfam;
@@ -54,6 +56,127 @@ TEST(ThreadedSearchTest, Main)
         }
     }
 }
+
+TEST(ThreadedSearchTest, Placement)
+{
+    // Run ThreadedSearch with pinned threads over a replicated dataset
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(
+        tped, tfam, DatasetPlacement::Replicated);
+#else
+    const auto dataset =
+        Dataset<uint64_t>::read(tped, tfam, DatasetPlacement::Replicated);
+#endif
+
+    // Every node with CPUs, other than the node that read the data set, gets
+    // its own copy of the tables, even if node ids are not contiguous
+    const int cpu = sched_getcpu();
+    const int local_node = cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+    const auto nodes = numa_nodes();
+    for (const int node : nodes) {
+        const auto &tables = dataset.replica(node);
+        ASSERT_EQ(dataset.snps, tables.size());
+        if (node == local_node || numa_node_cpus(node).empty()) {
+            EXPECT_EQ(dataset[0].cases, tables[0].cases);
+        } else {
+            EXPECT_NE(dataset[0].cases, tables[0].cases);
+        }
+        for (size_t i = 0; i < dataset.snps; i++) {
+            EXPECT_EQ(0, memcmp(dataset[i].cases, tables[i].cases,
+                                3 * dataset[i].cases_words * sizeof(uint64_t)));
+            EXPECT_EQ(0, memcmp(dataset[i].ctrls, tables[i].ctrls,
+                                3 * dataset[i].ctrls_words * sizeof(uint64_t)));
+        }
+    }
+    // Nodes that do not exist use the main copy
+    EXPECT_EQ(dataset[0].cases, dataset.replica(nodes.back() + 1)[0].cases);
+
+    ThreadedSearch search(4, available_cpus());
+    Distribution<int> distribution(dataset.snps, 2, 1, 0);
+    auto result = search.run(dataset, 3, distribution, 100);
+    EXPECT_EQ(result.size(), 100);
+    EXPECT_FALSE(has_repeated_elements(result));
+    EXPECT_TRUE(ascending_combinations(result));
+    EXPECT_TRUE(matches_mpi3snp_output(result));
+}
+
+TEST(ThreadedSearchTest, Persistent)
+{
+    // Reuse the same workers and scratch buffers across runs of varying order
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch reference(4);
+    ThreadedSearch search(4, std::vector<int>(), true);
+    for (auto o : {4, 2, 3, 3}) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        auto expected = reference.run(dataset, o, distribution, 100);
+        auto result = search.run(dataset, o, distribution, 100);
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            EXPECT_EQ(result[i].combination, expected[i].combination);
+            EXPECT_EQ(result[i].val, expected[i].val);
+        }
+        if (o == 3) {
+            EXPECT_TRUE(matches_mpi3snp_output(result));
+        }
+    }
+}
+
+TEST(ThreadedSearchTest, Pipeline)
+{
+    // Split threads in counting and scoring threads, leaving one thread out of
+    // the pipeline groups
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    ThreadedSearch reference(4);
+    for (unsigned int pipeline : {1, 2}) {
+        ThreadedSearch search(pipeline * 2 + 3, available_cpus(), true,
+                              pipeline);
+        for (auto o = 2; o < 5; o++) {
+            Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+            auto expected = reference.run(dataset, o, distribution, 100);
+            auto result = search.run(dataset, o, distribution, 100);
+            ASSERT_EQ(result.size(), expected.size());
+            for (size_t i = 0; i < result.size(); i++) {
+                EXPECT_EQ(result[i].combination, expected[i].combination);
+                EXPECT_EQ(result[i].val, expected[i].val);
+            }
+        }
+    }
+}
+
+TEST(ThreadedSearchTest, Stream)
+{
+    // Start the search while the dataset is still being read
+#ifdef ALIGN
+    constexpr size_t N = ALIGN;
+#else
+    constexpr size_t N = sizeof(uint64_t);
+#endif
+    const auto dataset = Dataset<uint64_t>::read<N>(tped, tfam);
+
+    ThreadedSearch search(4);
+    for (auto o = 2; o < 5; o++) {
+        Distribution<int> distribution(dataset.snps, o - 1, 1, 0);
+        auto expected = search.run(dataset, o, distribution, 100);
+        const auto streamed = Dataset<uint64_t>::stream<N>(tped, tfam);
+        auto result = search.run(streamed, o, distribution, 100);
+        EXPECT_NO_THROW(streamed.finish());
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            EXPECT_EQ(result[i].combination, expected[i].combination);
+            EXPECT_EQ(result[i].val, expected[i].val);
+        }
+    }
+}
 } // namespace
 
 int main(int argc, char **argv)
@@ -0,0 +1,137 @@
+/*
+ * This file is part of Fiuncho.
+ *
+ * Fiuncho is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fiuncho is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fiuncho. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "utils.h"
+#include <cstdio>
+#include <fiuncho/Distribution.h>
+#include <fiuncho/SlicedSearch.h>
+#include <fiuncho/ThreadedSearch.h>
+#include <fiuncho/dataset/Dataset.h>
+#include <fiuncho/utils/Tracer.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+std::string tped, tfam;
+
+namespace
+{
+// Number of occurrences of s in str
+size_t count(const std::string &str, const std::string &s)
+{
+    size_t n = 0, pos = 0;
+    while ((pos = str.find(s, pos)) != std::string::npos) {
+        n++;
+        pos += s.size();
+    }
+    return n;
+}
+
+TEST(TracerTest, Scope)
+{
+    // Scopes only record events while a Tracer exists, once per interval
+    {
+        Tracer::Scope scope("before");
+    }
+    Tracer tracer;
+    EXPECT_THROW(Tracer(), std::runtime_error);
+    {
+        Tracer::Scope scope("a");
+        scope.end();
+        scope.end();
+        scope.begin();
+        usleep(1000);
+    }
+    EXPECT_EQ(2, tracer.size());
+    const auto json = tracer.json(3, 0, tracer.start());
+    EXPECT_EQ(0, count(json, "\"before\""));
+    EXPECT_EQ(2, count(json, "\"name\":\"a\""));
+    EXPECT_EQ(4, count(json, "\"pid\":3"));
+    EXPECT_EQ(1, count(json, "\"name\":\"thread 0\""));
+}
+
+TEST(TracerTest, Capacity)
+{
+    // Full buffers keep their first and last events, and count the rest
+    EXPECT_THROW(Tracer(1), std::runtime_error);
+    const char *names[] = {"e0", "e1", "e2", "e3", "e4",
+                           "e5", "e6", "e7", "e8", "e9"};
+    Tracer tracer(5);
+    for (const auto name : names) {
+        Tracer::Scope scope(name);
+    }
+    EXPECT_EQ(5, tracer.size());
+    EXPECT_EQ(5, tracer.dropped());
+    const auto json = tracer.json(0, 0, tracer.start());
+    for (const auto name : {"e0", "e1", "e7", "e8", "e9"}) {
+        EXPECT_EQ(1, count(json, std::string("\"name\":\"") + name + '"'));
+    }
+    EXPECT_EQ(0, count(json, "\"name\":\"e2\""));
+    EXPECT_EQ(1, count(json, "\"name\":\"dropped events\""));
+    EXPECT_EQ(1, count(json, "\"args\":{\"count\":5}"));
+    // Events are written in the order they were recorded
+    EXPECT_LT(json.find("\"e1\""), json.find("\"dropped events\""));
+    EXPECT_LT(json.find("\"dropped events\""), json.find("\"e7\""));
+    EXPECT_LT(json.find("\"e7\""), json.find("\"e8\""));
+    EXPECT_LT(json.find("\"e8\""), json.find("\"e9\""));
+}
+
+TEST(TracerTest, Search)
+{
+    // Every block filled by the threads of a search is scored
+#ifdef ALIGN
+    const auto dataset = Dataset<uint64_t>::read<ALIGN>(tped, tfam);
+#else
+    const auto dataset = Dataset<uint64_t>::read(tped, tfam);
+#endif
+
+    char path[] = "/tmp/fiuncho_traceXXXXXX";
+    close(mkstemp(path));
+    ThreadedSearch threaded(2), pipelined(3, {}, false, 2);
+    SlicedSearch sliced(2);
+    for (auto search : std::vector<Search *>{&threaded, &pipelined, &sliced}) {
+        {
+            Tracer tracer;
+            Distribution<int> distribution(dataset.snps, 2, 1, 0);
+            search->run(dataset, 3, distribution, 10);
+            tracer.write(path);
+        }
+        std::ifstream is(path);
+        std::stringstream trace;
+        trace << is.rdbuf();
+        const auto fill = count(trace.str(), "\"name\":\"block fill\""),
+                   score = count(trace.str(), "\"name\":\"block score\"");
+        EXPECT_GT(fill, 0);
+        EXPECT_EQ(fill, score);
+        EXPECT_EQ(search == &sliced ? 0 : 1,
+                  count(trace.str(), "\"name\":\"top-K merge\""));
+        EXPECT_EQ(0, trace.str().find("{\"displayTimeUnit\""));
+    }
+    std::remove(path);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    assert(argc == 3); // gtest leaved unparsed arguments for you
+    tped = argv[1];
+    tfam = argv[2];
+    return RUN_ALL_TESTS();
+}